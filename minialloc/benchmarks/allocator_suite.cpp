@@ -0,0 +1,300 @@
+/*
+    the regression suite, built on google benchmark. every case runs against the minialloc configurations and
+    against three references: glibc (or whatever the platform has) malloc, a jemalloc style pool of size classes
+    and std::pmr::unsynchronized_pool_resource.
+
+    churn/<distribution> keeps 4096 blocks live and replaces a random one per iteration. the distributions are
+    small (16 to 256 bytes), medium (256 to 4096) and mixed (mostly small, one in eight up to 64 KiB). sizes and
+    victims are drawn up front from a fixed seed, so every run and every allocator sees the same sequence.
+
+    free_list/<holes> leaves that many 64 byte holes below the rest of the heap and then allocates and frees a
+    256 byte block, which none of the holes can serve. a first fit search walks past every hole, and without the
+    address tree so does the free. only the address tree and the boundary tags should not care.
+
+        allocator_suite --benchmark_filter=churn
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../minialloc.hpp"
+
+struct traits64_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct traits64_absolute_t : traits64_t {
+    static constexpr bool k_use_absolute_pointers = true;
+};
+
+struct traits32_t {
+    using displacement_type_t = int32_t;
+    using size_type_t = uint32_t;
+    static constexpr uint32_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct traits64_segregated_t : traits64_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct traits32_segregated_t : traits32_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct traits64_segregated_tree_t : traits64_segregated_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct traits64_boundary_tags_t : traits64_segregated_t {
+    static constexpr allocator_layout_t k_layout = allocator_layout_t::boundary_tags;
+};
+
+static constexpr size_t k_heap_size = 256 * 1024 * 1024;
+static constexpr size_t k_max_allocations = 64 * 1024;
+static constexpr size_t k_live_blocks = 4096;
+static constexpr size_t k_sequence_length = 1 << 16;
+
+template<typename Traits>
+struct minialloc_adapter_t {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    uint8_t* m_memory;
+    allocator_t* m_allocator;
+
+    minialloc_adapter_t() :
+        m_memory(static_cast<uint8_t*>(std::malloc(k_heap_size))),
+        m_allocator(new allocator_t{ m_memory, static_cast<size_type_t>(k_heap_size), static_cast<size_type_t>(k_max_allocations) }) {
+    }
+
+    ~minialloc_adapter_t() {
+        delete m_allocator;
+        std::free(m_memory);
+    }
+
+    void* allocate(size_t size) {
+        return m_allocator->allocate(static_cast<size_type_t>(size));
+    }
+
+    void deallocate(void* memory, size_t size) {
+        m_allocator->deallocate(memory, static_cast<size_type_t>(size));
+    }
+};
+
+struct malloc_adapter_t {
+    void* allocate(size_t size) {
+        return std::malloc(size);
+    }
+
+    void deallocate(void* memory, size_t) {
+        std::free(memory);
+    }
+};
+
+/*
+    jemalloc style small size classes: 16 byte steps up to 64, then four classes per doubling up to 16 KiB.
+    every class has an intrusive free list and bump allocates from 64 KiB runs, larger requests go to malloc
+*/
+struct size_class_pool_adapter_t {
+    static constexpr uint32_t k_class_count = 36;
+    static constexpr size_t k_max_small_size = 16 * 1024;
+    static constexpr size_t k_run_size = 64 * 1024;
+
+    struct size_class_t {
+        void* m_free_list = nullptr;
+        uint8_t* m_run_cursor = nullptr;
+        uint8_t* m_run_end = nullptr;
+    };
+
+    size_class_t m_classes[k_class_count];
+    std::vector<void*> m_runs;
+
+    static uint32_t size_class_of(size_t size) {
+        if (size <= 64) {
+            return size == 0 ? 0 : static_cast<uint32_t>((size - 1) / 16);
+        }
+        uint32_t shift = minialloc_log2(static_cast<uint64_t>(size - 1));
+        return 4 + (shift - 6) * 4 + static_cast<uint32_t>(((size - 1) >> (shift - 2)) & 3);
+    }
+
+    static size_t class_size(uint32_t size_class) {
+        if (size_class < 4) {
+            return (static_cast<size_t>(size_class) + 1) * 16;
+        }
+        uint32_t shift = 6 + (size_class - 4) / 4;
+        return (static_cast<size_t>(1) << shift) + ((size_class - 4) % 4 + 1) * (static_cast<size_t>(1) << (shift - 2));
+    }
+
+    ~size_class_pool_adapter_t() {
+        for (auto run : m_runs) {
+            std::free(run);
+        }
+    }
+
+    void* allocate(size_t size) {
+        if (size > k_max_small_size) {
+            return std::malloc(size);
+        }
+        auto& size_class = m_classes[size_class_of(size)];
+        if (size_class.m_free_list != nullptr) {
+            void* result = size_class.m_free_list;
+            size_class.m_free_list = *static_cast<void**>(result);
+            return result;
+        }
+        size_t slot_size = class_size(size_class_of(size));
+        if (size_class.m_run_cursor == nullptr || size_class.m_run_cursor + slot_size > size_class.m_run_end) {
+            size_class.m_run_cursor = static_cast<uint8_t*>(std::malloc(k_run_size));
+            size_class.m_run_end = size_class.m_run_cursor + k_run_size;
+            m_runs.push_back(size_class.m_run_cursor);
+        }
+        void* result = size_class.m_run_cursor;
+        size_class.m_run_cursor += slot_size;
+        return result;
+    }
+
+    void deallocate(void* memory, size_t size) {
+        if (size > k_max_small_size) {
+            std::free(memory);
+            return;
+        }
+        auto& size_class = m_classes[size_class_of(size)];
+        *static_cast<void**>(memory) = size_class.m_free_list;
+        size_class.m_free_list = memory;
+    }
+};
+
+struct pmr_pool_adapter_t {
+    std::pmr::unsynchronized_pool_resource m_resource{ std::pmr::pool_options{ 0, 16 * 1024 } };
+
+    void* allocate(size_t size) {
+        return m_resource.allocate(size, 16);
+    }
+
+    void deallocate(void* memory, size_t size) {
+        m_resource.deallocate(memory, size, 16);
+    }
+};
+
+enum size_distribution_t : int64_t {
+    small_sizes,
+    medium_sizes,
+    mixed_sizes
+};
+
+static const char* const g_distribution_names[] = { "small", "medium", "mixed" };
+
+struct churn_sequence_t {
+    std::vector<uint32_t> m_sizes;
+    std::vector<uint32_t> m_victims;
+};
+
+static const churn_sequence_t& churn_sequence(int64_t distribution) {
+    static churn_sequence_t sequences[3];
+    auto& sequence = sequences[distribution];
+    if (sequence.m_sizes.empty()) {
+        std::mt19937 rng{ 20 };
+        for (size_t index = 0; index < k_sequence_length; ++index) {
+            uint32_t size = 0;
+            switch (distribution) {
+            case small_sizes:
+                size = 16 + rng() % 241;
+                break;
+            case medium_sizes:
+                size = 256 + rng() % 3841;
+                break;
+            default:
+                size = rng() % 8 == 0 ? 4096 + rng() % (60 * 1024) : 16 + rng() % 241;
+                break;
+            }
+            sequence.m_sizes.push_back(size);
+            sequence.m_victims.push_back(static_cast<uint32_t>(rng() % k_live_blocks));
+        }
+    }
+    return sequence;
+}
+
+struct live_block_t {
+    void* m_memory;
+    size_t m_size;
+};
+
+template<typename Adapter>
+static void churn(benchmark::State& state) {
+    const auto& sequence = churn_sequence(state.range(0));
+    auto adapter = std::make_unique<Adapter>();
+
+    std::vector<live_block_t> live(k_live_blocks);
+    for (size_t block_index = 0; block_index < k_live_blocks; ++block_index) {
+        live[block_index].m_size = sequence.m_sizes[block_index];
+        live[block_index].m_memory = adapter->allocate(live[block_index].m_size);
+    }
+
+    size_t cursor = 0;
+    for (auto _ : state) {
+        auto& block = live[sequence.m_victims[cursor]];
+        adapter->deallocate(block.m_memory, block.m_size);
+        block.m_size = sequence.m_sizes[cursor];
+        //no DoNotOptimize, the teardown reads the blocks back. its "+m,r" form can lose this store with gcc
+        block.m_memory = adapter->allocate(block.m_size);
+        cursor = (cursor + 1) & (k_sequence_length - 1);
+    }
+
+    for (auto& block : live) {
+        adapter->deallocate(block.m_memory, block.m_size);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(g_distribution_names[state.range(0)]);
+}
+
+template<typename Adapter>
+static void free_list(benchmark::State& state) {
+    auto holes = static_cast<size_t>(state.range(0));
+    auto adapter = std::make_unique<Adapter>();
+
+    std::vector<void*> blocks(2 * holes);
+    for (auto& block : blocks) {
+        block = adapter->allocate(64);
+    }
+    for (size_t block_index = 0; block_index < blocks.size(); block_index += 2) {
+        adapter->deallocate(blocks[block_index], 64);
+    }
+
+    for (auto _ : state) {
+        void* block = adapter->allocate(256);
+        benchmark::DoNotOptimize(block);
+        adapter->deallocate(block, 256);
+    }
+
+    for (size_t block_index = 1; block_index < blocks.size(); block_index += 2) {
+        adapter->deallocate(blocks[block_index], 64);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+#define MINIALLOC_SUITE(adapter) \
+    BENCHMARK_TEMPLATE(churn, adapter)->DenseRange(small_sizes, mixed_sizes); \
+    BENCHMARK_TEMPLATE(free_list, adapter)->RangeMultiplier(16)->Range(16, 16384);
+
+MINIALLOC_SUITE(minialloc_adapter_t<traits64_t>)
+MINIALLOC_SUITE(minialloc_adapter_t<traits64_absolute_t>)
+MINIALLOC_SUITE(minialloc_adapter_t<traits32_t>)
+MINIALLOC_SUITE(minialloc_adapter_t<traits64_segregated_t>)
+MINIALLOC_SUITE(minialloc_adapter_t<traits32_segregated_t>)
+MINIALLOC_SUITE(minialloc_adapter_t<traits64_segregated_tree_t>)
+MINIALLOC_SUITE(minialloc_adapter_t<traits64_boundary_tags_t>)
+MINIALLOC_SUITE(malloc_adapter_t)
+MINIALLOC_SUITE(size_class_pool_adapter_t)
+MINIALLOC_SUITE(pmr_pool_adapter_t)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,156 @@
+/*
+    compares first_fit, packed_best_fit and segregated_fit on allocate latency and fragmentation.
+
+    a random workload keeps a live set of a given size: every step frees a random live block and allocates a new
+    one with a size drawn from a mix of small objects and occasional large buffers. after a warmup the timed
+    phase measures the allocate calls only. fragmentation is reported as the high water mark (highest byte ever
+    handed out, relative to the first allocation) and, at the end of the run, the share of the free memory
+    between live blocks that is not part of the largest such gap.
+
+    build with -O2 -march=native (or /arch:AVX2) so the packed scan uses AVX2, otherwise it falls back to SSE4.1
+    or scalar code.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "../minialloc.hpp"
+
+struct first_fit_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct best_fit_traits_t : first_fit_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+struct segregated_traits_t : first_fit_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+static constexpr size_t k_memory_size = 256 * 1024 * 1024;
+static constexpr size_t k_steps_per_live_block = 8;
+
+struct result_t {
+    double m_ns_per_allocate;
+    size_t m_high_water;
+    double m_fragmentation;
+};
+
+static size_t random_block_size(std::mt19937_64& rng) {
+    //mostly small objects, one in 32 is a larger buffer
+    if (rng() % 32 == 0) {
+        return 1024 + rng() % (16 * 1024);
+    }
+    return 8 + rng() % 248;
+}
+
+template<typename Traits>
+static result_t run_workload(uint8_t* memory, size_t live_blocks) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+
+    size_t max_allocations = live_blocks * 4 + 64;
+    auto allocator = new allocator_t{ memory, k_memory_size, max_allocations };
+
+    std::mt19937_64 rng{ live_blocks };
+    std::vector<std::pair<uint8_t*, size_t>> live{};
+    uint8_t* lowest = nullptr;
+    uint8_t* highest = nullptr;
+
+    auto allocate_one = [&]() {
+        size_t size = random_block_size(rng);
+        auto block = static_cast<uint8_t*>(allocator->allocate(size));
+        lowest = lowest == nullptr ? block : std::min(lowest, block);
+        highest = std::max(highest, block + size);
+        live.push_back({ block, size });
+    };
+
+    auto free_one = [&]() {
+        size_t index = rng() % live.size();
+        allocator->deallocate(live[index].first, live[index].second);
+        live[index] = live.back();
+        live.pop_back();
+    };
+
+    for (size_t i = 0; i < live_blocks; ++i) {
+        allocate_one();
+    }
+    //warmup, lets the free list settle into its steady state shape
+    for (size_t i = 0; i < live_blocks * k_steps_per_live_block; ++i) {
+        free_one();
+        allocate_one();
+    }
+
+    double total_ns = 0;
+    size_t timed_steps = live_blocks * k_steps_per_live_block;
+    for (size_t i = 0; i < timed_steps; ++i) {
+        free_one();
+
+        size_t size = random_block_size(rng);
+        auto start = std::chrono::steady_clock::now();
+        auto block = static_cast<uint8_t*>(allocator->allocate(size));
+        auto end = std::chrono::steady_clock::now();
+        total_ns += std::chrono::duration<double, std::nano>(end - start).count();
+
+        highest = std::max(highest, block + size);
+        live.push_back({ block, size });
+    }
+
+    result_t result{};
+    result.m_ns_per_allocate = total_ns / timed_steps;
+    result.m_high_water = static_cast<size_t>(highest - lowest);
+
+    //the gaps between live blocks, the free memory past the last one does not count
+    std::sort(live.begin(), live.end());
+    size_t free_between = 0;
+    size_t largest_gap = 0;
+    for (size_t i = 1; i < live.size(); ++i) {
+        size_t gap = static_cast<size_t>(live[i].first - (live[i - 1].first + live[i - 1].second));
+        free_between += gap;
+        largest_gap = std::max(largest_gap, gap);
+    }
+    result.m_fragmentation = free_between == 0 ? 0.0 : 1.0 - static_cast<double>(largest_gap) / static_cast<double>(free_between);
+
+    for (auto& block : live) {
+        allocator->deallocate(block.first, block.second);
+    }
+    delete allocator;
+    return result;
+}
+
+int main() {
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(k_memory_size + 64));
+    uint8_t* aligned_memory = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(memory) + 63) & ~static_cast<uintptr_t>(63));
+
+#if defined(__AVX2__)
+    printf("packed scan: AVX2\n");
+#elif defined(__SSE4_1__)
+    printf("packed scan: SSE4.1\n");
+#else
+    printf("packed scan: scalar\n");
+#endif
+    printf("%10s %-12s %14s %16s %14s\n", "live", "policy", "ns/allocate", "high water KiB", "fragmentation");
+
+    for (size_t live_blocks : { 100, 1000, 10000 }) {
+        auto first_fit = run_workload<first_fit_traits_t>(aligned_memory, live_blocks);
+        auto best_fit = run_workload<best_fit_traits_t>(aligned_memory, live_blocks);
+        auto segregated = run_workload<segregated_traits_t>(aligned_memory, live_blocks);
+
+        printf("%10zu %-12s %14.1f %16zu %14.3f\n", live_blocks, "first_fit", first_fit.m_ns_per_allocate, first_fit.m_high_water / 1024, first_fit.m_fragmentation);
+        printf("%10zu %-12s %14.1f %16zu %14.3f\n", live_blocks, "best_fit", best_fit.m_ns_per_allocate, best_fit.m_high_water / 1024, best_fit.m_fragmentation);
+        printf("%10zu %-12s %14.1f %16zu %14.3f\n", live_blocks, "segregated", segregated.m_ns_per_allocate, segregated.m_high_water / 1024, segregated.m_fragmentation);
+    }
+
+    std::free(memory);
+    return 0;
+}
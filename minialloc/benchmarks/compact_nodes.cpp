@@ -0,0 +1,179 @@
+/*
+    metadata footprint and cache behaviour of compact nodes, for many small per connection pools.
+
+    every pool is 32 KiB with room for 128 free regions and keeps 48 blocks of 16 to 512 bytes live. the timed
+    loop goes round robin over the pools and replaces a random block in each, like a server touching one
+    connection after the other. a first fit search and the neighbor lookup of the free only read the nodes, so
+    the working set is the node arrays of all pools: 4 KiB per pool with 64 bit displacements, 1 KiB with
+    compact nodes (uint16_t fields, base and size in units of the 16 byte alignment).
+
+    on linux the L1 data cache read misses per operation are read from perf_event_open, the column shows "-"
+    where that is not permitted.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../minialloc.hpp"
+
+struct traits64_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct traits32_t {
+    using displacement_type_t = int32_t;
+    using size_type_t = uint32_t;
+    static constexpr uint32_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct traits32_compact_t : traits32_t {
+    using node_field_type_t = uint16_t;
+    static constexpr bool k_scale_node_fields = true;
+};
+
+static constexpr size_t k_pool_size = 32 * 1024;
+static constexpr size_t k_max_allocations = 128;
+static constexpr size_t k_live_blocks = 48;
+static constexpr size_t k_operations = 4 * 1024 * 1024;
+static constexpr size_t k_pool_counts[] = { 16, 64, 256, 1024, 4096 };
+
+//counts L1 data cache read misses of this thread, valid() is false where perf events are not available
+struct l1_miss_counter_t {
+    int m_descriptor = -1;
+
+    l1_miss_counter_t() {
+#if defined(__linux__)
+        perf_event_attr attributes{};
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        m_descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+
+    ~l1_miss_counter_t() {
+#if defined(__linux__)
+        if (m_descriptor >= 0) {
+            close(m_descriptor);
+        }
+#endif
+    }
+
+    bool valid() const {
+        return m_descriptor >= 0;
+    }
+
+    void start() {
+#if defined(__linux__)
+        if (valid()) {
+            ioctl(m_descriptor, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_descriptor, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+#if defined(__linux__)
+        if (valid()) {
+            ioctl(m_descriptor, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_descriptor, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+};
+
+struct live_block_t {
+    void* m_memory;
+    uint32_t m_size;
+};
+
+template<typename Traits>
+static void run(const char* name, size_t pool_count) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(pool_count * k_pool_size));
+    std::vector<allocator_t> pools{};
+    pools.reserve(pool_count);
+    for (size_t pool_index = 0; pool_index < pool_count; ++pool_index) {
+        pools.emplace_back(memory + pool_index * k_pool_size, static_cast<size_type_t>(k_pool_size), static_cast<size_type_t>(k_max_allocations));
+    }
+    size_t metadata_bytes = k_pool_size - pools[0].available_memory();
+
+    std::mt19937 rng{ 22 };
+    std::vector<live_block_t> live(pool_count * k_live_blocks);
+    for (size_t block_index = 0; block_index < live.size(); ++block_index) {
+        live[block_index].m_size = 16 + rng() % 497;
+        live[block_index].m_memory = pools[block_index / k_live_blocks].allocate(live[block_index].m_size);
+    }
+    //victims and sizes up front, so the timed loop does not include the generator
+    std::vector<uint32_t> victims(k_operations), sizes(k_operations);
+    for (size_t operation = 0; operation < k_operations; ++operation) {
+        victims[operation] = rng() % k_live_blocks;
+        sizes[operation] = 16 + rng() % 497;
+    }
+
+    l1_miss_counter_t counter{};
+    counter.start();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t operation = 0; operation < k_operations; ++operation) {
+        size_t pool_index = operation % pool_count;
+        auto& pool = pools[pool_index];
+        auto& block = live[pool_index * k_live_blocks + victims[operation]];
+        pool.deallocate(block.m_memory, block.m_size);
+        block.m_size = sizes[operation];
+        block.m_memory = pool.allocate(block.m_size);
+    }
+    auto end = std::chrono::steady_clock::now();
+    uint64_t misses = counter.stop();
+
+    double ns_per_operation = std::chrono::duration<double, std::nano>(end - start).count() / k_operations;
+    printf("%-22s %8zu %18zu %22zu %10.1f ", name, pool_count, metadata_bytes, pool_count * metadata_bytes / 1024, ns_per_operation);
+    if (counter.valid()) {
+        printf("%16.2f\n", static_cast<double>(misses) / k_operations);
+    }
+    else {
+        printf("%16s\n", "-");
+    }
+
+    for (auto& block : live) {
+        pools[(&block - live.data()) / k_live_blocks].deallocate(block.m_memory, block.m_size);
+    }
+    pools.clear();
+    std::free(memory);
+}
+
+int main() {
+    static_assert(sizeof(allocator_template_t<traits32_compact_t>::allocation_node_t) == 8);
+
+    printf("%-22s %8s %18s %22s %10s %16s\n", "configuration", "pools", "metadata B/pool", "metadata KiB total", "ns/op", "L1D misses/op");
+    for (size_t pool_count : k_pool_counts) {
+        run<traits64_t>("64 bit displacements", pool_count);
+        run<traits32_t>("32 bit displacements", pool_count);
+        run<traits32_compact_t>("compact (uint16, x16)", pool_count);
+    }
+    return 0;
+}
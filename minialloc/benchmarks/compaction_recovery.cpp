@@ -0,0 +1,105 @@
+/*
+    shows how incremental compaction recovers contiguous free memory over time.
+
+    a heap is filled with blocks of mixed sizes and then churned until it is badly fragmented. after that it
+    runs in ticks: every tick frees and allocates a few blocks and then gives the compactor a byte budget
+    through maybe_compact. the table shows, per budget, the largest free block and the fragmentation after a
+    number of ticks, together with the average time the compaction step took per tick. a budget of 0 is the
+    baseline without compaction.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../minialloc_relocatable.hpp"
+
+struct relocatable_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr uint32_t k_compaction_threshold_percent = 10;
+};
+
+using relocatable_t = relocatable_allocator_template_t<relocatable_traits_t>;
+
+static constexpr size_t k_memory_size = 64 * 1024 * 1024;
+static constexpr size_t k_max_handles = 256 * 1024;
+static constexpr size_t k_churn_per_tick = 16;
+static constexpr uint32_t k_report_ticks[] = { 0, 1, 10, 100, 1000, 10000 };
+
+static size_t random_block_size(std::mt19937_64& rng) {
+    if (rng() % 16 == 0) {
+        return 2048 + rng() % (32 * 1024);
+    }
+    return 16 + rng() % 496;
+}
+
+static void run(uint8_t* memory, size_t byte_budget) {
+    auto allocator = new relocatable_t::allocator_t{ memory, k_memory_size, k_max_handles };
+    std::mt19937_64 rng{ 42 };
+    std::vector<relocatable_t::handle_t> live{};
+
+    auto allocate_one = [&]() {
+        auto handle = allocator->allocate(random_block_size(rng));
+        if (handle != relocatable_t::k_null_handle) {
+            live.push_back(handle);
+        }
+        return handle != relocatable_t::k_null_handle;
+    };
+    auto free_one = [&]() {
+        size_t index = rng() % live.size();
+        allocator->deallocate(live[index]);
+        live[index] = live.back();
+        live.pop_back();
+    };
+
+    //fill to about 70%, then free half of the blocks at random
+    while (allocator->backing_allocator().available_memory() > k_memory_size * 3 / 10 && allocate_one()) {
+    }
+    size_t free_count = live.size() / 2;
+    for (size_t i = 0; i < free_count; ++i) {
+        free_one();
+    }
+
+    double step_ns = 0;
+    uint32_t tick = 0;
+    for (uint32_t report_tick : k_report_ticks) {
+        for (; tick < report_tick; ++tick) {
+            for (size_t i = 0; i < k_churn_per_tick; ++i) {
+                free_one();
+                allocate_one();
+            }
+            if (byte_budget != 0) {
+                auto start = std::chrono::steady_clock::now();
+                allocator->maybe_compact(byte_budget);
+                auto end = std::chrono::steady_clock::now();
+                step_ns += std::chrono::duration<double, std::nano>(end - start).count();
+            }
+        }
+        printf("%12zu %8u %18zu %14.3f %14.0f\n", byte_budget, tick,
+            static_cast<size_t>(allocator->backing_allocator().largest_free_region()) / 1024, allocator->fragmentation(),
+            tick == 0 ? 0.0 : step_ns / tick);
+    }
+
+    delete allocator;
+}
+
+int main() {
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(k_memory_size));
+
+    printf("%12s %8s %18s %14s %14s\n", "budget/tick", "tick", "largest free KiB", "fragmentation", "ns/step");
+    for (size_t byte_budget : { 0, 4 * 1024, 64 * 1024, 1024 * 1024 }) {
+        run(memory, byte_budget);
+    }
+
+    std::free(memory);
+    return 0;
+}
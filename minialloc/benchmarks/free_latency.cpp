@@ -0,0 +1,99 @@
+/*
+    compares deallocate latency of the plain address ordered free list against k_use_address_tree
+    for free lists of 10 to 100k nodes.
+
+    the heap is fragmented into alternating live blocks and holes, then random live blocks are freed.
+    every timed free merges with both neighboring holes, so the free list length stays close to the target.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "../minialloc.hpp"
+
+struct list_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct tree_traits_t : list_traits_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+static constexpr size_t k_block_size = 32;
+//small free lists are rebuilt until at least this many frees were timed
+static constexpr size_t k_min_timed_frees = 2000;
+
+template<typename Traits>
+static double measure_free_latency(size_t free_list_length, size_t frees_per_round) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using node_t = typename allocator_template_t<Traits>::allocation_node_t;
+
+    size_t max_allocations = free_list_length + 16;
+    size_t block_count = free_list_length * 2;
+    size_t memory_size = sizeof(node_t) * (max_allocations + 1) + block_count * k_block_size + 4096;
+
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(memory_size + 64));
+    uint8_t* aligned_memory = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(memory) + 63) & ~static_cast<uintptr_t>(63));
+
+    std::mt19937_64 rng{ free_list_length };
+    double total_ns = 0;
+    size_t rounds = std::max<size_t>(3, k_min_timed_frees / frees_per_round);
+
+    for (size_t round = 0; round < rounds; ++round) {
+        allocator_t allocator{ aligned_memory, memory_size, max_allocations };
+
+        std::vector<void*> blocks(block_count);
+        for (size_t i = 0; i < block_count; ++i) {
+            blocks[i] = allocator.allocate(k_block_size);
+        }
+
+        //punch the holes highest address first, every free then lands at the front of the list
+        for (size_t i = block_count; i-- > 0;) {
+            if (i & 1) {
+                allocator.deallocate(blocks[i], k_block_size);
+            }
+        }
+
+        std::vector<void*> live{};
+        for (size_t i = 0; i < block_count; i += 2) {
+            live.push_back(blocks[i]);
+        }
+        std::shuffle(live.begin(), live.end(), rng);
+        live.resize(std::min(live.size(), frees_per_round));
+
+        auto start = std::chrono::steady_clock::now();
+        for (void* block : live) {
+            allocator.deallocate(block, k_block_size);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        total_ns += std::chrono::duration<double, std::nano>(end - start).count() / live.size();
+    }
+
+    std::free(memory);
+    return total_ns / rounds;
+}
+
+int main() {
+    printf("%12s %16s %16s %10s\n", "free nodes", "list ns/free", "tree ns/free", "speedup");
+
+    for (size_t free_list_length : { 10, 100, 1000, 10000, 100000 }) {
+        size_t frees_per_round = std::max<size_t>(1, std::min<size_t>(free_list_length / 10, 1000));
+
+        double list_ns = measure_free_latency<list_traits_t>(free_list_length, frees_per_round);
+        double tree_ns = measure_free_latency<tree_traits_t>(free_list_length, frees_per_round);
+
+        printf("%12zu %16.1f %16.1f %9.2fx\n", free_list_length, list_ns, tree_ns, list_ns / tree_ns);
+    }
+    return 0;
+}
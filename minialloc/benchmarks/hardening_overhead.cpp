@@ -0,0 +1,104 @@
+/*
+    measures what each hardening tier costs, for the segregated fit node pool (with the address tree, so frees do
+    not walk the list) and the boundary tag layout.
+
+    the heap holds a few thousand live blocks of mixed sizes, and every operation frees a random one and allocates
+    a new one. the tiers are hardening_level_t::none, local and size_tags, and local with a full check_integrity()
+    sampled every 4096, 256 and 1 operations. an interval of 1 walks the whole heap on every call, the same work as
+    a MINIALLOC_VERIFY build.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../minialloc.hpp"
+
+struct node_pool_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct boundary_tags_traits_t : node_pool_traits_t {
+    static constexpr allocator_layout_t k_layout = allocator_layout_t::boundary_tags;
+};
+
+template<typename Base, hardening_level_t Level, uint32_t Interval>
+struct hardened_traits_t : Base {
+    static constexpr hardening_level_t k_hardening_level = Level;
+    static constexpr uint32_t k_validation_interval = Interval;
+};
+
+static constexpr size_t k_memory_size = 64 * 1024 * 1024;
+static constexpr size_t k_live_blocks = 8192;
+static constexpr size_t k_operations = 400000;
+
+struct block_t {
+    void* m_memory;
+    size_t m_size;
+};
+
+//nanoseconds per free and allocate pair
+template<typename Traits>
+static double measure(uint8_t* memory, size_t operations) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    auto allocator = new allocator_t{ memory, k_memory_size, 4 * k_live_blocks };
+    std::mt19937_64 rng{ 7 };
+
+    auto random_size = [&rng]() {
+        return static_cast<size_t>(rng() % 8 == 0 ? 1024 + rng() % 8192 : 16 + rng() % 240);
+    };
+
+    std::vector<block_t> live(k_live_blocks);
+    for (auto& block : live) {
+        block.m_size = random_size();
+        block.m_memory = allocator->allocate(block.m_size);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t operation_index = 0; operation_index < operations; ++operation_index) {
+        auto& block = live[rng() % k_live_blocks];
+        allocator->deallocate(block.m_memory, block.m_size);
+        block.m_size = random_size();
+        block.m_memory = allocator->allocate(block.m_size);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    delete allocator;
+    return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+template<typename Base>
+static void run(const char* layout) {
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(k_memory_size));
+
+    double baseline = measure<hardened_traits_t<Base, hardening_level_t::none, 0>>(memory, k_operations);
+    auto report = [&](const char* tier, double ns) {
+        printf("%-14s %-22s %10.1f %9.1f%%\n", layout, tier, ns, (ns / baseline - 1.0) * 100.0);
+    };
+    report("none", baseline);
+    report("local", measure<hardened_traits_t<Base, hardening_level_t::local, 0>>(memory, k_operations));
+    report("size_tags", measure<hardened_traits_t<Base, hardening_level_t::size_tags, 0>>(memory, k_operations));
+    report("local, 1/4096 walk", measure<hardened_traits_t<Base, hardening_level_t::local, 4096>>(memory, k_operations));
+    report("local, 1/256 walk", measure<hardened_traits_t<Base, hardening_level_t::local, 256>>(memory, k_operations));
+    //far slower, a shorter run is enough
+    report("local, every op walk", measure<hardened_traits_t<Base, hardening_level_t::local, 1>>(memory, k_operations / 100));
+
+    std::free(memory);
+}
+
+int main() {
+    printf("%-14s %-22s %10s %10s\n", "layout", "tier", "ns/op", "overhead");
+    run<node_pool_traits_t>("node pool");
+    run<boundary_tags_traits_t>("boundary tags");
+    return 0;
+}
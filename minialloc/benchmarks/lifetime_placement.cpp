@@ -0,0 +1,172 @@
+/*
+    compares plain placement with lifetime hinted placement on a mixed lifetime workload.
+
+    most requests are transient: they go into a window of 2048 slots and are freed when their slot comes around
+    again. one in sixteen is long lived and joins a set of up to 1024 blocks that only lose a random member once
+    the set is full. every 16384 requests the window is drained, like a server finishing a batch of work, and
+    the largest free block is sampled right after. the same sequence is run twice per configuration, once with
+    every request transient and once with the long lived ones hinted as such.
+
+    "worst drained" is the smallest of those samples in a 12 MiB heap, "min heap" the smallest heap (in 64 KiB
+    steps) the whole sequence runs in without a failed allocation, which is the peak footprint the workload
+    really needs. the hint helps first fit the most: the search policies that reuse the best hole keep putting
+    transient blocks into the holes freed long lived blocks leave at the top.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../minialloc.hpp"
+
+struct first_fit_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct first_fit_tree_traits_t : first_fit_traits_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct segregated_tree_traits_t : first_fit_tree_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct packed_tree_traits_t : first_fit_tree_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+static constexpr size_t k_heap_size = 12 * 1024 * 1024;
+static constexpr size_t k_max_heap_size = 64 * 1024 * 1024;
+static constexpr size_t k_heap_granularity = 64 * 1024;
+static constexpr size_t k_max_allocations = 16 * 1024;
+static constexpr size_t k_transient_window = 2048;
+static constexpr size_t k_long_lived_capacity = 1024;
+static constexpr size_t k_drain_interval = 16 * 1024;
+static constexpr size_t k_request_count = 256 * 1024;
+
+struct request_t {
+    uint32_t m_size;
+    //index into the long lived set for long lived requests, k_transient otherwise
+    uint32_t m_victim;
+};
+
+static constexpr uint32_t k_transient = ~0u;
+
+static std::vector<request_t> make_requests() {
+    std::mt19937 rng{ 21 };
+    std::vector<request_t> requests{};
+    for (size_t index = 0; index < k_request_count; ++index) {
+        if (rng() % 16 == 0) {
+            requests.push_back({ static_cast<uint32_t>(64 + rng() % 4033), static_cast<uint32_t>(rng() % k_long_lived_capacity) });
+        }
+        else {
+            requests.push_back({ static_cast<uint32_t>(16 + rng() % 4081), k_transient });
+        }
+    }
+    return requests;
+}
+
+struct live_block_t {
+    void* m_memory = nullptr;
+    size_t m_size = 0;
+};
+
+struct run_result_t {
+    bool m_completed;
+    double m_ns_per_request;
+    size_t m_worst_drained_largest;
+};
+
+template<typename Traits>
+static run_result_t run(uint8_t* memory, size_t heap_size, const std::vector<request_t>& requests, bool hinted) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    auto allocator = new allocator_t{ memory, heap_size, k_max_allocations };
+
+    std::vector<live_block_t> transient(k_transient_window);
+    std::vector<live_block_t> long_lived{};
+    run_result_t result{ true, 0.0, heap_size };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < requests.size() && result.m_completed; ++index) {
+        const auto& request = requests[index];
+        live_block_t* block;
+        if (request.m_victim == k_transient) {
+            block = &transient[index % k_transient_window];
+        }
+        else if (long_lived.size() < k_long_lived_capacity) {
+            long_lived.emplace_back();
+            block = &long_lived.back();
+        }
+        else {
+            block = &long_lived[request.m_victim];
+        }
+
+        if (block->m_memory != nullptr) {
+            allocator->deallocate(block->m_memory, block->m_size);
+        }
+        auto lifetime = hinted && request.m_victim != k_transient ? lifetime_t::long_lived : lifetime_t::transient;
+        block->m_memory = allocator->try_allocate(request.m_size, lifetime);
+        block->m_size = request.m_size;
+        result.m_completed = block->m_memory != nullptr;
+
+        if ((index + 1) % k_drain_interval == 0) {
+            for (auto& transient_block : transient) {
+                if (transient_block.m_memory != nullptr) {
+                    allocator->deallocate(transient_block.m_memory, transient_block.m_size);
+                    transient_block.m_memory = nullptr;
+                }
+            }
+            size_t largest = allocator->largest_free_region();
+            if (largest < result.m_worst_drained_largest) {
+                result.m_worst_drained_largest = largest;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.m_ns_per_request = std::chrono::duration<double, std::nano>(end - start).count() / requests.size();
+
+    delete allocator;
+    return result;
+}
+
+template<typename Traits>
+static void report(const char* name, uint8_t* memory, const std::vector<request_t>& requests) {
+    for (bool hinted : { false, true }) {
+        auto result = run<Traits>(memory, k_heap_size, requests, hinted);
+
+        //the smallest heap in which the whole sequence succeeds
+        size_t low = 0, high = k_max_heap_size / k_heap_granularity;
+        while (high - low > 1) {
+            size_t middle = (low + high) / 2;
+            if (run<Traits>(memory, middle * k_heap_granularity, requests, hinted).m_completed) {
+                high = middle;
+            }
+            else {
+                low = middle;
+            }
+        }
+
+        printf("%-20s %-8s %10.1f %20zu %14zu\n", name, hinted ? "hinted" : "plain", result.m_ns_per_request,
+            result.m_worst_drained_largest / 1024, high * k_heap_granularity / 1024);
+    }
+}
+
+int main() {
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(k_max_heap_size));
+    auto requests = make_requests();
+
+    printf("%-20s %-8s %10s %20s %14s\n", "configuration", "policy", "ns/request", "worst drained KiB", "min heap KiB");
+    report<first_fit_traits_t>("first_fit", memory, requests);
+    report<first_fit_tree_traits_t>("first_fit + tree", memory, requests);
+    report<segregated_tree_traits_t>("segregated + tree", memory, requests);
+    report<packed_tree_traits_t>("packed + tree", memory, requests);
+
+    std::free(memory);
+    return 0;
+}
@@ -0,0 +1,261 @@
+/*
+    sharded NUMA arenas against one allocator behind a mutex.
+
+    every thread is pinned to one of the cpus the process may run on and replaces blocks of 16 to 1024 bytes in
+    a table of slots: it allocates a block, writes it (the size goes in its first bytes) and swaps it into a
+    slot, freeing whatever was there. a given share of the swaps goes to the threads own part of the table,
+    the rest to a random slot, so that many of the frees are of blocks another thread allocated.
+
+    the table shows the throughput, the share of frees that went through a remote queue and the share of
+    sampled blocks whose page sits on the node of the thread that allocated it (from move_pages, "-" where
+    that is not available). on a machine with one node, numactl and shards_per_node simulate core groups:
+
+        numactl --physcpubind=0-7 --membind=0 numa_sharding 8 4
+
+    runs 8 threads over 4 shards of node 0. arguments are [threads] [shards per node] [local percent].
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../minialloc_numa.hpp"
+
+struct traits64_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr bool k_use_address_tree = true;
+};
+
+using numa_t = numa_allocator_template_t<traits64_t>;
+using plain_allocator_t = allocator_template_t<traits64_t>::allocator_t;
+
+static constexpr size_t k_shard_size = 256 * 1024 * 1024;
+static constexpr size_t k_max_allocations = 256 * 1024;
+static constexpr uint32_t k_slots_per_thread = 4096;
+static constexpr uint32_t k_operations_per_thread = 1 << 18;
+static constexpr uint32_t k_locality_samples = 256;
+
+//the baseline, one allocator for everyone on memory from wherever the first touch happened
+struct locked_allocator_t {
+    uint8_t* m_memory;
+    plain_allocator_t* m_allocator;
+    std::mutex m_lock;
+
+    locked_allocator_t() :
+        m_memory(static_cast<uint8_t*>(std::malloc(k_shard_size))),
+        m_allocator(new plain_allocator_t{ m_memory, k_shard_size, k_max_allocations }) {
+    }
+
+    ~locked_allocator_t() {
+        delete m_allocator;
+        std::free(m_memory);
+    }
+
+    void* allocate(size_t size) {
+        std::lock_guard<std::mutex> guard{ m_lock };
+        return m_allocator->allocate(size);
+    }
+
+    void deallocate(void* memory, size_t size) {
+        std::lock_guard<std::mutex> guard{ m_lock };
+        m_allocator->deallocate(memory, size);
+    }
+};
+
+//cpus this process may run on, numactl --physcpubind narrows them
+static std::vector<int> allowed_cpus() {
+    std::vector<int> cpus{};
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        cpus.push_back(-1);
+    }
+    return cpus;
+}
+
+static void pin_to_cpu(int cpu) {
+#if defined(__linux__)
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+//the node of the page memory lies in and of the calling thread, -1 where the system does not say
+static int page_node(void* memory) {
+#if defined(__linux__)
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(memory) & ~static_cast<uintptr_t>(4095));
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1ul, &page, nullptr, &status, 0) == 0 && status >= 0) {
+        return status;
+    }
+#else
+    (void)memory;
+#endif
+    return -1;
+}
+
+static int current_node() {
+#if defined(__linux__)
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+        return static_cast<int>(node);
+    }
+#endif
+    return -1;
+}
+
+struct run_result_t {
+    double m_operations_per_second;
+    uint32_t m_local_samples;
+    uint32_t m_known_samples;
+};
+
+template<typename Allocator>
+static run_result_t run(Allocator& allocator, uint32_t thread_count, uint32_t local_percent) {
+    std::vector<std::atomic<void*>> slots(static_cast<size_t>(thread_count) * k_slots_per_thread);
+    auto cpus = allowed_cpus();
+    std::atomic<uint32_t> local_samples{ 0 }, known_samples{ 0 };
+    std::atomic<uint32_t> ready{ 0 };
+    std::atomic<bool> go{ false };
+
+    auto worker = [&](uint32_t thread_index) {
+        pin_to_cpu(cpus[thread_index % cpus.size()]);
+        std::mt19937 rng{ 23 + thread_index };
+        ready.fetch_add(1);
+        while (!go.load()) {
+        }
+        for (uint32_t operation = 0; operation < k_operations_per_thread; ++operation) {
+            uint32_t size = 16 + rng() % 1009;
+            auto memory = static_cast<uint8_t*>(allocator.allocate(size));
+            memset(memory, static_cast<int>(operation), size);
+            memcpy(memory, &size, sizeof(size));
+
+            if (operation % (k_operations_per_thread / k_locality_samples) == 0) {
+                int memory_node = page_node(memory), thread_node = current_node();
+                if (memory_node >= 0 && thread_node >= 0) {
+                    known_samples.fetch_add(1, std::memory_order_relaxed);
+                    local_samples.fetch_add(memory_node == thread_node, std::memory_order_relaxed);
+                }
+            }
+
+            size_t slot_index = rng() % 100 < local_percent ?
+                static_cast<size_t>(thread_index) * k_slots_per_thread + rng() % k_slots_per_thread : rng() % slots.size();
+            void* previous = slots[slot_index].exchange(memory, std::memory_order_acq_rel);
+            if (previous != nullptr) {
+                uint32_t previous_size;
+                memcpy(&previous_size, previous, sizeof(previous_size));
+                allocator.deallocate(previous, previous_size);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads{};
+    for (uint32_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+        threads.emplace_back(worker, thread_index);
+    }
+    while (ready.load() != thread_count) {
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    for (auto& slot : slots) {
+        if (void* memory = slot.load()) {
+            uint32_t size;
+            memcpy(&size, memory, sizeof(size));
+            allocator.deallocate(memory, size);
+        }
+    }
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return run_result_t{ thread_count * static_cast<double>(k_operations_per_thread) / seconds, local_samples.load(), known_samples.load() };
+}
+
+static void print_row(const char* name, uint32_t shards, const run_result_t& result, double remote_share) {
+    printf("%-22s %8u %12.2f ", name, shards, result.m_operations_per_second / 1e6);
+    if (remote_share >= 0) {
+        printf("%16.1f ", 100.0 * remote_share);
+    }
+    else {
+        printf("%16s ", "-");
+    }
+    if (result.m_known_samples != 0) {
+        printf("%14.1f\n", 100.0 * result.m_local_samples / result.m_known_samples);
+    }
+    else {
+        printf("%14s\n", "-");
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t thread_count = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : std::thread::hardware_concurrency();
+    uint32_t shards_per_node = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 1;
+    uint32_t local_percent = argc > 3 ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 90;
+    thread_count = thread_count == 0 ? 1 : thread_count;
+
+    printf("%u threads, %u shards per node, %u%% of the frees in the threads own slots\n", thread_count, shards_per_node, local_percent);
+    printf("%-22s %8s %12s %16s %14s\n", "configuration", "shards", "Mops/s", "remote frees %", "local pages %");
+
+    {
+        locked_allocator_t allocator{};
+        print_row("one locked allocator", 1, run(allocator, thread_count, local_percent), -1.0);
+    }
+    {
+        numa_t::allocator_t allocator{ k_shard_size, static_cast<size_t>(k_max_allocations), shards_per_node };
+        if (!allocator.valid()) {
+            printf("could not reserve the shards\n");
+            return 1;
+        }
+        auto result = run(allocator, thread_count, local_percent);
+        allocator.collect_remote_frees();
+
+        uint64_t frees = 0, remote_frees = 0;
+        uint32_t bound_shards = 0;
+        for (uint32_t shard_index = 0; shard_index < allocator.shard_count(); ++shard_index) {
+            auto statistics = allocator.shard_statistics(shard_index);
+            frees += statistics.m_local_frees + statistics.m_remote_frees;
+            remote_frees += statistics.m_remote_frees;
+            bound_shards += allocator.shard_bound(shard_index);
+        }
+        print_row("numa shards", allocator.shard_count(), result, frees == 0 ? 0.0 : static_cast<double>(remote_frees) / frees);
+        if (bound_shards != allocator.shard_count()) {
+            printf("%u of %u shards could not be bound to their node\n", allocator.shard_count() - bound_shards, allocator.shard_count());
+        }
+    }
+    return 0;
+}
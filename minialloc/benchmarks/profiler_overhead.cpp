@@ -0,0 +1,131 @@
+/*
+    what the sampling heap profiler costs, and how close its estimate of the live heap comes.
+
+    the workload is the one of hardening_overhead: a few thousand live blocks of mixed sizes, every operation
+    frees a random one and allocates a new one. "trait off" is the allocator without k_sample_allocations,
+    "no sampler" has the trait but nothing attached, which leaves a null check on allocate and deallocate.
+    the profiled rows attach a heap_profiler_t with the given mean sample interval, capturing either the call
+    stack or a tag. "live error" compares estimated_live_bytes() with the real live heap at the end of the run.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../minialloc_profiler.hpp"
+
+struct node_pool_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct sampled_traits_t : node_pool_traits_t {
+    static constexpr bool k_sample_allocations = true;
+};
+
+static constexpr size_t k_memory_size = 64 * 1024 * 1024;
+static constexpr size_t k_live_blocks = 8192;
+static constexpr size_t k_operations = 1000000;
+
+struct block_t {
+    void* m_memory;
+    size_t m_size;
+};
+
+struct run_result_t {
+    double m_ns_per_operation;
+    size_t m_samples;
+    double m_live_error;
+};
+
+//profiler is only used with k_sample_allocations
+template<typename Traits>
+static run_result_t measure(uint8_t* memory, heap_profiler_t* profiler) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    auto allocator = new allocator_t{ memory, k_memory_size, 4 * k_live_blocks };
+    if constexpr (optional_k_sample_allocations_t<Traits>::value) {
+        allocator->set_sampler(profiler);
+    }
+    std::mt19937_64 rng{ 7 };
+
+    auto random_size = [&rng]() {
+        return static_cast<size_t>(rng() % 8 == 0 ? 1024 + rng() % 8192 : 16 + rng() % 240);
+    };
+    static const char* const k_tags[] = { "parser", "cache", "session", "buffers" };
+
+    std::vector<block_t> live(k_live_blocks);
+    for (auto& block : live) {
+        block.m_size = random_size();
+        block.m_memory = allocator->allocate(block.m_size);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t operation_index = 0; operation_index < k_operations; ++operation_index) {
+        auto& block = live[rng() % k_live_blocks];
+        allocator->deallocate(block.m_memory, block.m_size);
+        block.m_size = random_size();
+        heap_profiler_t::tag_scope_t scope{ k_tags[operation_index % 4] };
+        block.m_memory = allocator->allocate(block.m_size);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    run_result_t result{ std::chrono::duration<double, std::nano>(end - start).count() / k_operations, 0, 0.0 };
+    if (profiler != nullptr) {
+        size_t live_bytes = 0;
+        for (const auto& block : live) {
+            live_bytes += block.m_size;
+        }
+        result.m_samples = profiler->live_sample_count();
+        result.m_live_error = profiler->estimated_live_bytes() / static_cast<double>(live_bytes) - 1.0;
+    }
+    delete allocator;
+    return result;
+}
+
+int main() {
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(k_memory_size));
+
+    //the first run pays for faulting in the memory
+    measure<node_pool_traits_t>(memory, nullptr);
+    double baseline = measure<node_pool_traits_t>(memory, nullptr).m_ns_per_operation;
+    auto report = [&](const char* configuration, const run_result_t& result, bool profiled) {
+        printf("%-22s %10.1f %9.1f%% ", configuration, result.m_ns_per_operation, (result.m_ns_per_operation / baseline - 1.0) * 100.0);
+        if (profiled) {
+            printf("%14zu %11.1f%%\n", result.m_samples, result.m_live_error * 100.0);
+        }
+        else {
+            printf("%14s %12s\n", "-", "-");
+        }
+    };
+
+    printf("%-22s %10s %10s %14s %12s\n", "configuration", "ns/op", "overhead", "live samples", "live error");
+    report("trait off", run_result_t{ baseline, 0, 0.0 }, false);
+    report("no sampler", measure<sampled_traits_t>(memory, nullptr), false);
+
+    struct profiled_configuration_t {
+        const char* m_name;
+        size_t m_interval;
+        heap_profiler_t::capture_mode_t m_capture_mode;
+    };
+    static const profiled_configuration_t k_configurations[] = {
+        { "tag, 512 KiB", 512 * 1024, heap_profiler_t::capture_mode_t::tag },
+        { "stack, 512 KiB", 512 * 1024, heap_profiler_t::capture_mode_t::stack },
+        { "stack, 64 KiB", 64 * 1024, heap_profiler_t::capture_mode_t::stack },
+        { "stack, 4 KiB", 4 * 1024, heap_profiler_t::capture_mode_t::stack },
+    };
+    for (const auto& configuration : k_configurations) {
+        heap_profiler_t profiler{ configuration.m_interval, configuration.m_capture_mode };
+        report(configuration.m_name, measure<sampled_traits_t>(memory, &profiler), true);
+    }
+
+    std::free(memory);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+    shows how much memory stays resident after a traffic spike, and what purging costs while the heap is in use.
+
+    the heap first grows to a few hundred MiB, then almost all of it is freed and a much smaller working set keeps
+    churning for a while. residency is measured with mincore over the whole heap, next to the allocator's own
+    resident_bytes(). the policies are: never purging, purging everything free every few operations without any
+    decay, and the decay epochs. the churn time shows the cost of faulting purged pages back in. linux only.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../minialloc_purge.hpp"
+
+struct never_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr uint32_t k_purge_decay_operations = 0;
+};
+
+struct decay_traits_t : never_traits_t {
+    static constexpr uint32_t k_purge_decay_operations = 8192;
+};
+
+struct lazy_decay_traits_t : decay_traits_t {
+    static constexpr bool k_purge_lazy_free = true;
+};
+
+static constexpr size_t k_memory_size = 512 * 1024 * 1024;
+static constexpr size_t k_max_allocations = 64 * 1024;
+static constexpr size_t k_spike_bytes = 384 * 1024 * 1024;
+static constexpr size_t k_working_set_bytes = 24 * 1024 * 1024;
+static constexpr size_t k_churn_operations = 1000000;
+
+static size_t random_block_size(std::mt19937_64& rng) {
+    if (rng() % 8 == 0) {
+        return 64 * 1024 + rng() % (192 * 1024);
+    }
+    return 256 + rng() % (16 * 1024);
+}
+
+static size_t mincore_resident(uint8_t* memory) {
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages(k_memory_size / page_size);
+    mincore(memory, k_memory_size, pages.data());
+    size_t resident_pages = 0;
+    for (auto page : pages) {
+        resident_pages += page & 1;
+    }
+    return resident_pages * page_size;
+}
+
+struct block_t {
+    uint8_t* m_memory;
+    size_t m_size;
+};
+
+//purge_interval != 0 calls purge_all every that many operations on top of the traits
+template<typename Traits>
+static void run(const char* name, size_t purge_interval) {
+    using purging_t = purging_allocator_template_t<Traits>;
+
+    auto memory = static_cast<uint8_t*>(mmap(nullptr, k_memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    auto allocator = new typename purging_t::allocator_t{ memory, k_memory_size, k_max_allocations };
+    std::mt19937_64 rng{ 42 };
+    std::vector<block_t> live{};
+    size_t live_bytes = 0;
+    size_t operations = 0;
+
+    auto count_operation = [&]() {
+        if (purge_interval != 0 && ++operations % purge_interval == 0) {
+            allocator->purge_all();
+        }
+    };
+    auto allocate_one = [&]() {
+        size_t size = random_block_size(rng);
+        auto block = static_cast<uint8_t*>(allocator->allocate(size));
+        if (block == nullptr) {
+            return;
+        }
+        memset(block, 0x5A, size);
+        live.push_back({ block, size });
+        live_bytes += size;
+        count_operation();
+    };
+    auto free_one = [&]() {
+        size_t index = rng() % live.size();
+        allocator->deallocate(live[index].m_memory, live[index].m_size);
+        live_bytes -= live[index].m_size;
+        live[index] = live.back();
+        live.pop_back();
+        count_operation();
+    };
+
+    while (live_bytes < k_spike_bytes && live.size() + 2 < k_max_allocations) {
+        allocate_one();
+    }
+    size_t spike_resident = mincore_resident(memory);
+    while (live_bytes > k_working_set_bytes) {
+        free_one();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t operation_index = 0; operation_index < k_churn_operations; operation_index += 2) {
+        free_one();
+        allocate_one();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    printf("%-16s %12zu %12zu %14zu %12llu %12.1f\n", name, spike_resident >> 20, mincore_resident(memory) >> 20,
+        allocator->resident_bytes() >> 20, static_cast<unsigned long long>(allocator->release_calls()),
+        std::chrono::duration<double, std::nano>(end - start).count() / k_churn_operations);
+
+    delete allocator;
+    munmap(memory, k_memory_size);
+}
+
+int main() {
+    printf("%-16s %12s %12s %14s %12s %12s\n", "policy", "spike MiB", "after MiB", "counted MiB", "madvise", "ns/op");
+    run<never_traits_t>("never", 0);
+    run<never_traits_t>("eager/1024 ops", 1024);
+    run<decay_traits_t>("decay", 0);
+    run<lazy_decay_traits_t>("decay, lazy", 0);
+    return 0;
+}
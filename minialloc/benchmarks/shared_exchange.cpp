@@ -0,0 +1,169 @@
+/*
+    compares two ways of moving buffers from one process to another: allocating them in a shared heap and sending
+    only their handle, and sending a copy of the whole buffer through a pipe.
+
+    a producer process fills every buffer and a consumer process reads all of it, so both sides touch every byte in
+    both variants. in the shared variant the handles go through a pipe and the consumer frees each buffer after
+    reading it, a second pipe carries credits back so no more than k_in_flight buffers are outstanding at a time.
+    posix only.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../minialloc_shared.hpp"
+
+struct shared_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+using shared_t = shared_allocator_template_t<shared_traits_t>;
+
+static constexpr size_t k_segment_size = 256 * 1024 * 1024;
+static constexpr size_t k_bytes_per_run = 1024 * 1024 * 1024;
+static constexpr size_t k_in_flight = 32;
+
+static void write_all(int descriptor, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size != 0) {
+        ssize_t written = write(descriptor, bytes, size);
+        assert(written > 0);
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+static bool read_all(int descriptor, void* data, size_t size) {
+    auto bytes = static_cast<uint8_t*>(data);
+    while (size != 0) {
+        ssize_t read_size = read(descriptor, bytes, size);
+        if (read_size <= 0) {
+            return false;
+        }
+        bytes += read_size;
+        size -= static_cast<size_t>(read_size);
+    }
+    return true;
+}
+
+static uint64_t consume(const uint8_t* buffer, size_t size) {
+    uint64_t sum = 0;
+    for (size_t byte_index = 0; byte_index < size; byte_index += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, buffer + byte_index, sizeof(word));
+        sum += word;
+    }
+    return sum;
+}
+
+//seconds to move message_count buffers of message_size bytes
+static double run_shared(shared_t::shared_segment_t& segment, size_t message_size, size_t message_count) {
+    int handles[2];
+    int credits[2];
+    pipe(handles);
+    pipe(credits);
+
+    pid_t consumer = fork();
+    if (consumer == 0) {
+        close(handles[1]);
+        close(credits[0]);
+        shared_t::shared_segment_t mapping{};
+        mapping.open_descriptor(segment.m_descriptor);
+        shared_t::allocator_t allocator{ mapping.m_memory };
+
+        uint64_t sum = 0;
+        shared_handle_t handle;
+        while (read_all(handles[0], &handle, sizeof(handle))) {
+            auto buffer = static_cast<uint8_t*>(allocator.from_handle(handle));
+            sum += consume(buffer, message_size);
+            allocator.deallocate(buffer);
+            uint8_t credit = 1;
+            write_all(credits[1], &credit, 1);
+        }
+        _exit(sum == 0 ? 1 : 0);
+    }
+    close(handles[0]);
+    close(credits[1]);
+
+    shared_t::allocator_t allocator{ segment.m_memory };
+    auto start = std::chrono::steady_clock::now();
+    for (size_t message_index = 0; message_index < message_count; ++message_index) {
+        if (message_index >= k_in_flight) {
+            uint8_t credit;
+            read_all(credits[0], &credit, 1);
+        }
+        auto buffer = allocator.allocate(message_size);
+        assert(buffer != nullptr);
+        memset(buffer, static_cast<int>(message_index | 1), message_size);
+        shared_handle_t handle = allocator.to_handle(buffer);
+        write_all(handles[1], &handle, sizeof(handle));
+    }
+    close(handles[1]);
+    waitpid(consumer, nullptr, 0);
+    auto end = std::chrono::steady_clock::now();
+    close(credits[0]);
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static double run_pipe(size_t message_size, size_t message_count) {
+    int messages[2];
+    pipe(messages);
+
+    pid_t consumer = fork();
+    if (consumer == 0) {
+        close(messages[1]);
+        std::vector<uint8_t> buffer(message_size);
+        uint64_t sum = 0;
+        while (read_all(messages[0], buffer.data(), message_size)) {
+            sum += consume(buffer.data(), message_size);
+        }
+        _exit(sum == 0 ? 1 : 0);
+    }
+    close(messages[0]);
+
+    std::vector<uint8_t> buffer(message_size);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t message_index = 0; message_index < message_count; ++message_index) {
+        memset(buffer.data(), static_cast<int>(message_index | 1), message_size);
+        write_all(messages[1], buffer.data(), message_size);
+    }
+    close(messages[1]);
+    waitpid(consumer, nullptr, 0);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+    shared_t::shared_segment_t segment{};
+    if (!segment.create(nullptr, k_segment_size)) {
+        printf("could not create the shared segment\n");
+        return 1;
+    }
+    shared_t::allocator_t::format(segment.m_memory, k_segment_size, 4096);
+
+    printf("%12s %10s %14s %14s %14s %14s\n", "message", "count", "shared MiB/s", "pipe MiB/s", "shared msg/s", "pipe msg/s");
+    for (size_t message_size : { 64, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024 }) {
+        size_t message_count = k_bytes_per_run / message_size;
+        if (message_count > 1000000) {
+            message_count = 1000000;
+        }
+        double shared_seconds = run_shared(segment, message_size, message_count);
+        double pipe_seconds = run_pipe(message_size, message_count);
+        double mebibytes = static_cast<double>(message_size) * message_count / (1024.0 * 1024.0);
+
+        printf("%12zu %10zu %14.1f %14.1f %14.0f %14.0f\n", message_size, message_count,
+            mebibytes / shared_seconds, mebibytes / pipe_seconds,
+            message_count / shared_seconds, message_count / pipe_seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*
+    throughput of concurrent_allocator_template_t against one allocator_t behind a global mutex,
+    for 1 to 64 threads. every thread keeps a working set of small blocks and replaces a random one per
+    iteration, and every 8th block is swapped through a shared exchange array so it ends up being freed
+    by a different thread than the one that allocated it.
+
+    usage: thread_cache_scaling [iterations per thread]
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../minialloc_thread_cache.hpp"
+
+struct benchmark_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr bool k_use_address_tree = true;
+};
+
+using backing_allocator_t = allocator_template_t<benchmark_traits_t>::allocator_t;
+using concurrent_t = concurrent_allocator_template_t<benchmark_traits_t>;
+
+static constexpr size_t k_memory_size = 256 * 1024 * 1024;
+static constexpr size_t k_max_allocations = 1 << 20;
+static constexpr uint32_t k_working_set = 64;
+static constexpr uint32_t k_exchange_slots = 256;
+
+//blocks store their own size in the first word, so whichever thread frees them knows it
+static size_t block_size_of(void* block) {
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    return size;
+}
+
+struct mutex_allocator_t {
+    backing_allocator_t m_allocator;
+    std::mutex m_lock;
+
+    void* allocate(size_t size) {
+        std::lock_guard<std::mutex> guard{ m_lock };
+        return m_allocator.allocate(size);
+    }
+
+    void deallocate(void* memory, size_t size) {
+        std::lock_guard<std::mutex> guard{ m_lock };
+        m_allocator.deallocate(memory, size);
+    }
+};
+
+template<typename AllocateFn, typename DeallocateFn>
+static void run_worker(uint32_t thread_index, uint32_t iterations, std::atomic<void*>* exchange, AllocateFn&& allocate, DeallocateFn&& deallocate) {
+    std::mt19937 rng{ thread_index };
+    void* working_set[k_working_set] = {};
+
+    auto new_block = [&]() {
+        size_t size = 16 + (rng() % 241);
+        void* block = allocate(size);
+        memcpy(block, &size, sizeof(size));
+        return block;
+    };
+
+    for (auto& block : working_set) {
+        block = new_block();
+    }
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        uint32_t victim = rng() % k_working_set;
+        void* block = working_set[victim];
+
+        if ((iteration & 7) == 0) {
+            block = exchange[rng() % k_exchange_slots].exchange(block, std::memory_order_acq_rel);
+        }
+        if (block != nullptr) {
+            deallocate(block, block_size_of(block));
+        }
+        working_set[victim] = new_block();
+    }
+
+    for (auto block : working_set) {
+        deallocate(block, block_size_of(block));
+    }
+}
+
+//blocks still parked in the exchange array afterwards are handed to release
+template<typename RunFn, typename ReleaseFn>
+static double measure(uint32_t thread_count, uint32_t iterations, RunFn&& run, ReleaseFn&& release) {
+    std::vector<std::atomic<void*>> exchange(k_exchange_slots);
+    for (auto& slot : exchange) {
+        slot.store(nullptr);
+    }
+
+    std::atomic<uint32_t> ready{ 0 };
+    std::vector<std::thread> threads{};
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+        threads.emplace_back([&, thread_index]() {
+            run(thread_index, iterations, exchange.data());
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    for (auto& slot : exchange) {
+        if (void* block = slot.load()) {
+            release(block);
+        }
+    }
+
+    //one allocate and one free per iteration
+    double operations = 2.0 * thread_count * iterations;
+    return operations / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 100000;
+
+    uint8_t* memory = static_cast<uint8_t*>(std::malloc(k_memory_size + 64));
+    uint8_t* aligned_memory = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(memory) + 63) & ~static_cast<uintptr_t>(63));
+
+    printf("%8s %18s %18s %10s\n", "threads", "mutex Mops/s", "cached Mops/s", "speedup");
+
+    for (uint32_t thread_count : { 1u, 2u, 4u, 8u, 16u, 32u, 64u }) {
+        double mutex_ops;
+        {
+            auto baseline = new mutex_allocator_t{ backing_allocator_t{ aligned_memory, k_memory_size, k_max_allocations }, {} };
+            mutex_ops = measure(thread_count, iterations, [&](uint32_t thread_index, uint32_t thread_iterations, std::atomic<void*>* exchange) {
+                run_worker(thread_index, thread_iterations, exchange,
+                    [&](size_t size) { return baseline->allocate(size); },
+                    [&](void* block, size_t size) { baseline->deallocate(block, size); });
+            }, [&](void* block) { baseline->deallocate(block, block_size_of(block)); });
+            delete baseline;
+        }
+
+        double cached_ops;
+        {
+            auto shared = new concurrent_t::allocator_t{ aligned_memory, k_memory_size, k_max_allocations };
+            cached_ops = measure(thread_count, iterations, [&](uint32_t thread_index, uint32_t thread_iterations, std::atomic<void*>* exchange) {
+                concurrent_t::thread_cache_t cache{ *shared };
+                run_worker(thread_index, thread_iterations, exchange,
+                    [&](size_t size) { return cache.allocate(size); },
+                    [&](void* block, size_t size) { cache.deallocate(block, size); });
+            }, [&](void* block) { shared->deallocate(block, block_size_of(block)); });
+            shared->collect_returned_blocks();
+            delete shared;
+        }
+
+        printf("%8u %18.2f %18.2f %9.2fx\n", thread_count, mutex_ops / 1e6, cached_ops / 1e6, cached_ops / mutex_ops);
+    }
+
+    std::free(memory);
+    return 0;
+}
@@ -1,5 +1,318 @@
 #pragma once
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+//lets a traits struct omit newer options, they fall back to default_value
+#define MINIALLOC_OPTIONAL_TRAIT(trait_name, value_type, default_value) \
+    template<typename Traits, typename = void> \
+    struct optional_##trait_name##_t : std::integral_constant<value_type, default_value> {}; \
+    template<typename Traits> \
+    struct optional_##trait_name##_t<Traits, std::void_t<decltype(Traits::trait_name)>> : std::integral_constant<value_type, Traits::trait_name> {};
+
+enum class allocator_layout_t {
+    //free regions are described by nodes from a pool of max_allocations nodes at the front of the memory
+    node_pool,
+    //every block carries its own header and free blocks a footer, there is no limit on the number of free regions
+    boundary_tags
+};
+
+enum class search_policy_t {
+    //walk the address ordered free list and take the first node that is large enough
+    first_fit,
+    //additionally bucket free nodes by size class (two level segregated fit), allocation is O(1)
+    segregated_fit,
+    //keep the sizes of free nodes in a packed array and take the smallest node that fits, the scan uses AVX2 or SSE4.1 when the compiler targets them
+    packed_best_fit
+};
+
+MINIALLOC_OPTIONAL_TRAIT(k_layout, allocator_layout_t, allocator_layout_t::node_pool)
+MINIALLOC_OPTIONAL_TRAIT(k_search_policy, search_policy_t, search_policy_t::first_fit)
+//keep free nodes in an address ordered red-black tree as well, deallocate finds its neighbors in O(log n)
+MINIALLOC_OPTIONAL_TRAIT(k_use_address_tree, bool, false)
+//record the end of every live block in a bitmap (one bit per k_allocation_alignment bytes), so deallocate(memory) works without a size.
+//only the node pool layout needs it, boundary tag blocks always know their size
+MINIALLOC_OPTIONAL_TRAIT(k_track_allocation_sizes, bool, false)
+//maintain usage counters and scan length histograms, see allocator_t::statistics(). compiled out when false
+MINIALLOC_OPTIONAL_TRAIT(k_collect_statistics, bool, false)
+
+/*
+    compact nodes: the fields of free nodes can be stored in a narrower type than displacement_type_t, which is
+    still what the allocator computes with. node links hold byte displacements, base and size of the free region
+    are divided by k_allocation_alignment first when k_scale_node_fields is set. with uint16_t fields and no
+    search policy or address tree extras a node is 8 bytes, for memory of up to 65535 * k_allocation_alignment
+    bytes. relative displacements and the node pool layout only
+*/
+template<typename Traits, typename = void>
+struct optional_node_field_type_t {
+    using type = typename Traits::displacement_type_t;
+};
+template<typename Traits>
+struct optional_node_field_type_t<Traits, std::void_t<typename Traits::node_field_type_t>> {
+    using type = typename Traits::node_field_type_t;
+};
+
+MINIALLOC_OPTIONAL_TRAIT(k_scale_node_fields, bool, false)
+
+enum class lifetime_t {
+    //carved from the low end of the region the search policy picks, as allocate always did
+    transient,
+    //carved from the high end of the highest addressed region that fits, so blocks that stay around collect at the
+    //top of the heap instead of pinning the holes transient blocks leave behind. node pool layout only
+    long_lived
+};
+
+//what allocate(size) without a lifetime hint does
+MINIALLOC_OPTIONAL_TRAIT(k_default_lifetime, lifetime_t, lifetime_t::transient)
+
+enum class hardening_level_t {
+    //no checks outside of MINIALLOC_VERIFY builds
+    none,
+    //O(1) checks that stay in release builds, on the free nodes (or blocks) an operation touches: link symmetry,
+    //bounds, and that a freed range does not overlap the free memory around it
+    local,
+    //local, plus a size tag for every live block, so a double free or a deallocate with the wrong size is caught
+    //even after the memory around the block changed. the node pool layout keeps the tags in the size table
+    //(this implies k_track_allocation_sizes), boundary tag blocks have them in their headers already
+    size_tags
+};
+
+MINIALLOC_OPTIONAL_TRAIT(k_hardening_level, hardening_level_t, hardening_level_t::none)
+//run check_integrity() every this many allocations and frees, 0 never does. works without MINIALLOC_VERIFY
+MINIALLOC_OPTIONAL_TRAIT(k_validation_interval, uint32_t, 0)
+
+//what a failed hardening check does, define it before including minialloc.hpp to report failures differently. it must not return
+#ifndef MINIALLOC_HARDENING_FAILURE
+#define MINIALLOC_HARDENING_FAILURE(message) (fprintf(stderr, "minialloc: %s\n", message), abort())
+#endif
+
+inline void minialloc_hardening_check(bool condition, const char* message) {
+    if (!condition) {
+        MINIALLOC_HARDENING_FAILURE(message);
+    }
+}
+
+//report every allocate, deallocate and in place resize to the recorder given to set_recorder(). compiled out when false
+MINIALLOC_OPTIONAL_TRAIT(k_record_operations, bool, false)
+
+/*
+    receives the operations of an allocator_t with k_record_operations, minialloc_trace.hpp has one that writes
+    them to a trace file. a reallocate that moves the block shows up as an allocate and a deallocate, one that
+    stays in place as a resize. a block slide_down moves is reported with record_move
+*/
+struct allocation_recorder_t {
+    //alignment is 1 for plain allocations
+    virtual void record_allocate(void* memory, size_t allocation_size, size_t alignment) = 0;
+    virtual void record_deallocate(void* memory, size_t allocation_size) = 0;
+    virtual void record_resize(void* memory, size_t old_size, size_t new_size) = 0;
+    //every live block was freed at once by reset()
+    virtual void record_reset() = 0;
+    //every live block at or above frontier was freed at once by release_to()
+    virtual void record_release_to(void* frontier) = 0;
+    //slide_down moved a live block, it keeps its size and contents
+    virtual void record_move(void* from, void* to, size_t allocation_size) = 0;
+
+protected:
+    ~allocation_recorder_t() = default;
+};
+
+//hand roughly one allocation per sample interval bytes to the sampler given to set_sampler(). compiled out when false
+MINIALLOC_OPTIONAL_TRAIT(k_sample_allocations, bool, false)
+
+/*
+    receives the sampled allocations of an allocator_t with k_sample_allocations, minialloc_profiler.hpp has a
+    heap profiler built on it. the allocator counts down the bytes next_sample_interval() returned and hands
+    over the block that crosses zero. frees only reach the sampler for blocks might_be_sampled() lets through,
+    a table of counters indexed by the block address that the sampler keeps up to date with filter_add and
+    filter_remove. a sampler serves one allocator, with the same (lack of) locking. blocks moved by slide_down
+    reach sample_move, through the same filter
+*/
+struct allocation_sampler_t {
+    static constexpr uint32_t k_filter_size = 4096;
+
+    virtual size_t next_sample_interval() = 0;
+    virtual void sample_allocate(void* memory, size_t allocation_size) = 0;
+    virtual void sample_deallocate(void* memory) = 0;
+    virtual void sample_resize(void* memory, size_t new_size) = 0;
+    //every live block was freed at once by reset()
+    virtual void sample_reset() = 0;
+    //every live block at or above frontier was freed at once by release_to()
+    virtual void sample_release_to(void* frontier) = 0;
+    //slide_down moved a block that might_be_sampled() let through
+    virtual void sample_move(void* from, void* to) = 0;
+    //allocate() is about to fail its assert, the last chance to find out what holds the memory
+    virtual void allocation_failed(size_t allocation_size) = 0;
+
+    //never false for a live sampled block
+    bool might_be_sampled(const void* memory) const {
+        return m_filter[filter_slot(memory)] != 0;
+    }
+
+protected:
+    ~allocation_sampler_t() = default;
+
+    static uint32_t filter_slot(const void* memory) {
+        uint64_t address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(memory));
+        return static_cast<uint32_t>((address * 0x9E3779B97F4A7C15ull) >> 52) & (k_filter_size - 1);
+    }
+
+    void filter_add(const void* memory) {
+        assert(m_filter[filter_slot(memory)] != UINT16_MAX);
+        ++m_filter[filter_slot(memory)];
+    }
+
+    void filter_remove(const void* memory) {
+        assert(m_filter[filter_slot(memory)] != 0);
+        --m_filter[filter_slot(memory)];
+    }
+
+    void filter_clear() {
+        memset(m_filter, 0, sizeof(m_filter));
+    }
+
+    uint16_t m_filter[k_filter_size] = {};
+};
+
+//index of the lowest set bit, value must not be zero
+inline uint32_t minialloc_bitscan_forward(uint64_t value) {
+    assert(value != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanForward64(&index, value);
+#else
+    if (!_BitScanForward(&index, static_cast<uint32_t>(value))) {
+        _BitScanForward(&index, static_cast<uint32_t>(value >> 32));
+        index += 32;
+    }
+#endif
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+//index of the highest set bit, value must not be zero
+inline uint32_t minialloc_bitscan_reverse(uint64_t value) {
+    assert(value != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanReverse64(&index, value);
+#else
+    if (_BitScanReverse(&index, static_cast<uint32_t>(value >> 32))) {
+        index += 32;
+    }
+    else {
+        _BitScanReverse(&index, static_cast<uint32_t>(value));
+    }
+#endif
+    return index;
+#else
+    return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+//number of set bits
+inline uint32_t minialloc_popcount(uint64_t value) {
+#if defined(_MSC_VER)
+#if defined(_M_X64)
+    return static_cast<uint32_t>(__popcnt64(value));
+#else
+    return __popcnt(static_cast<uint32_t>(value)) + __popcnt(static_cast<uint32_t>(value >> 32));
+#endif
+#else
+    return static_cast<uint32_t>(__builtin_popcountll(value));
+#endif
+}
+
+constexpr uint32_t minialloc_log2(uint64_t value) {
+    return value <= 1 ? 0 : 1 + minialloc_log2(value >> 1);
+}
+
+/*
+    smallest (key - request) over count packed keys, computed modulo 2^32. keys below the request wrap around to
+    values above ~0u - request, so the result is the best fit difference whenever it is at most ~0u - request
+*/
+inline uint32_t minialloc_packed_min_difference(const uint32_t* keys, size_t count, uint32_t request) {
+    uint32_t best = ~0u;
+    size_t key_index = 0;
+#if defined(__AVX2__)
+    if (count >= 8) {
+        __m256i requests = _mm256_set1_epi32(static_cast<int>(request));
+        __m256i best_differences = _mm256_set1_epi32(-1);
+        for (; key_index + 8 <= count; key_index += 8) {
+            __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + key_index));
+            best_differences = _mm256_min_epu32(best_differences, _mm256_sub_epi32(values, requests));
+        }
+        __m128i lanes = _mm_min_epu32(_mm256_castsi256_si128(best_differences), _mm256_extracti128_si256(best_differences, 1));
+        lanes = _mm_min_epu32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+        lanes = _mm_min_epu32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+        best = static_cast<uint32_t>(_mm_cvtsi128_si32(lanes));
+    }
+#elif defined(__SSE4_1__)
+    if (count >= 4) {
+        __m128i requests = _mm_set1_epi32(static_cast<int>(request));
+        __m128i best_differences = _mm_set1_epi32(-1);
+        for (; key_index + 4 <= count; key_index += 4) {
+            __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + key_index));
+            best_differences = _mm_min_epu32(best_differences, _mm_sub_epi32(values, requests));
+        }
+        best_differences = _mm_min_epu32(best_differences, _mm_shuffle_epi32(best_differences, _MM_SHUFFLE(1, 0, 3, 2)));
+        best_differences = _mm_min_epu32(best_differences, _mm_shuffle_epi32(best_differences, _MM_SHUFFLE(2, 3, 0, 1)));
+        best = static_cast<uint32_t>(_mm_cvtsi128_si32(best_differences));
+    }
+#endif
+    for (; key_index < count; ++key_index) {
+        uint32_t difference = keys[key_index] - request;
+        if (difference < best) {
+            best = difference;
+        }
+    }
+    return best;
+}
+
+//index of the first packed key equal to value, or count if there is none
+inline size_t minialloc_packed_find(const uint32_t* keys, size_t count, uint32_t value) {
+    size_t key_index = 0;
+#if defined(__AVX2__)
+    __m256i values = _mm256_set1_epi32(static_cast<int>(value));
+    for (; key_index + 8 <= count; key_index += 8) {
+        __m256i matches = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + key_index)), values);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(matches)));
+        if (mask != 0) {
+            return key_index + minialloc_bitscan_forward(mask);
+        }
+    }
+#elif defined(__SSE4_1__)
+    __m128i values = _mm_set1_epi32(static_cast<int>(value));
+    for (; key_index + 4 <= count; key_index += 4) {
+        __m128i matches = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + key_index)), values);
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(matches)));
+        if (mask != 0) {
+            return key_index + minialloc_bitscan_forward(mask);
+        }
+    }
+#endif
+    for (; key_index < count; ++key_index) {
+        if (keys[key_index] == value) {
+            return key_index;
+        }
+    }
+    return count;
+}
+
 template<typename Traits> 
 struct allocator_template_t {
 
@@ -7,31 +320,453 @@ struct allocator_template_t {
     using size_type_t = typename Traits::size_type_t;
 
     static constexpr size_type_t k_imposed_alignment = Traits::k_allocation_alignment;
+    static_assert((k_imposed_alignment & (k_imposed_alignment - 1)) == 0);
+
+    static constexpr allocator_layout_t k_layout = optional_k_layout_t<Traits>::value;
+    static constexpr bool k_use_boundary_tags = k_layout == allocator_layout_t::boundary_tags;
+
+    using node_field_type_t = typename optional_node_field_type_t<Traits>::type;
+    static constexpr bool k_scale_node_fields = optional_k_scale_node_fields_t<Traits>::value;
+    static constexpr bool k_compact_nodes = k_scale_node_fields || !std::is_same_v<node_field_type_t, allocation_displacement_t>;
+
+    static_assert(!k_compact_nodes || !Traits::k_use_absolute_pointers, "compact nodes hold displacements relative to the memory");
+    static_assert(!k_compact_nodes || !k_use_boundary_tags, "compact nodes require the node pool layout");
+    static_assert(std::is_integral_v<node_field_type_t> && sizeof(node_field_type_t) <= sizeof(allocation_displacement_t));
+    //every stored value times the scale has to come back as a positive displacement
+    static constexpr uint64_t k_max_node_field = static_cast<uint64_t>(std::numeric_limits<node_field_type_t>::max());
+    static constexpr uint64_t k_node_field_scale = k_scale_node_fields ? static_cast<uint64_t>(k_imposed_alignment) : 1;
+    static_assert(k_max_node_field <= static_cast<uint64_t>(std::numeric_limits<allocation_displacement_t>::max()) / k_node_field_scale);
+    static_assert(k_max_node_field * k_node_field_scale <= static_cast<uint64_t>(std::numeric_limits<size_type_t>::max()));
+
+    //the most memory (and the most bytes of nodes) a compact node can describe, unlimited otherwise
+    static constexpr size_type_t k_max_compact_memory_size = k_compact_nodes ? static_cast<size_type_t>(k_max_node_field * k_node_field_scale) : std::numeric_limits<size_type_t>::max();
+    static constexpr size_type_t k_max_compact_link = k_compact_nodes ? static_cast<size_type_t>(k_max_node_field) : std::numeric_limits<size_type_t>::max();
+
+    //a node field kept as node_field_type_t, it reads and writes as a displacement that is a multiple of Scale
+    template<uint64_t Scale>
+    struct compact_field_t {
+        node_field_type_t m_stored;
+
+        operator allocation_displacement_t() const {
+            return static_cast<allocation_displacement_t>(m_stored) * static_cast<allocation_displacement_t>(Scale);
+        }
+
+        compact_field_t& operator=(allocation_displacement_t value) {
+            assert(value >= 0 && static_cast<uint64_t>(value) % Scale == 0 && static_cast<uint64_t>(value) / Scale <= k_max_node_field);
+            m_stored = static_cast<node_field_type_t>(static_cast<uint64_t>(value) / Scale);
+            return *this;
+        }
+
+        compact_field_t& operator+=(allocation_displacement_t value) {
+            return *this = static_cast<allocation_displacement_t>(*this) + value;
+        }
+
+        compact_field_t& operator-=(allocation_displacement_t value) {
+            return *this = static_cast<allocation_displacement_t>(*this) - value;
+        }
+    };
+
+    //links between nodes, and base and size of the free region. plain displacements unless the nodes are compact
+    using node_link_t = std::conditional_t<k_compact_nodes, compact_field_t<1>, allocation_displacement_t>;
+    using node_extent_t = std::conditional_t<k_compact_nodes, compact_field_t<k_node_field_scale>, allocation_displacement_t>;
+
+    static constexpr search_policy_t k_search_policy = optional_k_search_policy_t<Traits>::value;
+    static constexpr bool k_use_size_classes = k_search_policy == search_policy_t::segregated_fit;
+
+    struct size_class_links_t {
+        //free nodes that share a size class, in no particular order
+        node_link_t m_next_in_class;
+        node_link_t m_previous_in_class;
+    };
+
+    static constexpr bool k_use_packed_sizes = k_search_policy == search_policy_t::packed_best_fit;
+
+    struct packed_size_links_t {
+        //position of the node in the packed size arrays
+        size_type_t m_packed_index;
+    };
+
+    static constexpr bool k_use_address_tree = optional_k_use_address_tree_t<Traits>::value;
+    static constexpr bool k_collect_statistics = optional_k_collect_statistics_t<Traits>::value;
+    static constexpr hardening_level_t k_hardening_level = optional_k_hardening_level_t<Traits>::value;
+    static constexpr bool k_local_checks = k_hardening_level != hardening_level_t::none;
+    static constexpr bool k_size_tags = k_hardening_level == hardening_level_t::size_tags;
+    static constexpr uint32_t k_validation_interval = optional_k_validation_interval_t<Traits>::value;
+    static constexpr bool k_track_allocation_sizes = optional_k_track_allocation_sizes_t<Traits>::value || (k_size_tags && !k_use_boundary_tags);
+    static constexpr lifetime_t k_default_lifetime = optional_k_default_lifetime_t<Traits>::value;
+    static_assert(k_default_lifetime == lifetime_t::transient || !k_use_boundary_tags, "lifetime hints require the node pool layout");
+
+    struct address_tree_links_t {
+        node_link_t m_left_node;
+        node_link_t m_right_node;
+        //the lowest bit is set when the node is red, nodes are at least 2 byte aligned so it is never part of the displacement
+        node_link_t m_parent_and_color;
+    };
+
+    struct empty_t {};
+    struct no_size_class_links_t {};
+    struct no_address_tree_links_t {};
+    struct no_packed_size_links_t {};
+
+    //forwards to the allocation_recorder_t of an allocator if it has one, with k_record_operations
+    struct operation_recorder_t {
+        allocation_recorder_t* m_recorder = nullptr;
+
+        void allocate(void* memory, size_type_t allocation_size, size_type_t alignment) {
+            if (m_recorder != nullptr && memory != nullptr) {
+                m_recorder->record_allocate(memory, allocation_size, alignment);
+            }
+        }
+
+        void deallocate(void* memory, size_type_t allocation_size) {
+            if (m_recorder != nullptr) {
+                m_recorder->record_deallocate(memory, allocation_size);
+            }
+        }
+
+        void resize(void* memory, size_type_t old_size, size_type_t new_size) {
+            if (m_recorder != nullptr) {
+                m_recorder->record_resize(memory, old_size, new_size);
+            }
+        }
+
+        void reset() {
+            if (m_recorder != nullptr) {
+                m_recorder->record_reset();
+            }
+        }
+
+        void release_to(void* frontier) {
+            if (m_recorder != nullptr) {
+                m_recorder->record_release_to(frontier);
+            }
+        }
+
+        void move(void* from, void* to, size_type_t allocation_size) {
+            if (m_recorder != nullptr) {
+                m_recorder->record_move(from, to, allocation_size);
+            }
+        }
+    };
+
+    //without k_record_operations every call compiles to nothing
+    struct no_operation_recorder_t {
+        void allocate(void*, size_type_t, size_type_t) {}
+        void deallocate(void*, size_type_t) {}
+        void resize(void*, size_type_t, size_type_t) {}
+        void reset() {}
+        void release_to(void*) {}
+        void move(void*, void*, size_type_t) {}
+    };
+
+    static constexpr bool k_record_operations = optional_k_record_operations_t<Traits>::value;
+    static constexpr bool k_sample_allocations = optional_k_sample_allocations_t<Traits>::value;
+
+    //counts allocated bytes down to the next sample for the allocation_sampler_t of an allocator, with k_sample_allocations
+    struct operation_sampler_t {
+        allocation_sampler_t* m_sampler = nullptr;
+        size_t m_bytes_until_sample = 0;
+
+        void attach(allocation_sampler_t* sampler) {
+            m_sampler = sampler;
+            m_bytes_until_sample = sampler != nullptr ? sampler->next_sample_interval() : 0;
+        }
 
-    struct allocation_node_t {
-        allocation_displacement_t m_base;
-        allocation_displacement_t m_size;
-        allocation_displacement_t m_next_node;
-        allocation_displacement_t m_previous_node;
+        void allocate(void* memory, size_type_t allocation_size, size_type_t) {
+            if (m_sampler != nullptr && memory != nullptr) {
+                if (allocation_size < m_bytes_until_sample) {
+                    m_bytes_until_sample -= allocation_size;
+                    return;
+                }
+                m_sampler->sample_allocate(memory, allocation_size);
+                m_bytes_until_sample = m_sampler->next_sample_interval();
+            }
+        }
+
+        void deallocate(void* memory, size_type_t) {
+            if (m_sampler != nullptr && m_sampler->might_be_sampled(memory)) {
+                m_sampler->sample_deallocate(memory);
+            }
+        }
+
+        void resize(void* memory, size_type_t, size_type_t new_size) {
+            if (m_sampler != nullptr && m_sampler->might_be_sampled(memory)) {
+                m_sampler->sample_resize(memory, new_size);
+            }
+        }
+
+        void reset() {
+            if (m_sampler != nullptr) {
+                m_sampler->sample_reset();
+            }
+        }
+
+        void release_to(void* frontier) {
+            if (m_sampler != nullptr) {
+                m_sampler->sample_release_to(frontier);
+            }
+        }
+
+        void move(void* from, void* to, size_type_t) {
+            if (m_sampler != nullptr && m_sampler->might_be_sampled(from)) {
+                m_sampler->sample_move(from, to);
+            }
+        }
+
+        void allocation_failed(size_type_t allocation_size) {
+            if (m_sampler != nullptr) {
+                m_sampler->allocation_failed(allocation_size);
+            }
+        }
+    };
+
+    struct no_operation_sampler_t {
+        void allocate(void*, size_type_t, size_type_t) {}
+        void deallocate(void*, size_type_t) {}
+        void resize(void*, size_type_t, size_type_t) {}
+        void reset() {}
+        void release_to(void*) {}
+        void move(void*, void*, size_type_t) {}
+        void allocation_failed(size_type_t) {}
+    };
+
+    using recorder_part_t = std::conditional_t<k_record_operations, operation_recorder_t, no_operation_recorder_t>;
+    using sampler_part_t = std::conditional_t<k_sample_allocations, operation_sampler_t, no_operation_sampler_t>;
+
+    //everything that watches the operations of an allocator, an empty object when neither trait is set
+    struct operation_hooks_t : recorder_part_t, sampler_part_t {
+        void allocate(void* memory, size_type_t allocation_size, size_type_t alignment) {
+            recorder_part_t::allocate(memory, allocation_size, alignment);
+            sampler_part_t::allocate(memory, allocation_size, alignment);
+        }
+
+        void deallocate(void* memory, size_type_t allocation_size) {
+            recorder_part_t::deallocate(memory, allocation_size);
+            sampler_part_t::deallocate(memory, allocation_size);
+        }
+
+        void resize(void* memory, size_type_t old_size, size_type_t new_size) {
+            recorder_part_t::resize(memory, old_size, new_size);
+            sampler_part_t::resize(memory, old_size, new_size);
+        }
+
+        void reset() {
+            recorder_part_t::reset();
+            sampler_part_t::reset();
+        }
+
+        void release_to(void* frontier) {
+            recorder_part_t::release_to(frontier);
+            sampler_part_t::release_to(frontier);
+        }
+
+        void move(void* from, void* to, size_type_t allocation_size) {
+            recorder_part_t::move(from, to, allocation_size);
+            sampler_part_t::move(from, to, allocation_size);
+        }
+    };
+
+    struct allocation_node_t : std::conditional_t<k_use_size_classes, size_class_links_t, no_size_class_links_t>,
+        std::conditional_t<k_use_address_tree, address_tree_links_t, no_address_tree_links_t>,
+        std::conditional_t<k_use_packed_sizes, packed_size_links_t, no_packed_size_links_t> {
+        node_extent_t m_base;
+        node_extent_t m_size;
+        node_link_t m_next_node;
+        node_link_t m_previous_node;
     };
-    static_assert(k_imposed_alignment <= sizeof(allocation_node_t));
+    //compact nodes can be smaller than the alignment, the node pool footprint is rounded up to it either way
+    static_assert(k_imposed_alignment <= sizeof(allocation_node_t) || k_compact_nodes);
+    //without the extra links of a search policy or the address tree a compact node is its four fields and nothing else
+    static_assert(!k_compact_nodes || k_use_size_classes || k_use_address_tree || k_use_packed_sizes || sizeof(allocation_node_t) == 4 * sizeof(node_field_type_t));
 
     static constexpr allocation_displacement_t k_bad_displacement = 0;
     static constexpr bool k_use_absolute_pointers = Traits::k_use_absolute_pointers;
 
-    struct allocator_t {
+    /*
+        size class mapping for segregated_fit. the first level is the power of two range of the size,
+        the second level splits that range into k_second_level_count linear steps. sizes below
+        k_small_block_size all land in first level 0 with one second level slot per alignment step
+    */
+    static constexpr uint32_t k_second_level_bits = 4;
+    static constexpr uint32_t k_second_level_count = 1u << k_second_level_bits;
+    static constexpr uint32_t k_alignment_bits = minialloc_log2(k_imposed_alignment);
+    static constexpr uint32_t k_first_level_shift = k_second_level_bits + k_alignment_bits;
+    static constexpr uint32_t k_first_level_count = static_cast<uint32_t>(sizeof(size_type_t) * 8) - k_first_level_shift + 1;
+    static constexpr size_type_t k_small_block_size = static_cast<size_type_t>(1) << k_first_level_shift;
+    //first level bitmap is 64 bits wide
+    static_assert(k_first_level_count <= 64);
+
+    static void size_class_mapping(size_type_t size, uint32_t& first_level, uint32_t& second_level) {
+        if (size < k_small_block_size) {
+            first_level = 0;
+            second_level = static_cast<uint32_t>(size >> k_alignment_bits);
+        }
+        else {
+            uint32_t highest_bit = minialloc_bitscan_reverse(size);
+            second_level = static_cast<uint32_t>(size >> (highest_bit - k_second_level_bits)) ^ k_second_level_count;
+            first_level = highest_bit - (k_first_level_shift - 1);
+        }
+    }
+
+    //rounds the size up to the next size class boundary, so every region found in the resulting class is large enough
+    static bool size_class_search_mapping(size_type_t size, uint32_t& first_level, uint32_t& second_level) {
+        if (size >= k_small_block_size) {
+            size_type_t round = (static_cast<size_type_t>(1) << (minialloc_bitscan_reverse(size) - k_second_level_bits)) - 1;
+            if (size > static_cast<size_type_t>(~static_cast<size_type_t>(0)) - round) {
+                return false;
+            }
+            size += round;
+        }
+        size_class_mapping(size, first_level, second_level);
+        return first_level < k_first_level_count;
+    }
+
+    //heads of the per size class free lists, the lists themselves are threaded through whatever describes a free region
+    struct size_class_index_t {
+        //bit n is set when m_second_level_bitmaps[n] is non zero
+        uint64_t m_first_level_bitmap;
+        //bit n of entry i is set when m_heads[i][n] is not k_bad_displacement
+        uint32_t m_second_level_bitmaps[k_first_level_count];
+        allocation_displacement_t m_heads[k_first_level_count][k_second_level_count];
+
+        void mark_non_empty(uint32_t first_level, uint32_t second_level) {
+            m_first_level_bitmap |= static_cast<uint64_t>(1) << first_level;
+            m_second_level_bitmaps[first_level] |= 1u << second_level;
+        }
+
+        //call once the head of the class became k_bad_displacement
+        void mark_empty(uint32_t first_level, uint32_t second_level) {
+            m_second_level_bitmaps[first_level] &= ~(1u << second_level);
+            if (m_second_level_bitmaps[first_level] == 0) {
+                m_first_level_bitmap &= ~(static_cast<uint64_t>(1) << first_level);
+            }
+        }
+
+        //O(1) good fit lookup, returns the head of the smallest non empty class whose every member fits allocation_size
+        allocation_displacement_t find(size_type_t allocation_size) const {
+            uint32_t first_level, second_level;
+            if (!size_class_search_mapping(allocation_size, first_level, second_level)) {
+                return k_bad_displacement;
+            }
+
+            uint32_t second_level_map = m_second_level_bitmaps[first_level] & (~0u << second_level);
+
+            if (second_level_map == 0) {
+                //nothing left in this first level, take the smallest non empty first level above it
+                uint64_t first_level_map = 0;
+                if (first_level + 1 < 64) {
+                    first_level_map = m_first_level_bitmap & (~static_cast<uint64_t>(0) << (first_level + 1));
+                }
+                if (first_level_map == 0) {
+                    return k_bad_displacement;
+                }
+                first_level = minialloc_bitscan_forward(first_level_map);
+                second_level_map = m_second_level_bitmaps[first_level];
+            }
+            second_level = minialloc_bitscan_forward(second_level_map);
+
+            return m_heads[first_level][second_level];
+        }
+
+        /*
+            find() skips the class allocation_size itself maps to, whose members may be smaller than it. when no
+            class above has a member, walk that class for one that fits, an exact fit included. region_size and
+            next_in_class read a member of the lists
+        */
+        template<typename RegionSize, typename NextInClass>
+        allocation_displacement_t find(size_type_t allocation_size, RegionSize region_size, NextInClass next_in_class) const {
+            auto head = find(allocation_size);
+            if (head != k_bad_displacement) {
+                return head;
+            }
+            uint32_t first_level, second_level;
+            size_class_mapping(allocation_size, first_level, second_level);
+            for (auto current = m_heads[first_level][second_level]; current != k_bad_displacement; current = next_in_class(current)) {
+                if (region_size(current) >= allocation_size) {
+                    return current;
+                }
+            }
+            return k_bad_displacement;
+        }
+    };
+
+    //bucket 0 counts lengths of 0, bucket n lengths in [2^(n-1), 2^n), the last bucket everything above that
+    static constexpr uint32_t k_statistics_histogram_buckets = 24;
+
+    //a point in time copy of the counters kept with k_collect_statistics
+    struct allocator_statistics_t {
+        size_type_t m_bytes_in_use;
+        size_type_t m_peak_bytes_in_use;
+        size_type_t m_live_allocations;
+        size_type_t m_available_memory;
+        size_type_t m_free_regions;
+        size_type_t m_largest_free_region;
+        //1 - largest free region / available memory. 0 when all free memory is one region
+        double m_external_fragmentation;
+        //every free region occupies one pool node, so these are also the free region counts
+        size_type_t m_nodes_in_use;
+        size_type_t m_peak_nodes_in_use;
+        size_type_t m_max_allocations;
+        size_type_t m_in_place_reallocations;
+        size_type_t m_moved_reallocations;
+        //free nodes examined per allocate call
+        uint64_t m_allocate_scan_histogram[k_statistics_histogram_buckets];
+        //free nodes (or tree levels) visited per deallocate call to find the insertion point
+        uint64_t m_deallocate_walk_histogram[k_statistics_histogram_buckets];
+    };
+
+    //a checkpoint taken by mark(), see release_to
+    struct allocation_mark_t {
+        //start of the free memory at the top of the heap when the mark was taken
+        allocation_displacement_t m_frontier;
+        size_type_t m_available_memory;
+        //only kept with k_collect_statistics
+        size_type_t m_live_allocations;
+    };
+
+    //the original layout: free regions are described by nodes taken from a fixed size pool at the front of the memory
+    struct node_pool_allocator_t {
     private:
+
         //nodes that represent a region of free memory
         allocation_displacement_t m_first_allocation_node;
         //nodes that are not currently associated with any free memory, but are available to
         //represent future chunks of free memory
         allocation_displacement_t m_first_pooled_node;
+        //nodes from this index on (counted from the first node after the unused one at displacement 0) have
+        //never been handed out, the pool takes them in order once the list of returned nodes is empty
+        size_type_t m_untouched_node_index;
         uint8_t* m_memory;
         size_type_t m_total_memory_size;
 
         size_type_t m_max_allocations;
         size_type_t m_available_memory;
 
+        //reallocate calls that were satisfied without moving the block, and those that had to copy it
+        size_type_t m_in_place_reallocations;
+        size_type_t m_moved_reallocations;
+
+        struct statistics_counters_t {
+            size_type_t m_peak_bytes_in_use;
+            size_type_t m_live_allocations;
+            size_type_t m_nodes_in_use;
+            size_type_t m_peak_nodes_in_use;
+            uint64_t m_allocate_scan_histogram[k_statistics_histogram_buckets];
+            uint64_t m_deallocate_walk_histogram[k_statistics_histogram_buckets];
+        };
+
+        //free nodes bucketed by size, only used by segregated_fit
+        std::conditional_t<k_use_size_classes, size_class_index_t, empty_t> m_size_classes;
+        //root of the address ordered tree of free nodes, only used with k_use_address_tree
+        allocation_displacement_t m_address_tree_root;
+        //number of entries in the packed size arrays, only used by packed_best_fit
+        size_type_t m_packed_count;
+
+        std::conditional_t<k_collect_statistics, statistics_counters_t, empty_t> m_statistics;
+        //allocations and frees since the last sampled check_integrity(), only used with k_validation_interval
+        uint32_t m_operations_since_validation;
+        operation_hooks_t m_hooks;
+
         template<typename T>
         T* translate_displacement(allocation_displacement_t displacement) {
             if constexpr (k_use_absolute_pointers) {
@@ -56,89 +791,199 @@ struct allocator_template_t {
             }
         }
 
+        //larger requests would wrap around size_type_t when rounded up to the alignment, they fail instead
+        static constexpr size_type_t k_max_allocation_size = static_cast<size_type_t>(~static_cast<size_type_t>(0) - (k_imposed_alignment - 1));
+
         static size_type_t allocation_align(size_type_t allocation_size) {
+            assert(allocation_size <= k_max_allocation_size);
             allocation_size += k_imposed_alignment - 1;
             allocation_size &= ~(k_imposed_alignment - 1);
             return allocation_size;
         }
 
-    public:
-        allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_allocations) :
-            m_first_allocation_node(k_bad_displacement),
-            m_first_pooled_node(k_bad_displacement),
-            m_memory(mem),
-            m_total_memory_size(total_memory_size),
-            m_max_allocations(max_allocations),
-            m_available_memory(0) {
+        //the packed size arrays start on a cache line boundary (relative to the memory) right after the nodes
+        static size_type_t packed_sizes_offset(size_type_t max_allocations) {
+            return (static_cast<size_type_t>(sizeof(allocation_node_t) * (max_allocations + 1)) + 63) & ~static_cast<size_type_t>(63);
+        }
 
-            assert((reinterpret_cast<uintptr_t>(m_memory) & (k_imposed_alignment - 1)) == 0);
+        static size_type_t packed_nodes_offset(size_type_t max_allocations) {
+            size_type_t packed_sizes_end = packed_sizes_offset(max_allocations) + static_cast<size_type_t>(sizeof(uint32_t) * max_allocations);
+            return (packed_sizes_end + sizeof(allocation_displacement_t) - 1) & ~static_cast<size_type_t>(sizeof(allocation_displacement_t) - 1);
+        }
+
+        //bytes reserved at the front of the memory for the node pool, including the unused node at displacement 0,
+        //and with packed_best_fit for the packed size arrays
+        static size_type_t node_pool_footprint(size_type_t max_allocations) {
+            if constexpr (k_use_packed_sizes) {
+                return allocation_align(packed_nodes_offset(max_allocations) + static_cast<size_type_t>(sizeof(allocation_displacement_t) * max_allocations));
+            }
+            else {
+                return allocation_align(static_cast<size_type_t>(sizeof(allocation_node_t) * (max_allocations + 1)));
+            }
+        }
+
+        //the size table follows the node pool, one bit for every k_imposed_alignment bytes of the whole memory
+        static size_type_t size_table_offset(size_type_t max_allocations) {
+            return (node_pool_footprint(max_allocations) + sizeof(uint64_t) - 1) & ~static_cast<size_type_t>(sizeof(uint64_t) - 1);
+        }
+
+        static size_type_t size_table_word_count(size_type_t total_memory_size) {
+            return (total_memory_size / k_imposed_alignment + 63) / 64;
+        }
+
+        //bytes in front of the first allocatable byte
+        static size_type_t metadata_footprint(size_type_t max_allocations, size_type_t total_memory_size) {
+            if constexpr (k_track_allocation_sizes) {
+                return allocation_align(size_table_offset(max_allocations) + static_cast<size_type_t>(sizeof(uint64_t)) * size_table_word_count(total_memory_size));
+            }
+            else {
+                return node_pool_footprint(max_allocations);
+            }
+        }
+
+        allocation_node_t* pool_nodes() {
+            return &reinterpret_cast<allocation_node_t*>(m_memory)[1]; //skip offset 0, our invalid offset
+        }
 
-            auto sizeof_nodes = static_cast<size_type_t>((sizeof(allocation_node_t) * (max_allocations + 1)));
+        //everything the constructor and reset() set up, apart from the memory itself
+        void initialize() {
+            m_first_allocation_node = k_bad_displacement;
+            m_first_pooled_node = k_bad_displacement;
+            m_untouched_node_index = 1;
+            m_in_place_reallocations = 0;
+            m_moved_reallocations = 0;
+            m_size_classes = decltype(m_size_classes){};
+            m_address_tree_root = k_bad_displacement;
+            m_packed_count = 0;
+            m_statistics = decltype(m_statistics){};
+            m_operations_since_validation = 0;
+
+            auto sizeof_nodes = metadata_footprint(m_max_allocations, m_total_memory_size);
+            if constexpr (k_track_allocation_sizes) {
+                memset(m_memory + size_table_offset(m_max_allocations), 0, sizeof(uint64_t) * size_table_word_count(m_total_memory_size));
+            }
 
-            size_type_t size_after_nodes = total_memory_size - sizeof_nodes;
+            size_type_t size_after_nodes = m_total_memory_size - sizeof_nodes;
 
             m_available_memory = size_after_nodes;
 
-            auto nodes = &reinterpret_cast<allocation_node_t*>(m_memory)[1]; //skip offset 0, our invalid offset
+            auto nodes = pool_nodes();
 
-            nodes[0].m_base = sizeof_nodes;
+            nodes[0].m_base = convert_to_displacement(m_memory + sizeof_nodes);
             nodes[0].m_size = size_after_nodes;
             nodes[0].m_next_node = k_bad_displacement;
             nodes[0].m_previous_node = k_bad_displacement;
 
             m_first_allocation_node = convert_to_displacement(&nodes[0]);
+            size_class_insert(&nodes[0]);
+            address_tree_insert(&nodes[0]);
 
+            if constexpr (k_collect_statistics) {
+                m_statistics.m_nodes_in_use = 1;
+                m_statistics.m_peak_nodes_in_use = 1;
+            }
+        }
 
-            for (size_type_t pooled_node_index = 0; pooled_node_index < max_allocations - 1; ++pooled_node_index) {
-
-                auto current_node = &nodes[pooled_node_index + 1];
-
-                current_node->m_base = k_bad_displacement;
-                current_node->m_size = 0;
-
-                if (pooled_node_index != (max_allocations - 2)) {
-                    current_node->m_next_node = convert_to_displacement(&current_node[1]);
-                }
-                else {
-                    current_node->m_next_node = k_bad_displacement;
-                }
+    public:
+        node_pool_allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_allocations) :
+            m_first_allocation_node(k_bad_displacement),
+            m_first_pooled_node(k_bad_displacement),
+            m_untouched_node_index(1),
+            m_memory(mem),
+            m_total_memory_size(total_memory_size),
+            m_max_allocations(max_allocations),
+            m_available_memory(0),
+            m_in_place_reallocations(0),
+            m_moved_reallocations(0),
+            m_size_classes(), //value initialization zeroes the bitmaps and sets every head to k_bad_displacement
+            m_address_tree_root(k_bad_displacement),
+            m_packed_count(0),
+            m_statistics(),
+            m_operations_since_validation(0),
+            m_hooks() {
 
-                if (pooled_node_index != 0) {
-                    current_node->m_previous_node = convert_to_displacement(&current_node[-1]);
-                }
-                else {
-                    current_node->m_previous_node = k_bad_displacement;
-                }
+            assert((reinterpret_cast<uintptr_t>(m_memory) & (k_imposed_alignment - 1)) == 0);
+            assert(total_memory_size <= k_max_compact_memory_size);
+            assert(static_cast<uint64_t>(sizeof(allocation_node_t)) * max_allocations <= k_max_compact_link);
+            if constexpr (k_use_address_tree) {
+                //the tree keeps its color bit in the low bit of node displacements
+                assert((reinterpret_cast<uintptr_t>(m_memory) & (alignof(allocation_node_t) - 1)) == 0);
             }
+            //the pool is not threaded into a list here, nodes are handed out through m_untouched_node_index
+            initialize();
+        }
+
+        //back to the state right after construction, every block is freed at once. only the size table (with
+        //k_track_allocation_sizes) is cleared, nothing else depends on the memory or node count
+        void reset() {
+            m_hooks.reset();
+            initialize();
+        }
 
-            m_first_pooled_node = convert_to_displacement(&nodes[1]);
+        /*
+            points the allocator at memory that holds the contents of the original memory, for example the same
+            file mapped at another address. every displacement is relative to the memory so nothing else changes,
+            which is why this needs k_use_absolute_pointers to be false. the recorder and sampler are detached, they
+            live in the address space that set them, which may be another process or one that has since exited
+        */
+        void rebase(uint8_t* mem) {
+            static_assert(!k_use_absolute_pointers, "rebase() requires relative displacements");
+            assert((reinterpret_cast<uintptr_t>(mem) & (k_imposed_alignment - 1)) == 0);
+            m_memory = mem;
+            m_hooks = operation_hooks_t{};
         }
 
     private:
 
+        //the state of a node that describes no memory
+        static void clear_pooled_node(allocation_node_t* node) {
+            node->m_base = k_bad_displacement;
+            node->m_size = 0;
+            if constexpr (k_use_size_classes) {
+                node->m_next_in_class = k_bad_displacement;
+                node->m_previous_in_class = k_bad_displacement;
+            }
+            if constexpr (k_use_address_tree) {
+                node->m_left_node = k_bad_displacement;
+                node->m_right_node = k_bad_displacement;
+                node->m_parent_and_color = k_bad_displacement;
+            }
+        }
+
         allocation_node_t* new_node_from_pool() {
+            allocation_node_t* result;
             if (m_first_pooled_node != k_bad_displacement) {
-                allocation_node_t* result = translate_node(m_first_pooled_node);
+                result = translate_node(m_first_pooled_node);
                 assert_pooled_node_correct(result);
 
                 m_first_pooled_node = result->m_next_node;
                 if (m_first_pooled_node != k_bad_displacement) {
                     translate_node(m_first_pooled_node)->m_previous_node = k_bad_displacement;
                 }
-                result->m_next_node = k_bad_displacement;
-                result->m_previous_node = k_bad_displacement;
-                return result;
+            }
+            else if (m_untouched_node_index < m_max_allocations) {
+                //never used before, so whatever the memory holds is meaningless
+                result = &pool_nodes()[m_untouched_node_index++];
+                clear_pooled_node(result);
             }
             else {
                 assert(false);
                 return nullptr;
             }
+            result->m_next_node = k_bad_displacement;
+            result->m_previous_node = k_bad_displacement;
+
+            if constexpr (k_collect_statistics) {
+                if (++m_statistics.m_nodes_in_use > m_statistics.m_peak_nodes_in_use) {
+                    m_statistics.m_peak_nodes_in_use = m_statistics.m_nodes_in_use;
+                }
+            }
+            return result;
         }
 
         void release_node_to_pool(allocation_node_t* node) {
             auto node_displ = convert_to_displacement(node);
-            node->m_base = k_bad_displacement;
-            node->m_size = 0;
+            clear_pooled_node(node);
             node->m_next_node = m_first_pooled_node;
             node->m_previous_node = k_bad_displacement;
 
@@ -148,320 +993,2562 @@ struct allocator_template_t {
             m_first_pooled_node = node_displ;
             assert_pooled_node_correct(node);
 
+            if constexpr (k_collect_statistics) {
+                --m_statistics.m_nodes_in_use;
+            }
+
         }
 
-        void append_allocation_to_front(allocation_displacement_t allocation_base, size_type_t allocation_size) {
+        size_type_t usable_memory_size() const {
+            return m_total_memory_size - metadata_footprint(m_max_allocations, m_total_memory_size);
+        }
 
-            if (m_first_allocation_node != k_bad_displacement) {
-                auto first_node = translate_node(m_first_allocation_node);
-                //the allocation we are freeing + its size forms a contiguous region with the allocation
-                //at the front of the alloc list, adjust the fronts base address and size to contain this allocation
-                if (first_node->m_base == allocation_base + allocation_size) {
-                    first_node->m_base = allocation_base;
-                    first_node->m_size += allocation_size;
-                    assert_allocation_node_correct(first_node);
-                    return;
+        static void statistics_record_length(uint64_t* histogram, size_type_t length) {
+            uint32_t bucket = length == 0 ? 0 : minialloc_bitscan_reverse(length) + 1;
+            if (bucket >= k_statistics_histogram_buckets) {
+                bucket = k_statistics_histogram_buckets - 1;
+            }
+            ++histogram[bucket];
+        }
+
+        //call after m_available_memory went down
+        void statistics_update_peak() {
+            if constexpr (k_collect_statistics) {
+                size_type_t bytes_in_use = usable_memory_size() - m_available_memory;
+                if (bytes_in_use > m_statistics.m_peak_bytes_in_use) {
+                    m_statistics.m_peak_bytes_in_use = bytes_in_use;
                 }
             }
+        }
 
-            auto new_node = new_node_from_pool();
-            new_node->m_base = allocation_base;
-            new_node->m_size = allocation_size;
-            new_node->m_next_node = m_first_allocation_node;
-            new_node->m_previous_node = k_bad_displacement;
+        void statistics_record_allocation(size_type_t scan_length) {
+            if constexpr (k_collect_statistics) {
+                ++m_statistics.m_live_allocations;
+                statistics_record_length(m_statistics.m_allocate_scan_histogram, scan_length);
+                statistics_update_peak();
+            }
+        }
 
-            if (m_first_allocation_node != k_bad_displacement) {
-                translate_node(m_first_allocation_node)->m_previous_node = convert_to_displacement(new_node);
+        void statistics_record_deallocation(size_type_t walk_length) {
+            if constexpr (k_collect_statistics) {
+                --m_statistics.m_live_allocations;
+                statistics_record_length(m_statistics.m_deallocate_walk_histogram, walk_length);
             }
-            m_first_allocation_node = convert_to_displacement(new_node);
-            assert_allocation_node_correct(new_node);
+        }
 
+        uint64_t* size_table() {
+            return reinterpret_cast<uint64_t*>(m_memory + size_table_offset(m_max_allocations));
         }
 
-        void insert_allocation_to_tail(allocation_node_t* tail_node, allocation_displacement_t allocation_base, size_type_t allocation_size) {
+        //bit index of the last alignment step of a block, allocation_size is already aligned and not zero
+        size_type_t size_table_end_bit(uint8_t* memory, size_type_t allocation_size) {
+            return static_cast<size_type_t>(memory + allocation_size - 1 - m_memory) / k_imposed_alignment;
+        }
 
-            if ((tail_node->m_base + tail_node->m_size) == allocation_base) {
-                tail_node->m_size += allocation_size;
-                assert_allocation_node_correct(tail_node);
-                return;
+        //zero sized blocks are not recorded, they can only be freed with their size
+        void size_table_mark_end(uint8_t* memory, size_type_t allocation_size) {
+            if constexpr (k_track_allocation_sizes) {
+                if (allocation_size != 0) {
+                    size_type_t end_bit = size_table_end_bit(memory, allocation_size);
+                    size_table()[end_bit / 64] |= static_cast<uint64_t>(1) << (end_bit % 64);
+                }
             }
+        }
 
-            auto new_node = new_node_from_pool();
-
-            new_node->m_base = allocation_base;
-            new_node->m_size = allocation_size;
+        void size_table_clear_end(uint8_t* memory, size_type_t allocation_size) {
+            if constexpr (k_track_allocation_sizes) {
+                if (allocation_size != 0) {
+                    size_type_t end_bit = size_table_end_bit(memory, allocation_size);
+                    if constexpr (k_size_tags) {
+                        minialloc_hardening_check((size_table()[end_bit / 64] >> (end_bit % 64)) & 1, "no live block ends there, a double free or the wrong size");
+                    }
+                    assert((size_table()[end_bit / 64] >> (end_bit % 64)) & 1);
+                    size_table()[end_bit / 64] &= ~(static_cast<uint64_t>(1) << (end_bit % 64));
+                }
+            }
+        }
 
-            new_node->m_next_node = k_bad_displacement;
-            new_node->m_previous_node = convert_to_displacement(tail_node);
-            tail_node->m_next_node = convert_to_displacement(new_node);
-            assert_allocation_node_correct(tail_node);
-            assert_allocation_node_correct(new_node);
+        //forgets every block ending in [begin, end), both aligned
+        void size_table_clear_range(uint8_t* begin, uint8_t* end) {
+            if constexpr (k_track_allocation_sizes) {
+                size_type_t bit = static_cast<size_type_t>(begin - m_memory) / k_imposed_alignment;
+                size_type_t end_bit = static_cast<size_type_t>(end - m_memory) / k_imposed_alignment;
+                for (; bit < end_bit && (bit % 64) != 0; ++bit) {
+                    size_table()[bit / 64] &= ~(static_cast<uint64_t>(1) << (bit % 64));
+                }
+                for (; bit + 64 <= end_bit; bit += 64) {
+                    size_table()[bit / 64] = 0;
+                }
+                for (; bit < end_bit; ++bit) {
+                    size_table()[bit / 64] &= ~(static_cast<uint64_t>(1) << (bit % 64));
+                }
+            }
+            else {
+                (void)begin;
+                (void)end;
+            }
         }
 
-        void insert_allocation_between(allocation_node_t* first, allocation_node_t* second, allocation_displacement_t allocation_base, size_type_t allocation_size) {
+        void size_class_insert(allocation_node_t* node) {
+            if constexpr (k_use_size_classes) {
+                uint32_t first_level, second_level;
+                size_class_mapping(node->m_size, first_level, second_level);
 
-            if ((first->m_base + first->m_size) == allocation_base) {
-                //freeing this allocation causes first and second to form a contiguous region!
-                if ((allocation_base + allocation_size) == second->m_base) {
-                    first->m_size += allocation_size;
-                    first->m_size += second->m_size;
+                auto node_displ = convert_to_displacement(node);
+                auto& head = m_size_classes.m_heads[first_level][second_level];
 
+                node->m_next_in_class = head;
+                node->m_previous_in_class = k_bad_displacement;
+                if (head != k_bad_displacement) {
+                    translate_node(head)->m_previous_in_class = node_displ;
+                }
+                head = node_displ;
+
+                m_size_classes.mark_non_empty(first_level, second_level);
+            }
+            packed_insert(node);
+        }
+
+        //size must be the size the node had when it was inserted into its size class
+        void size_class_unlink(allocation_node_t* node, size_type_t size) {
+            if constexpr (k_use_size_classes) {
+                uint32_t first_level, second_level;
+                size_class_mapping(size, first_level, second_level);
+
+                if (node->m_next_in_class != k_bad_displacement) {
+                    translate_node(node->m_next_in_class)->m_previous_in_class = node->m_previous_in_class;
+                }
+
+                if (node->m_previous_in_class != k_bad_displacement) {
+                    translate_node(node->m_previous_in_class)->m_next_in_class = node->m_next_in_class;
+                }
+                else {
+                    auto& head = m_size_classes.m_heads[first_level][second_level];
+                    assert(head == convert_to_displacement(node));
+                    head = node->m_next_in_class;
+
+                    if (head == k_bad_displacement) {
+                        m_size_classes.mark_empty(first_level, second_level);
+                    }
+                }
+                node->m_next_in_class = k_bad_displacement;
+                node->m_previous_in_class = k_bad_displacement;
+            }
+            packed_remove(node);
+        }
+
+        void size_class_remove(allocation_node_t* node) {
+            size_class_unlink(node, node->m_size);
+        }
+
+        //call after changing the size of a free node, moves it to its new size class if it changed
+        void size_class_update(allocation_node_t* node, size_type_t old_size) {
+            if constexpr (k_use_size_classes) {
+                uint32_t old_first_level, old_second_level, first_level, second_level;
+                size_class_mapping(old_size, old_first_level, old_second_level);
+                size_class_mapping(node->m_size, first_level, second_level);
+
+                if (old_first_level != first_level || old_second_level != second_level) {
+                    size_class_unlink(node, old_size);
+                    size_class_insert(node);
+                }
+            }
+            packed_update(node);
+        }
+
+        //O(1) good fit lookup, returns nullptr if no free node fits
+        allocation_node_t* size_class_find(size_type_t allocation_size) {
+            auto head = m_size_classes.find(allocation_size,
+                [this](allocation_displacement_t node) -> size_type_t { return translate_node(node)->m_size; },
+                [this](allocation_displacement_t node) -> allocation_displacement_t { return translate_node(node)->m_next_in_class; });
+            return head == k_bad_displacement ? nullptr : translate_node(head);
+        }
+
+        /*
+            packed_best_fit keeps one entry per free node in two parallel arrays behind the node pool: the node size
+            clamped to 32 bits, and the node displacement. entries are unordered, removal moves the last entry into
+            the hole. the size_class_* functions above keep them in sync, so every path that maintains the size
+            classes maintains these as well
+        */
+        uint32_t* packed_sizes() {
+            return reinterpret_cast<uint32_t*>(m_memory + packed_sizes_offset(m_max_allocations));
+        }
+
+        allocation_displacement_t* packed_nodes() {
+            return reinterpret_cast<allocation_displacement_t*>(m_memory + packed_nodes_offset(m_max_allocations));
+        }
+
+        //sizes of 4 GiB and above all share the largest key, any of them fits any request below that
+        static uint32_t packed_key(size_type_t size) {
+            return size > static_cast<size_type_t>(~0u) ? ~0u : static_cast<uint32_t>(size);
+        }
+
+        void packed_insert(allocation_node_t* node) {
+            if constexpr (k_use_packed_sizes) {
+                size_type_t packed_index = m_packed_count++;
+                packed_sizes()[packed_index] = packed_key(node->m_size);
+                packed_nodes()[packed_index] = convert_to_displacement(node);
+                node->m_packed_index = packed_index;
+            }
+        }
+
+        void packed_remove(allocation_node_t* node) {
+            if constexpr (k_use_packed_sizes) {
+                size_type_t packed_index = node->m_packed_index;
+                size_type_t last_index = --m_packed_count;
+                assert(packed_nodes()[packed_index] == convert_to_displacement(node));
+                if (packed_index != last_index) {
+                    packed_sizes()[packed_index] = packed_sizes()[last_index];
+                    packed_nodes()[packed_index] = packed_nodes()[last_index];
+                    translate_node(packed_nodes()[packed_index])->m_packed_index = packed_index;
+                }
+            }
+        }
+
+        void packed_update(allocation_node_t* node) {
+            if constexpr (k_use_packed_sizes) {
+                packed_sizes()[node->m_packed_index] = packed_key(node->m_size);
+            }
+        }
+
+        //smallest free node of at least allocation_size bytes, nullptr if there is none
+        allocation_node_t* packed_best_fit_find(size_type_t allocation_size) {
+            if (allocation_size >= static_cast<size_type_t>(~0u)) {
+                //beyond what the keys can tell apart, compare the real sizes
+                allocation_node_t* best_node = nullptr;
+                for (size_type_t packed_index = 0; packed_index < m_packed_count; ++packed_index) {
+                    auto node = translate_node(packed_nodes()[packed_index]);
+                    if (static_cast<size_type_t>(node->m_size) >= allocation_size && (best_node == nullptr || node->m_size < best_node->m_size)) {
+                        best_node = node;
+                    }
+                }
+                return best_node;
+            }
+
+            uint32_t request = static_cast<uint32_t>(allocation_size);
+            uint32_t best_difference = minialloc_packed_min_difference(packed_sizes(), m_packed_count, request);
+            if (best_difference > ~0u - request) {
+                return nullptr;
+            }
+            size_t packed_index = minialloc_packed_find(packed_sizes(), m_packed_count, request + best_difference);
+            assert(packed_index < m_packed_count);
+            return translate_node(packed_nodes()[packed_index]);
+        }
+
+        allocation_node_t* node_or_null(allocation_displacement_t displacement) {
+            return displacement == k_bad_displacement ? nullptr : translate_node(displacement);
+        }
+
+        allocation_displacement_t displacement_or_bad(allocation_node_t* node) {
+            return node == nullptr ? k_bad_displacement : convert_to_displacement(node);
+        }
+
+        allocation_node_t* tree_left(allocation_node_t* node) {
+            return node_or_null(node->m_left_node);
+        }
+
+        allocation_node_t* tree_right(allocation_node_t* node) {
+            return node_or_null(node->m_right_node);
+        }
+
+        allocation_node_t* tree_parent(allocation_node_t* node) {
+            return node_or_null(node->m_parent_and_color & ~static_cast<allocation_displacement_t>(1));
+        }
+
+        static bool tree_is_red(allocation_node_t* node) {
+            return node != nullptr && (node->m_parent_and_color & 1) != 0;
+        }
+
+        void tree_set_parent(allocation_node_t* node, allocation_node_t* parent) {
+            node->m_parent_and_color = displacement_or_bad(parent) | (node->m_parent_and_color & 1);
+        }
+
+        static void tree_set_red(allocation_node_t* node, bool red) {
+            node->m_parent_and_color = (node->m_parent_and_color & ~static_cast<allocation_displacement_t>(1)) | (red ? 1 : 0);
+        }
+
+        //points whatever referenced old_child (its parent, or the root) at new_child
+        void tree_replace_child(allocation_node_t* parent, allocation_node_t* old_child, allocation_node_t* new_child) {
+            if (parent == nullptr) {
+                m_address_tree_root = displacement_or_bad(new_child);
+            }
+            else if (tree_left(parent) == old_child) {
+                parent->m_left_node = displacement_or_bad(new_child);
+            }
+            else {
+                parent->m_right_node = displacement_or_bad(new_child);
+            }
+            if (new_child != nullptr) {
+                tree_set_parent(new_child, parent);
+            }
+        }
+
+        void tree_rotate_left(allocation_node_t* node) {
+            auto pivot = tree_right(node);
+            auto pivot_left = tree_left(pivot);
+
+            node->m_right_node = displacement_or_bad(pivot_left);
+            if (pivot_left != nullptr) {
+                tree_set_parent(pivot_left, node);
+            }
+            tree_replace_child(tree_parent(node), node, pivot);
+            pivot->m_left_node = convert_to_displacement(node);
+            tree_set_parent(node, pivot);
+        }
+
+        void tree_rotate_right(allocation_node_t* node) {
+            auto pivot = tree_left(node);
+            auto pivot_right = tree_right(pivot);
+
+            node->m_left_node = displacement_or_bad(pivot_right);
+            if (pivot_right != nullptr) {
+                tree_set_parent(pivot_right, node);
+            }
+            tree_replace_child(tree_parent(node), node, pivot);
+            pivot->m_right_node = convert_to_displacement(node);
+            tree_set_parent(node, pivot);
+        }
+
+        /*
+            the node must already be linked into the address ordered list. its list neighbors tell us where it
+            goes in the tree: as the right child of its predecessor if that slot is free, otherwise as the left
+            child of its successor (which then has no left child), so no search from the root is needed
+        */
+        void address_tree_insert(allocation_node_t* node) {
+            if constexpr (k_use_address_tree) {
+                node->m_left_node = k_bad_displacement;
+                node->m_right_node = k_bad_displacement;
+                node->m_parent_and_color = k_bad_displacement;
+
+                if (m_address_tree_root == k_bad_displacement) {
+                    m_address_tree_root = convert_to_displacement(node);
+                    return;
+                }
+
+                auto previous = node_or_null(node->m_previous_node);
+                allocation_node_t* parent;
+                if (previous != nullptr && previous->m_right_node == k_bad_displacement) {
+                    parent = previous;
+                    parent->m_right_node = convert_to_displacement(node);
+                }
+                else {
+                    parent = translate_node(node->m_next_node);
+                    assert(parent->m_left_node == k_bad_displacement);
+                    parent->m_left_node = convert_to_displacement(node);
+                }
+                tree_set_parent(node, parent);
+                tree_set_red(node, true);
+
+                //standard red-black insert fixup
+                while (true) {
+                    parent = tree_parent(node);
+                    if (!tree_is_red(parent)) {
+                        break;
+                    }
+                    auto grandparent = tree_parent(parent);
+
+                    if (parent == tree_left(grandparent)) {
+                        auto uncle = tree_right(grandparent);
+                        if (tree_is_red(uncle)) {
+                            tree_set_red(parent, false);
+                            tree_set_red(uncle, false);
+                            tree_set_red(grandparent, true);
+                            node = grandparent;
+                            continue;
+                        }
+                        if (node == tree_right(parent)) {
+                            node = parent;
+                            tree_rotate_left(node);
+                            parent = tree_parent(node);
+                        }
+                        tree_set_red(parent, false);
+                        tree_set_red(grandparent, true);
+                        tree_rotate_right(grandparent);
+                    }
+                    else {
+                        auto uncle = tree_left(grandparent);
+                        if (tree_is_red(uncle)) {
+                            tree_set_red(parent, false);
+                            tree_set_red(uncle, false);
+                            tree_set_red(grandparent, true);
+                            node = grandparent;
+                            continue;
+                        }
+                        if (node == tree_left(parent)) {
+                            node = parent;
+                            tree_rotate_right(node);
+                            parent = tree_parent(node);
+                        }
+                        tree_set_red(parent, false);
+                        tree_set_red(grandparent, true);
+                        tree_rotate_left(grandparent);
+                    }
+                }
+                tree_set_red(translate_node(m_address_tree_root), false);
+            }
+        }
+
+        //must be called while the node is still linked into the address ordered list
+        void address_tree_remove(allocation_node_t* node) {
+            if constexpr (k_use_address_tree) {
+                allocation_node_t* child;
+                allocation_node_t* child_parent;
+                bool removed_red;
+
+                if (node->m_left_node == k_bad_displacement || node->m_right_node == k_bad_displacement) {
+                    child = node->m_left_node == k_bad_displacement ? tree_right(node) : tree_left(node);
+                    child_parent = tree_parent(node);
+                    removed_red = tree_is_red(node);
+                    tree_replace_child(child_parent, node, child);
+                }
+                else {
+                    //the in order successor is the next node in the list, it has no left child
+                    auto successor = translate_node(node->m_next_node);
+                    assert(successor->m_left_node == k_bad_displacement);
+
+                    removed_red = tree_is_red(successor);
+                    child = tree_right(successor);
+
+                    if (tree_parent(successor) == node) {
+                        child_parent = successor;
+                    }
+                    else {
+                        child_parent = tree_parent(successor);
+                        tree_replace_child(child_parent, successor, child);
+                        successor->m_right_node = node->m_right_node;
+                        tree_set_parent(tree_right(successor), successor);
+                    }
+                    tree_replace_child(tree_parent(node), node, successor);
+                    successor->m_left_node = node->m_left_node;
+                    tree_set_parent(tree_left(successor), successor);
+                    tree_set_red(successor, tree_is_red(node));
+                }
+
+                node->m_left_node = k_bad_displacement;
+                node->m_right_node = k_bad_displacement;
+                node->m_parent_and_color = k_bad_displacement;
+
+                if (removed_red) {
+                    return;
+                }
+
+                //standard red-black erase fixup, child may be null so its parent is tracked separately
+                while (child != node_or_null(m_address_tree_root) && !tree_is_red(child)) {
+                    if (child == tree_left(child_parent)) {
+                        auto sibling = tree_right(child_parent);
+                        if (tree_is_red(sibling)) {
+                            tree_set_red(sibling, false);
+                            tree_set_red(child_parent, true);
+                            tree_rotate_left(child_parent);
+                            sibling = tree_right(child_parent);
+                        }
+                        if (!tree_is_red(tree_left(sibling)) && !tree_is_red(tree_right(sibling))) {
+                            tree_set_red(sibling, true);
+                            child = child_parent;
+                            child_parent = tree_parent(child);
+                        }
+                        else {
+                            if (!tree_is_red(tree_right(sibling))) {
+                                tree_set_red(tree_left(sibling), false);
+                                tree_set_red(sibling, true);
+                                tree_rotate_right(sibling);
+                                sibling = tree_right(child_parent);
+                            }
+                            tree_set_red(sibling, tree_is_red(child_parent));
+                            tree_set_red(child_parent, false);
+                            tree_set_red(tree_right(sibling), false);
+                            tree_rotate_left(child_parent);
+                            child = node_or_null(m_address_tree_root);
+                            break;
+                        }
+                    }
+                    else {
+                        auto sibling = tree_left(child_parent);
+                        if (tree_is_red(sibling)) {
+                            tree_set_red(sibling, false);
+                            tree_set_red(child_parent, true);
+                            tree_rotate_right(child_parent);
+                            sibling = tree_left(child_parent);
+                        }
+                        if (!tree_is_red(tree_left(sibling)) && !tree_is_red(tree_right(sibling))) {
+                            tree_set_red(sibling, true);
+                            child = child_parent;
+                            child_parent = tree_parent(child);
+                        }
+                        else {
+                            if (!tree_is_red(tree_left(sibling))) {
+                                tree_set_red(tree_right(sibling), false);
+                                tree_set_red(sibling, true);
+                                tree_rotate_left(sibling);
+                                sibling = tree_left(child_parent);
+                            }
+                            tree_set_red(sibling, tree_is_red(child_parent));
+                            tree_set_red(child_parent, false);
+                            tree_set_red(tree_left(sibling), false);
+                            tree_rotate_right(child_parent);
+                            child = node_or_null(m_address_tree_root);
+                            break;
+                        }
+                    }
+                }
+                if (child != nullptr) {
+                    tree_set_red(child, false);
+                }
+            }
+        }
+
+        //the free node with the highest base below displacement, nullptr if there is none
+        allocation_node_t* address_tree_find_previous(allocation_displacement_t displacement, size_type_t& depth) {
+            allocation_node_t* result = nullptr;
+            auto node = node_or_null(m_address_tree_root);
+            while (node != nullptr) {
+                ++depth;
+                if (node->m_base < displacement) {
+                    result = node;
+                    node = tree_right(node);
+                }
+                else {
+                    node = tree_left(node);
+                }
+            }
+            return result;
+        }
+
+        //removes a node from the free list and returns it to the pool
+        void unlink_allocation_node(allocation_node_t* node) {
+            size_class_remove(node);
+            address_tree_remove(node);
+
+            if (node->m_next_node != k_bad_displacement) {
+                translate_node(node->m_next_node)->m_previous_node = node->m_previous_node;
+            }
+
+            if (node->m_previous_node != k_bad_displacement) {
+                translate_node(node->m_previous_node)->m_next_node = node->m_next_node;
+            }
+            else {
+                m_first_allocation_node = node->m_next_node;
+            }
+            release_node_to_pool(node);
+        }
+
+        bool is_pool_node(allocation_node_t* node) {
+            return node >= pool_nodes() && node < pool_nodes() + m_max_allocations;
+        }
+
+        //the O(1) checks of hardening_level_t::local on a free node and its list neighbors
+        void check_free_node(allocation_node_t* node) {
+            minialloc_hardening_check(is_pool_node(node), "free node outside of the node pool");
+            auto heap_begin = convert_to_displacement(m_memory + metadata_footprint(m_max_allocations, m_total_memory_size));
+            auto heap_end = convert_to_displacement(m_memory + m_total_memory_size);
+            auto node_end = node->m_base + node->m_size;
+            minialloc_hardening_check(node->m_size != 0 && node->m_base >= heap_begin && node_end > node->m_base && node_end <= heap_end, "free node outside of the heap");
+
+            auto displacement = convert_to_displacement(node);
+            if (node->m_previous_node == k_bad_displacement) {
+                minialloc_hardening_check(m_first_allocation_node == displacement, "free list head mismatch");
+            }
+            else {
+                auto previous = translate_node(node->m_previous_node);
+                minialloc_hardening_check(is_pool_node(previous) && previous->m_next_node == displacement && previous->m_base + previous->m_size < node->m_base, "free list link mismatch");
+            }
+            if (node->m_next_node != k_bad_displacement) {
+                auto next = translate_node(node->m_next_node);
+                minialloc_hardening_check(is_pool_node(next) && next->m_previous_node == displacement && node_end < next->m_base, "free list link mismatch");
+            }
+
+            if constexpr (k_use_size_classes) {
+                if (node->m_previous_in_class != k_bad_displacement) {
+                    auto previous = translate_node(node->m_previous_in_class);
+                    minialloc_hardening_check(is_pool_node(previous) && previous->m_next_in_class == displacement, "size class link mismatch");
+                }
+                if (node->m_next_in_class != k_bad_displacement) {
+                    auto next = translate_node(node->m_next_in_class);
+                    minialloc_hardening_check(is_pool_node(next) && next->m_previous_in_class == displacement, "size class link mismatch");
+                }
+            }
+        }
+
+        void hardening_check_node(allocation_node_t* node) {
+            if constexpr (k_local_checks) {
+                check_free_node(node);
+            }
+        }
+
+        void hardening_count_operation() {
+            if constexpr (k_validation_interval != 0) {
+                if (++m_operations_since_validation == k_validation_interval) {
+                    m_operations_since_validation = 0;
+                    check_integrity();
+                }
+            }
+        }
+
+        //hands out the first (or with from_top, the last) allocation_size bytes of a free node that is at least that large
+        uint8_t* carve_allocation_from_node(allocation_node_t* node, size_type_t allocation_size, bool from_top = false) {
+            hardening_check_node(node);
+            auto result_displacement = node->m_base;
+
+            if (static_cast<size_type_t>(node->m_size) != allocation_size) {
+                //shrink the node
+                size_type_t old_size = node->m_size;
+                if (from_top) {
+                    result_displacement += static_cast<allocation_displacement_t>(old_size - allocation_size);
+                }
+                else {
+                    node->m_base += allocation_size;
+                }
+                node->m_size -= allocation_size;
+                size_class_update(node, old_size);
+            }
+            else {
+                //exact match!
+                unlink_allocation_node(node);
+            }
+            m_available_memory -= allocation_size;
+            validate_freelist();
+            auto result = translate_displacement<uint8_t>(result_displacement);
+            size_table_mark_end(result, allocation_size);
+            hardening_count_operation();
+            return result;
+        }
+
+        //links a new free node directly after previous, or at the front of the list if previous is nullptr. never merges
+        allocation_node_t* link_new_allocation_node(allocation_node_t* previous, allocation_displacement_t allocation_base, size_type_t allocation_size) {
+            auto new_node = new_node_from_pool();
+            auto new_node_displ = convert_to_displacement(new_node);
+
+            new_node->m_base = allocation_base;
+            new_node->m_size = allocation_size;
+            new_node->m_previous_node = displacement_or_bad(previous);
+
+            if (previous != nullptr) {
+                new_node->m_next_node = previous->m_next_node;
+                previous->m_next_node = new_node_displ;
+            }
+            else {
+                new_node->m_next_node = m_first_allocation_node;
+                m_first_allocation_node = new_node_displ;
+            }
+
+            if (new_node->m_next_node != k_bad_displacement) {
+                translate_node(new_node->m_next_node)->m_previous_node = new_node_displ;
+            }
+            size_class_insert(new_node);
+            address_tree_insert(new_node);
+            return new_node;
+        }
+
+        //bytes needed in front of the node's base to reach the requested alignment
+        size_type_t alignment_padding(allocation_node_t* node, size_type_t alignment) {
+            auto address = reinterpret_cast<uintptr_t>(translate_displacement<uint8_t>(node->m_base));
+            return static_cast<size_type_t>((alignment - (address & (alignment - 1))) & (alignment - 1));
+        }
+
+        //like carve_allocation_from_node, but the allocation starts padding bytes into the node.
+        //the padding stays behind as a free node of its own and whatever is left after the allocation becomes a new free node
+        uint8_t* carve_aligned_allocation_from_node(allocation_node_t* node, size_type_t padding, size_type_t allocation_size) {
+            if (padding == 0) {
+                return carve_allocation_from_node(node, allocation_size);
+            }
+            hardening_check_node(node);
+            assert(static_cast<size_type_t>(node->m_size) >= padding + allocation_size);
+
+            auto result_displacement = node->m_base + padding;
+            size_type_t old_size = node->m_size;
+            size_type_t remaining_size = old_size - padding - allocation_size;
+
+            node->m_size = padding;
+            size_class_update(node, old_size);
+
+            if (remaining_size != 0) {
+                link_new_allocation_node(node, result_displacement + allocation_size, remaining_size);
+            }
+            m_available_memory -= allocation_size;
+            validate_freelist();
+            auto result = translate_displacement<uint8_t>(result_displacement);
+            size_table_mark_end(result, allocation_size);
+            hardening_count_operation();
+            return result;
+        }
+
+        //each of these returns the free node that now contains the freed range
+        allocation_node_t* append_allocation_to_front(allocation_displacement_t allocation_base, size_type_t allocation_size) {
+
+            if (m_first_allocation_node != k_bad_displacement) {
+                auto first_node = translate_node(m_first_allocation_node);
+                //the allocation we are freeing + its size forms a contiguous region with the allocation
+                //at the front of the alloc list, adjust the fronts base address and size to contain this allocation
+                if (first_node->m_base == allocation_base + static_cast<allocation_displacement_t>(allocation_size)) {
+                    size_type_t old_size = first_node->m_size;
+                    first_node->m_base = allocation_base;
+                    first_node->m_size += allocation_size;
+                    size_class_update(first_node, old_size);
+                    assert_allocation_node_correct(first_node);
+                    return first_node;
+                }
+            }
+
+            auto new_node = new_node_from_pool();
+            new_node->m_base = allocation_base;
+            new_node->m_size = allocation_size;
+            new_node->m_next_node = m_first_allocation_node;
+            new_node->m_previous_node = k_bad_displacement;
+
+            if (m_first_allocation_node != k_bad_displacement) {
+                translate_node(m_first_allocation_node)->m_previous_node = convert_to_displacement(new_node);
+            }
+            m_first_allocation_node = convert_to_displacement(new_node);
+            size_class_insert(new_node);
+            address_tree_insert(new_node);
+            assert_allocation_node_correct(new_node);
+            return new_node;
+        }
+
+        allocation_node_t* insert_allocation_to_tail(allocation_node_t* tail_node, allocation_displacement_t allocation_base, size_type_t allocation_size) {
+
+            if ((tail_node->m_base + tail_node->m_size) == allocation_base) {
+                size_type_t old_size = tail_node->m_size;
+                tail_node->m_size += allocation_size;
+                size_class_update(tail_node, old_size);
+                assert_allocation_node_correct(tail_node);
+                return tail_node;
+            }
+
+            auto new_node = new_node_from_pool();
+
+            new_node->m_base = allocation_base;
+            new_node->m_size = allocation_size;
+
+            new_node->m_next_node = k_bad_displacement;
+            new_node->m_previous_node = convert_to_displacement(tail_node);
+            tail_node->m_next_node = convert_to_displacement(new_node);
+            size_class_insert(new_node);
+            address_tree_insert(new_node);
+            assert_allocation_node_correct(tail_node);
+            assert_allocation_node_correct(new_node);
+            return new_node;
+        }
+
+        allocation_node_t* insert_allocation_between(allocation_node_t* first, allocation_node_t* second, allocation_displacement_t allocation_base, size_type_t allocation_size) {
+
+            if ((first->m_base + first->m_size) == allocation_base) {
+                //freeing this allocation causes first and second to form a contiguous region!
+                if ((allocation_base + static_cast<allocation_displacement_t>(allocation_size)) == second->m_base) {
+                    size_type_t old_size = first->m_size;
+                    size_type_t second_size = second->m_size;
+
+                    //erase second from the list
+                    unlink_allocation_node(second);
+
+                    first->m_size += allocation_size;
+                    first->m_size += second_size;
+                    size_class_update(first, old_size);
+                    assert_allocation_node_correct(first);
+                    return first;
+
+                }
+                size_type_t old_size = first->m_size;
+                first->m_size += allocation_size;
+                size_class_update(first, old_size);
+                assert_allocation_node_correct(first);
+                return first;
+
+            }
+
+            else if ((allocation_base + static_cast<allocation_displacement_t>(allocation_size)) == second->m_base) {
+                size_type_t old_size = second->m_size;
+                second->m_base = allocation_base;
+                second->m_size += allocation_size;
+                size_class_update(second, old_size);
+                assert_allocation_node_correct(second);
+                return second;
+            }
+            else {
+                auto new_node = new_node_from_pool();
+
+                new_node->m_base = allocation_base;
+                new_node->m_size = allocation_size;
+                new_node->m_previous_node = convert_to_displacement(first);
+                new_node->m_next_node = convert_to_displacement(second);
+                first->m_next_node = convert_to_displacement(new_node);
+                second->m_previous_node = convert_to_displacement(new_node);
+                size_class_insert(new_node);
+                address_tree_insert(new_node);
+                assert_allocation_node_correct(new_node);
+                return new_node;
+            }
+
+        }
+        //the free nodes directly before and after an allocated block, either may be k_bad_displacement.
+        //returns how many nodes were visited to find them
+        size_type_t find_free_neighbors(allocation_displacement_t mem_displacement, allocation_displacement_t& previous_node, allocation_displacement_t& current_node) {
+            previous_node = k_bad_displacement;
+            current_node = m_first_allocation_node;
+            size_type_t walk_length = 0;
+
+            if constexpr (k_use_address_tree) {
+                previous_node = displacement_or_bad(address_tree_find_previous(mem_displacement, walk_length));
+                if (previous_node != k_bad_displacement) {
+                    current_node = translate_node(previous_node)->m_next_node;
+                }
+            }
+            else {
+                while (current_node != k_bad_displacement) {
+                    auto translated_node = translate_node(current_node);
+
+                    if (translated_node->m_base > mem_displacement) {
+                        break;
+                    }
+
+                    previous_node = current_node;
+                    current_node = translated_node->m_next_node;
+                    ++walk_length;
+                }
+            }
+            return walk_length;
+        }
+
+        //returns a range to the free list without touching the allocation counters, returns the lookup walk length
+        size_type_t release_range(void* memory, size_type_t allocation_size) {
+            allocation_size = allocation_align(allocation_size);
+            size_table_clear_end(static_cast<uint8_t*>(memory), allocation_size);
+            validate_freelist();
+            auto mem_displacement = convert_to_displacement(memory);
+
+            allocation_displacement_t previous_node, current_node;
+            size_type_t walk_length = find_free_neighbors(mem_displacement, previous_node, current_node);
+
+            insert_free_region(previous_node, current_node, mem_displacement, allocation_size);
+            validate_freelist();
+            return walk_length;
+        }
+
+        //picks the right insertion path for a freed range whose list neighbors are already known
+        allocation_node_t* insert_free_region(allocation_displacement_t previous_node, allocation_displacement_t current_node, allocation_displacement_t allocation_base, size_type_t allocation_size) {
+            if constexpr (k_local_checks) {
+                auto allocation_end = allocation_base + static_cast<allocation_displacement_t>(allocation_size);
+                minialloc_hardening_check(allocation_base >= convert_to_displacement(m_memory + metadata_footprint(m_max_allocations, m_total_memory_size)) &&
+                    allocation_end >= allocation_base && allocation_end <= convert_to_displacement(m_memory + m_total_memory_size), "freed block outside of the heap");
+                minialloc_hardening_check((reinterpret_cast<uintptr_t>(translate_displacement<uint8_t>(allocation_base)) & (k_imposed_alignment - 1)) == 0, "freed block is misaligned");
+                if (previous_node != k_bad_displacement) {
+                    auto previous = translate_node(previous_node);
+                    hardening_check_node(previous);
+                    minialloc_hardening_check(previous->m_base + previous->m_size <= allocation_base, "freed block overlaps free memory, a double free or the wrong size");
+                }
+                if (current_node != k_bad_displacement) {
+                    auto current = translate_node(current_node);
+                    hardening_check_node(current);
+                    minialloc_hardening_check(allocation_end <= current->m_base, "freed block overlaps free memory, a double free or the wrong size");
+                }
+            }
+
+            allocation_node_t* result;
+            if (previous_node == k_bad_displacement) {
+                result = append_allocation_to_front(allocation_base, allocation_size);
+            }
+            else if (current_node == k_bad_displacement) {
+                result = insert_allocation_to_tail(translate_node(previous_node), allocation_base, allocation_size);
+            }
+            else {
+                result = insert_allocation_between(translate_node(previous_node), translate_node(current_node), allocation_base, allocation_size);
+            }
+            m_available_memory += allocation_size;
+            hardening_count_operation();
+            return result;
+        }
+
+        //heapsort of a free batch by address, the sizes are swapped along with the pointers
+        static void sort_batch_by_address(void** memory, size_type_t* allocation_sizes, size_type_t count) {
+            auto swap_entries = [memory, allocation_sizes](size_type_t first, size_type_t second) {
+                auto memory_tmp = memory[first];
+                memory[first] = memory[second];
+                memory[second] = memory_tmp;
+
+                auto size_tmp = allocation_sizes[first];
+                allocation_sizes[first] = allocation_sizes[second];
+                allocation_sizes[second] = size_tmp;
+            };
+
+            auto address_of = [memory](size_type_t index) {
+                return reinterpret_cast<uintptr_t>(memory[index]);
+            };
+
+            auto sift_down = [&address_of, &swap_entries](size_type_t root, size_type_t end) {
+                while (true) {
+                    size_type_t largest = root;
+                    size_type_t left = 2 * root + 1;
+                    size_type_t right = left + 1;
+
+                    if (left < end && address_of(left) > address_of(largest)) {
+                        largest = left;
+                    }
+                    if (right < end && address_of(right) > address_of(largest)) {
+                        largest = right;
+                    }
+                    if (largest == root) {
+                        return;
+                    }
+                    swap_entries(root, largest);
+                    root = largest;
+                }
+            };
+
+            for (size_type_t root = count / 2; root-- > 0;) {
+                sift_down(root, count);
+            }
+            for (size_type_t end = count; end > 1; --end) {
+                swap_entries(0, end - 1);
+                sift_down(0, end - 1);
+            }
+        }
+
+        /*
+            the free node with the highest address that can hold allocation_size bytes. the address tree gives the
+            last node directly and the walk goes backwards from there, usually only a step or two because the top
+            of the heap is where long lived blocks are carved from. without it the whole list is walked
+        */
+        allocation_node_t* highest_fitting_node(size_type_t allocation_size, size_type_t& scan_length) {
+            if constexpr (k_use_address_tree) {
+                auto node = node_or_null(m_address_tree_root);
+                if (node == nullptr) {
+                    return nullptr;
+                }
+                while (auto right = tree_right(node)) {
+                    node = right;
+                }
+                for (; node != nullptr; node = node_or_null(node->m_previous_node)) {
+                    ++scan_length;
+                    if (static_cast<size_type_t>(node->m_size) >= allocation_size) {
+                        return node;
+                    }
+                }
+                return nullptr;
+            }
+            else {
+                allocation_node_t* result = nullptr;
+                for (auto displacement = m_first_allocation_node; displacement != k_bad_displacement; displacement = translate_node(displacement)->m_next_node) {
+                    ++scan_length;
+                    auto node = translate_node(displacement);
+                    if (static_cast<size_type_t>(node->m_size) >= allocation_size) {
+                        result = node;
+                    }
+                }
+                return result;
+            }
+        }
+
+    public:
+        //like allocate, but running out of memory is not an error
+        void* try_allocate(size_type_t allocation_size) {
+            return try_allocate(allocation_size, k_default_lifetime);
+        }
+
+        /*
+            long_lived blocks come from the top of the highest free region that fits, regardless of the search
+            policy, transient ones from wherever the policy says. keeping the two apart stops a block that lives
+            for the whole session from splitting the space short lived blocks churn through. long_lived blocks
+            are not stack like, so they do not mix with mark() and release_to()
+        */
+        void* try_allocate(size_type_t allocation_size, lifetime_t lifetime) {
+            if (allocation_size > k_max_allocation_size) {
+                return nullptr;
+            }
+            size_type_t requested_size = allocation_size;
+            allocation_size = allocation_align(allocation_size);
+
+            if (lifetime == lifetime_t::long_lived) {
+                size_type_t scan_length = 0;
+                allocation_node_t* fitting_node = highest_fitting_node(allocation_size, scan_length);
+                if (fitting_node != nullptr) {
+                    auto result = carve_allocation_from_node(fitting_node, allocation_size, true);
+                    statistics_record_allocation(scan_length);
+                    m_hooks.allocate(result, requested_size, 1);
+                    return result;
+                }
+            }
+            else if constexpr (k_use_size_classes) {
+                allocation_node_t* fitting_node = size_class_find(allocation_size);
+                if (fitting_node != nullptr) {
+                    auto result = carve_allocation_from_node(fitting_node, allocation_size);
+                    statistics_record_allocation(1);
+                    m_hooks.allocate(result, requested_size, 1);
+                    return result;
+                }
+            }
+            else if constexpr (k_use_packed_sizes) {
+                size_type_t scan_length = m_packed_count;
+                allocation_node_t* fitting_node = packed_best_fit_find(allocation_size);
+                if (fitting_node != nullptr) {
+                    auto result = carve_allocation_from_node(fitting_node, allocation_size);
+                    statistics_record_allocation(scan_length);
+                    m_hooks.allocate(result, requested_size, 1);
+                    return result;
+                }
+            }
+            else {
+                allocation_node_t* current_node = nullptr;
+                size_type_t scan_length = 0;
+                for (allocation_displacement_t node_displacement = m_first_allocation_node; node_displacement != k_bad_displacement; node_displacement = current_node->m_next_node) {
+                    current_node = translate_node(node_displacement);
+                    ++scan_length;
+                    if (static_cast<size_type_t>(current_node->m_size) >= allocation_size) {
+                        auto result = carve_allocation_from_node(current_node, allocation_size);
+                        statistics_record_allocation(scan_length);
+                        m_hooks.allocate(result, requested_size, 1);
+                        return result;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        void* allocate(size_type_t allocation_size) {
+            void* result = try_allocate(allocation_size);
+            if (result == nullptr) {
+                m_hooks.allocation_failed(allocation_size);
+            }
+            assert(result != nullptr);
+            return result;
+        }
+
+        void* allocate(size_type_t allocation_size, lifetime_t lifetime) {
+            void* result = try_allocate(allocation_size, lifetime);
+            if (result == nullptr) {
+                m_hooks.allocation_failed(allocation_size);
+            }
+            assert(result != nullptr);
+            return result;
+        }
+
+
+        /*
+            alignment must be a power of two, it applies to the returned address itself so it also holds when
+            the memory given to the constructor is less aligned than that. the block is taken from the first
+            node (or with segregated_fit, the first size class) that can hold it after alignment, and the bytes
+            skipped to reach the alignment are left in the free list rather than being added to the allocation
+        */
+        void* try_allocate_aligned(size_type_t allocation_size, size_type_t alignment) {
+            assert((alignment & (alignment - 1)) == 0);
+            if (alignment <= k_imposed_alignment) {
+                return try_allocate(allocation_size);
+            }
+            //the searches below add up to alignment bytes of padding to the aligned size
+            if (allocation_size > k_max_allocation_size - alignment) {
+                return nullptr;
+            }
+            size_type_t requested_size = allocation_size;
+            allocation_size = allocation_align(allocation_size);
+
+            if constexpr (k_use_size_classes) {
+                //any node this large fits the allocation wherever its base falls
+                allocation_node_t* fitting_node = size_class_find(allocation_size + alignment - k_imposed_alignment);
+                if (fitting_node != nullptr) {
+                    auto result = carve_aligned_allocation_from_node(fitting_node, alignment_padding(fitting_node, alignment), allocation_size);
+                    statistics_record_allocation(1);
+                    m_hooks.allocate(result, requested_size, alignment);
+                    return result;
+                }
+            }
+            else if constexpr (k_use_packed_sizes) {
+                //the best node that fits regardless of where its base falls, which may not be the best fit after padding
+                size_type_t scan_length = m_packed_count;
+                allocation_node_t* fitting_node = packed_best_fit_find(allocation_size + alignment - k_imposed_alignment);
+                if (fitting_node != nullptr) {
+                    auto result = carve_aligned_allocation_from_node(fitting_node, alignment_padding(fitting_node, alignment), allocation_size);
+                    statistics_record_allocation(scan_length);
+                    m_hooks.allocate(result, requested_size, alignment);
+                    return result;
+                }
+            }
+            else {
+                allocation_node_t* current_node = nullptr;
+                size_type_t scan_length = 0;
+                for (allocation_displacement_t node_displacement = m_first_allocation_node; node_displacement != k_bad_displacement; node_displacement = current_node->m_next_node) {
+                    current_node = translate_node(node_displacement);
+                    ++scan_length;
+                    size_type_t padding = alignment_padding(current_node, alignment);
+                    if (static_cast<size_type_t>(current_node->m_size) >= padding + allocation_size) {
+                        auto result = carve_aligned_allocation_from_node(current_node, padding, allocation_size);
+                        statistics_record_allocation(scan_length);
+                        m_hooks.allocate(result, requested_size, alignment);
+                        return result;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        void* allocate_aligned(size_type_t allocation_size, size_type_t alignment) {
+            void* result = try_allocate_aligned(allocation_size, alignment);
+            if (result == nullptr) {
+                m_hooks.allocation_failed(allocation_size);
+            }
+            assert(result != nullptr);
+            return result;
+        }
+
+        //the padding in front of an aligned allocation was never part of it, so this is a plain deallocate
+        void deallocate_aligned(void* memory, size_type_t allocation_size, size_type_t alignment) {
+            assert((reinterpret_cast<uintptr_t>(memory) & (alignment - 1)) == 0);
+            (void)alignment;
+            deallocate(memory, allocation_size);
+        }
+
+        void deallocate(void* memory, size_type_t allocation_size) {
+            m_hooks.deallocate(memory, allocation_size);
+            size_type_t walk_length = release_range(memory, allocation_size);
+            statistics_record_deallocation(walk_length);
+        }
+
+        //the end of the block is looked up in the size table, a scan of one bit per alignment step of the block
+        void deallocate(void* memory) {
+            deallocate(memory, allocation_size(memory));
+        }
+
+        //size of a live block rounded up to the alignment, requires k_track_allocation_sizes
+        size_type_t allocation_size(void* memory) {
+            static_assert(k_track_allocation_sizes, "allocation_size() requires k_track_allocation_sizes in the traits");
+
+            size_type_t start_bit = static_cast<size_type_t>(static_cast<uint8_t*>(memory) - m_memory) / k_imposed_alignment;
+            size_type_t word_index = start_bit / 64;
+            uint64_t word = size_table()[word_index] & (~static_cast<uint64_t>(0) << (start_bit % 64));
+            while (word == 0) {
+                word = size_table()[++word_index];
+            }
+            size_type_t end_bit = word_index * 64 + minialloc_bitscan_forward(word);
+            return (end_bit - start_bit + 1) * k_imposed_alignment;
+        }
+
+        //grows a block in place if the free node right after it can absorb the growth, returns false otherwise. a new_size that does not grow the block shrinks it
+        bool try_expand(void* memory, size_type_t old_size, size_type_t new_size) {
+            if (new_size > k_max_allocation_size) {
+                return false;
+            }
+            size_type_t requested_old_size = old_size;
+            size_type_t requested_new_size = new_size;
+            old_size = allocation_align(old_size);
+            new_size = allocation_align(new_size);
+            if (new_size <= old_size) {
+                shrink(memory, requested_old_size, requested_new_size);
+                return true;
+            }
+            auto mem_displacement = convert_to_displacement(memory);
+
+            allocation_displacement_t previous_node, current_node;
+            find_free_neighbors(mem_displacement, previous_node, current_node);
+
+            if (current_node == k_bad_displacement) {
+                return false;
+            }
+            auto following_node = translate_node(current_node);
+            size_type_t growth = new_size - old_size;
+
+            if (following_node->m_base != mem_displacement + static_cast<allocation_displacement_t>(old_size) || static_cast<size_type_t>(following_node->m_size) < growth) {
+                return false;
+            }
+
+            if (static_cast<size_type_t>(following_node->m_size) == growth) {
+                unlink_allocation_node(following_node);
+            }
+            else {
+                //moving the base up keeps the node between the same neighbors, so the address order is unchanged
+                size_type_t following_size = following_node->m_size;
+                following_node->m_base += growth;
+                following_node->m_size -= growth;
+                size_class_update(following_node, following_size);
+            }
+            m_available_memory -= growth;
+            size_table_clear_end(static_cast<uint8_t*>(memory), old_size);
+            size_table_mark_end(static_cast<uint8_t*>(memory), new_size);
+            statistics_update_peak();
+            validate_freelist();
+            m_hooks.resize(memory, requested_old_size, requested_new_size);
+            return true;
+        }
+
+        //returns the tail of a block past new_size to the free list, merging it with a free node that follows
+        void shrink(void* memory, size_type_t old_size, size_type_t new_size) {
+            m_hooks.resize(memory, old_size, new_size);
+            old_size = allocation_align(old_size);
+            new_size = allocation_align(new_size);
+            assert(new_size <= old_size);
+            if (new_size == old_size) {
+                return;
+            }
+            release_range(static_cast<uint8_t*>(memory) + new_size, old_size - new_size);
+            size_table_mark_end(static_cast<uint8_t*>(memory), new_size);
+        }
+
+        /*
+            resizes a block, in place whenever possible: shrinking always stays in place, growing first tries
+            try_expand and only allocates, copies and frees when the following free node cannot absorb it.
+            a null block behaves like try_allocate and a new_size of 0 like deallocate. when the block has to
+            move and there is no room, nullptr is returned and the block is left as it was
+        */
+        void* reallocate(void* memory, size_type_t old_size, size_type_t new_size) {
+            if (memory == nullptr) {
+                return try_allocate(new_size);
+            }
+            if (new_size == 0) {
+                deallocate(memory, old_size);
+                return nullptr;
+            }
+
+            if (new_size > k_max_allocation_size) {
+                return nullptr;
+            }
+            if (allocation_align(new_size) <= allocation_align(old_size)) {
+                shrink(memory, old_size, new_size);
+                ++m_in_place_reallocations;
+                return memory;
+            }
+            if (try_expand(memory, old_size, new_size)) {
+                ++m_in_place_reallocations;
+                return memory;
+            }
+
+            void* new_memory = try_allocate(new_size);
+            if (new_memory == nullptr) {
+                return nullptr;
+            }
+            memcpy(new_memory, memory, old_size);
+            deallocate(memory, old_size);
+            ++m_moved_reallocations;
+            return new_memory;
+        }
+
+        /*
+            a copy of the current counters, cheap enough to poll. the largest free region is found by walking
+            the free list, or with segregated_fit only the highest non empty size class
+        */
+        allocator_statistics_t statistics() {
+            static_assert(k_collect_statistics, "statistics() requires k_collect_statistics in the traits");
+
+            allocator_statistics_t result{};
+            result.m_bytes_in_use = usable_memory_size() - m_available_memory;
+            result.m_peak_bytes_in_use = m_statistics.m_peak_bytes_in_use;
+            result.m_live_allocations = m_statistics.m_live_allocations;
+            result.m_available_memory = m_available_memory;
+            result.m_free_regions = m_statistics.m_nodes_in_use;
+            result.m_largest_free_region = largest_free_region();
+            result.m_external_fragmentation = m_available_memory == 0 ? 0.0 :
+                1.0 - static_cast<double>(result.m_largest_free_region) / static_cast<double>(m_available_memory);
+            result.m_nodes_in_use = m_statistics.m_nodes_in_use;
+            result.m_peak_nodes_in_use = m_statistics.m_peak_nodes_in_use;
+            result.m_max_allocations = m_max_allocations;
+            result.m_in_place_reallocations = m_in_place_reallocations;
+            result.m_moved_reallocations = m_moved_reallocations;
+            memcpy(result.m_allocate_scan_histogram, m_statistics.m_allocate_scan_histogram, sizeof(result.m_allocate_scan_histogram));
+            memcpy(result.m_deallocate_walk_histogram, m_statistics.m_deallocate_walk_histogram, sizeof(result.m_deallocate_walk_histogram));
+            return result;
+        }
+
+        //restarts the peak counters and histograms from the current state
+        void reset_statistics_peaks() {
+            static_assert(k_collect_statistics, "reset_statistics_peaks() requires k_collect_statistics in the traits");
+
+            m_statistics.m_peak_bytes_in_use = usable_memory_size() - m_available_memory;
+            m_statistics.m_peak_nodes_in_use = m_statistics.m_nodes_in_use;
+            memset(m_statistics.m_allocate_scan_histogram, 0, sizeof(m_statistics.m_allocate_scan_histogram));
+            memset(m_statistics.m_deallocate_walk_histogram, 0, sizeof(m_statistics.m_deallocate_walk_histogram));
+        }
+
+        size_type_t largest_free_region() {
+            size_type_t largest = 0;
+
+            if constexpr (k_use_size_classes) {
+                //only the highest non empty class can hold the largest node
+                if (m_size_classes.m_first_level_bitmap != 0) {
+                    uint32_t first_level = minialloc_bitscan_reverse(m_size_classes.m_first_level_bitmap);
+                    uint32_t second_level = minialloc_bitscan_reverse(m_size_classes.m_second_level_bitmaps[first_level]);
+
+                    for (auto node = m_size_classes.m_heads[first_level][second_level]; node != k_bad_displacement; node = translate_node(node)->m_next_in_class) {
+                        if (static_cast<size_type_t>(translate_node(node)->m_size) > largest) {
+                            largest = translate_node(node)->m_size;
+                        }
+                    }
+                }
+            }
+            else {
+                for (auto node = m_first_allocation_node; node != k_bad_displacement; node = translate_node(node)->m_next_node) {
+                    if (static_cast<size_type_t>(translate_node(node)->m_size) > largest) {
+                        largest = translate_node(node)->m_size;
+                    }
+                }
+            }
+            return largest;
+        }
+
+        //free bytes, whether or not they are contiguous
+        size_type_t available_memory() const {
+            return m_available_memory;
+        }
+
+        //nullptr stops recording, requires k_record_operations. rebase() detaches the recorder
+        void set_recorder(allocation_recorder_t* recorder) {
+            static_assert(k_record_operations, "set_recorder() requires k_record_operations in the traits");
+            m_hooks.m_recorder = recorder;
+        }
+
+        //nullptr stops sampling, requires k_sample_allocations. rebase() detaches the sampler
+        void set_sampler(allocation_sampler_t* sampler) {
+            static_assert(k_sample_allocations, "set_sampler() requires k_sample_allocations in the traits");
+            m_hooks.attach(sampler);
+        }
+
+        //records where the free memory at the top of the heap starts, for release_to
+        allocation_mark_t mark() {
+            auto heap_end = convert_to_displacement(m_memory + m_total_memory_size);
+            allocation_mark_t result{ heap_end, m_available_memory, 0 };
+
+            allocation_displacement_t previous_node, current_node;
+            find_free_neighbors(heap_end, previous_node, current_node);
+            if (previous_node != k_bad_displacement) {
+                auto last_node = translate_node(previous_node);
+                if (last_node->m_base + static_cast<allocation_displacement_t>(last_node->m_size) == heap_end) {
+                    result.m_frontier = last_node->m_base;
+                }
+            }
+            if constexpr (k_collect_statistics) {
+                result.m_live_allocations = m_statistics.m_live_allocations;
+            }
+            return result;
+        }
+
+        /*
+            frees everything from the frontier of the mark to the end of the memory in one go, for stack like use:
+            the blocks allocated since the mark have to be exactly the live blocks above the frontier. that holds
+            when there was no free memory below the frontier at mark() (nothing was freed since the last reset, or
+            only blocks from the top) and only blocks allocated since the mark are freed before release_to().
+            marks can be nested, releasing to an older mark drops the newer ones. costs one lookup plus one step
+            per free node above the frontier
+        */
+        void release_to(const allocation_mark_t& mark) {
+            m_hooks.release_to(translate_displacement<uint8_t>(mark.m_frontier));
+            auto heap_end = convert_to_displacement(m_memory + m_total_memory_size);
+            if (mark.m_frontier == heap_end) {
+                return;
+            }
+
+            allocation_displacement_t previous_node, current_node;
+            find_free_neighbors(mark.m_frontier, previous_node, current_node);
+
+            //every free node above the frontier is swallowed by the one the released range becomes
+            size_type_t released_size = static_cast<size_type_t>(heap_end - mark.m_frontier);
+            while (current_node != k_bad_displacement) {
+                auto node = translate_node(current_node);
+                current_node = node->m_next_node;
+                released_size -= node->m_size;
+                unlink_allocation_node(node);
+            }
+            size_table_clear_range(translate_displacement<uint8_t>(mark.m_frontier), translate_displacement<uint8_t>(heap_end));
+
+            auto below_node = previous_node == k_bad_displacement ? nullptr : translate_node(previous_node);
+            if (below_node != nullptr && below_node->m_base + static_cast<allocation_displacement_t>(below_node->m_size) >= mark.m_frontier) {
+                size_type_t old_size = below_node->m_size;
+                released_size -= static_cast<size_type_t>(below_node->m_base + static_cast<allocation_displacement_t>(old_size) - mark.m_frontier);
+                below_node->m_size = static_cast<size_type_t>(heap_end - below_node->m_base);
+                size_class_update(below_node, old_size);
+            }
+            else {
+                link_new_allocation_node(below_node, mark.m_frontier, static_cast<size_type_t>(heap_end - mark.m_frontier));
+            }
+            m_available_memory += released_size;
+            if constexpr (k_collect_statistics) {
+                m_statistics.m_live_allocations = mark.m_live_allocations;
+            }
+            //anything less means a block allocated since the mark was left below the frontier
+            assert(m_available_memory >= mark.m_available_memory);
+            validate_freelist();
+        }
+
+        /*
+            the free node that starts at or contains memory, or else the first one above it. returns false if
+            there is none
+        */
+        bool next_free_range(void* memory, uint8_t*& base, size_type_t& size) {
+            free_range_t range;
+            if (!first_free_range(memory, range)) {
+                return false;
+            }
+            base = range.m_base;
+            size = range.m_size;
+            return true;
+        }
+
+        /*
+            a free node, for walks over the free nodes in address order (purging, compaction). only the first
+            node is searched for, next_free_range steps along the free list. a range stays valid until the heap
+            changes
+        */
+        struct free_range_t {
+            uint8_t* m_base;
+            size_type_t m_size;
+            allocation_displacement_t m_node;
+        };
+
+        //same lookup as next_free_range
+        bool first_free_range(void* memory, free_range_t& range) {
+            allocation_displacement_t previous_node, current_node;
+            find_free_neighbors(convert_to_displacement(memory), previous_node, current_node);
+
+            if (previous_node != k_bad_displacement) {
+                auto node = translate_node(previous_node);
+                if (translate_displacement<uint8_t>(node->m_base) + node->m_size > static_cast<uint8_t*>(memory)) {
+                    current_node = previous_node;
+                }
+            }
+            if (current_node == k_bad_displacement) {
+                return false;
+            }
+            range.m_base = translate_displacement<uint8_t>(translate_node(current_node)->m_base);
+            range.m_size = translate_node(current_node)->m_size;
+            range.m_node = current_node;
+            return true;
+        }
+
+        //moves range on to the free node above it, returns false if there is none
+        bool next_free_range(free_range_t& range) {
+            auto next_node = translate_node(range.m_node)->m_next_node;
+            if (next_node == k_bad_displacement) {
+                return false;
+            }
+            range.m_base = translate_displacement<uint8_t>(translate_node(next_node)->m_base);
+            range.m_size = translate_node(next_node)->m_size;
+            range.m_node = next_node;
+            return true;
+        }
+
+        /*
+            for compactors: if a free node ends right where the block starts, the block's contents are moved down
+            to the start of that node and the free bytes end up behind the block, merged with the free node that
+            follows it if they touch. returns the new address, which is memory itself if nothing was free below
+        */
+        void* slide_down(void* memory, size_type_t allocation_size) {
+            allocation_displacement_t previous_node, current_node;
+            find_free_neighbors(convert_to_displacement(memory), previous_node, current_node);
+            if (previous_node == k_bad_displacement) {
+                return memory;
+            }
+            free_range_t range;
+            range.m_base = translate_displacement<uint8_t>(translate_node(previous_node)->m_base);
+            range.m_size = translate_node(previous_node)->m_size;
+            range.m_node = previous_node;
+            if (range.m_base + range.m_size != static_cast<uint8_t*>(memory)) {
+                return memory;
+            }
+            return slide_down(range, memory, allocation_size);
+        }
+
+        //the same for a block that starts where range ends, without looking the free node up. range follows the free bytes behind the block
+        void* slide_down(free_range_t& range, void* memory, size_type_t allocation_size) {
+            allocation_size = allocation_align(allocation_size);
+            auto below_node = translate_node(range.m_node);
+            assert(range.m_base + range.m_size == static_cast<uint8_t*>(memory));
+
+            auto destination = translate_displacement<uint8_t>(below_node->m_base);
+            memmove(destination, memory, allocation_size);
+            size_table_clear_end(static_cast<uint8_t*>(memory), allocation_size);
+            size_table_mark_end(destination, allocation_size);
+            m_hooks.move(memory, destination, allocation_size);
+
+            //same reasoning as try_expand, the node keeps its neighbors and its size
+            below_node->m_base += allocation_size;
+            if (below_node->m_next_node != k_bad_displacement) {
+                auto following_node = translate_node(below_node->m_next_node);
+                if (below_node->m_base + static_cast<allocation_displacement_t>(below_node->m_size) == following_node->m_base) {
+                    size_type_t old_size = below_node->m_size;
+                    size_type_t following_size = following_node->m_size;
+                    unlink_allocation_node(following_node);
+                    below_node->m_size += following_size;
+                    size_class_update(below_node, old_size);
+                }
+            }
+            validate_freelist();
+            range.m_base = translate_displacement<uint8_t>(below_node->m_base);
+            range.m_size = below_node->m_size;
+            return destination;
+        }
+
+        size_type_t in_place_reallocation_count() const {
+            return m_in_place_reallocations;
+        }
+
+        size_type_t moved_reallocation_count() const {
+            return m_moved_reallocations;
+        }
+
+        /*
+            carves count blocks in a single pass over the free list: each block is taken from the first node at or
+            after the one the previous block came from, so the list is not rescanned from the front for every
+            block. a block that does not fit anywhere in the rest of the list falls back to a normal allocate
+        */
+        void allocate_n(const size_type_t* allocation_sizes, void** out_memory, size_type_t count) {
+            if constexpr (k_use_size_classes || k_use_packed_sizes) {
+                //size class lookups are already O(1) and a best fit search has to look at every node, there is no scan to share
+                for (size_type_t allocation_index = 0; allocation_index < count; ++allocation_index) {
+                    out_memory[allocation_index] = allocate(allocation_sizes[allocation_index]);
+                }
+            }
+            else {
+                allocation_displacement_t node_displacement = m_first_allocation_node;
+
+                for (size_type_t allocation_index = 0; allocation_index < count; ++allocation_index) {
+                    if (allocation_sizes[allocation_index] > k_max_allocation_size) {
+                        out_memory[allocation_index] = allocate(allocation_sizes[allocation_index]);
+                        continue;
+                    }
+                    size_type_t allocation_size = allocation_align(allocation_sizes[allocation_index]);
+                    size_type_t scan_length = 1;
+
+                    while (node_displacement != k_bad_displacement && static_cast<size_type_t>(translate_node(node_displacement)->m_size) < allocation_size) {
+                        node_displacement = translate_node(node_displacement)->m_next_node;
+                        ++scan_length;
+                    }
+
+                    if (node_displacement == k_bad_displacement) {
+                        out_memory[allocation_index] = allocate(allocation_size);
+                        node_displacement = m_first_allocation_node;
+                        continue;
+                    }
+
+                    auto current_node = translate_node(node_displacement);
+                    //an exact fit returns the node to the pool, continue from its successor
+                    if (static_cast<size_type_t>(current_node->m_size) == allocation_size) {
+                        node_displacement = current_node->m_next_node;
+                    }
+                    out_memory[allocation_index] = carve_allocation_from_node(current_node, allocation_size);
+                    m_hooks.allocate(out_memory[allocation_index], allocation_sizes[allocation_index], 1);
+                    statistics_record_allocation(scan_length);
+                }
+            }
+        }
+
+        /*
+            frees count blocks at once. the batch is sorted by address in place (memory and allocation_sizes are
+            reordered) and then merged into the free list in one sweep, reusing the same coalescing paths as
+            deallocate, so the cost is O(count log count + free list length) instead of a list walk per block.
+            with k_use_address_tree every block is looked up in the tree instead, since that is already O(log n)
+        */
+        void deallocate_batch(void** memory, size_type_t* allocation_sizes, size_type_t count) {
+            if constexpr (k_use_address_tree) {
+                for (size_type_t allocation_index = 0; allocation_index < count; ++allocation_index) {
+                    deallocate(memory[allocation_index], allocation_sizes[allocation_index]);
+                }
+            }
+            else {
+                validate_freelist();
+                sort_batch_by_address(memory, allocation_sizes, count);
+
+                auto previous_node = k_bad_displacement;
+                auto current_node = m_first_allocation_node;
+
+                for (size_type_t allocation_index = 0; allocation_index < count; ++allocation_index) {
+                    auto mem_displacement = convert_to_displacement(memory[allocation_index]);
+                    size_type_t allocation_size = allocation_align(allocation_sizes[allocation_index]);
+                    size_type_t walk_length = 0;
+
+                    while (current_node != k_bad_displacement) {
+                        auto translated_node = translate_node(current_node);
+
+                        if (translated_node->m_base > mem_displacement) {
+                            break;
+                        }
+
+                        previous_node = current_node;
+                        current_node = translated_node->m_next_node;
+                        ++walk_length;
+                    }
+                    statistics_record_deallocation(walk_length);
+
+                    m_hooks.deallocate(memory[allocation_index], allocation_sizes[allocation_index]);
+                    size_table_clear_end(static_cast<uint8_t*>(memory[allocation_index]), allocation_size);
+                    //the node holding this block comes before every later block in the batch
+                    auto containing_node = insert_free_region(previous_node, current_node, mem_displacement, allocation_size);
+                    previous_node = convert_to_displacement(containing_node);
+                    current_node = containing_node->m_next_node;
+                }
+                validate_freelist();
+            }
+        }
+
+        /*
+            walks the whole free list with the checks of hardening_level_t::local and compares the free bytes,
+            for k_validation_interval or to call directly. unlike validate_freelist it stays in release builds
+        */
+        void check_integrity() {
+            size_type_t free_node_count = 0;
+            size_type_t computed_avail = 0;
+            for (auto node = m_first_allocation_node; node != k_bad_displacement; node = translate_node(node)->m_next_node) {
+                minialloc_hardening_check(++free_node_count <= m_max_allocations, "free list is longer than the node pool");
+                check_free_node(translate_node(node));
+                computed_avail += translate_node(node)->m_size;
+            }
+            minialloc_hardening_check(computed_avail == m_available_memory, "free bytes do not add up");
+        }
+
+        void assert_allocation_node_correct(allocation_node_t* node) {
+#if MINIALLOC_VERIFY == 1
+            auto displacement = convert_to_displacement(node);
+
+            assert(displacement >= static_cast<allocation_displacement_t>(sizeof(allocation_node_t)));
+            if constexpr (!k_use_absolute_pointers) {
+                assert((displacement % sizeof(allocation_node_t)) == 0);
+            }
+            if (node->m_previous_node == k_bad_displacement) {
+                assert(m_first_allocation_node == displacement);
+            }
+            else {
+                auto prev = translate_node(node->m_previous_node);
+                assert(prev->m_next_node == displacement);
+                assert((prev->m_base + prev->m_size) < node->m_base);
+            }
+
+            if (node->m_next_node != k_bad_displacement) {
+                auto next = translate_node(node->m_next_node);
+
+                assert(next->m_previous_node == displacement);
+
+                auto node_base_psize = node->m_base + node->m_size;
+                assert(next->m_base > node_base_psize);
+            }
+
+            assert(node->m_base + node->m_size <= convert_to_displacement(m_memory + m_total_memory_size));
+
+            assert(node < &reinterpret_cast<allocation_node_t*>(m_memory)[m_max_allocations + 1]);
+
+            if constexpr (k_use_size_classes) {
+                uint32_t first_level, second_level;
+                size_class_mapping(node->m_size, first_level, second_level);
+
+                if (node->m_previous_in_class == k_bad_displacement) {
+                    assert(m_size_classes.m_heads[first_level][second_level] == displacement);
+                }
+                else {
+                    assert(translate_node(node->m_previous_in_class)->m_next_in_class == displacement);
+                }
+
+                if (node->m_next_in_class != k_bad_displacement) {
+                    assert(translate_node(node->m_next_in_class)->m_previous_in_class == displacement);
+                }
+            }
+#endif
+        }
+
+        void assert_pooled_node_correct(allocation_node_t* node) {
+#if MINIALLOC_VERIFY == 1
+            auto displacement = convert_to_displacement(node);
+
+            assert(displacement >= static_cast<allocation_displacement_t>(sizeof(allocation_node_t)));
+            if constexpr (!k_use_absolute_pointers) {
+                assert((displacement % sizeof(allocation_node_t)) == 0);
+            }
+            if (node->m_previous_node == k_bad_displacement) {
+                assert(m_first_pooled_node == displacement);
+            }
+            else {
+                auto prev = translate_node(node->m_previous_node);
+                assert(prev->m_next_node == displacement);
+            }
+
+            if (node->m_next_node != k_bad_displacement) {
+                auto next = translate_node(node->m_next_node);
+
+                assert(next->m_previous_node == displacement);
+            }
+
+            assert(node->m_base == k_bad_displacement);
+            assert(node->m_size == 0);
+            if constexpr (k_use_size_classes) {
+                assert(node->m_next_in_class == k_bad_displacement);
+                assert(node->m_previous_in_class == k_bad_displacement);
+            }
+#endif
+        }
+
+        void assert_is_in_initial_state() {
+#if MINIALLOC_VERIFY == 1
+            dump_allocation_state();
+            size_type_t nodes_in_pool = 0;
+
+            allocation_displacement_t first_pooled = m_first_pooled_node;
+
+            while (first_pooled != k_bad_displacement) {
+                ++nodes_in_pool;
+                first_pooled = translate_node(first_pooled)->m_next_node;
+            }
+            nodes_in_pool += m_max_allocations - m_untouched_node_index;
+
+            assert(nodes_in_pool == m_max_allocations - 1);
+
+
+            assert(m_first_allocation_node != k_bad_displacement);
+
+            auto first_alloc_node = translate_node(m_first_allocation_node);
+            assert(m_available_memory == static_cast<size_type_t>(first_alloc_node->m_size));
+            assert(first_alloc_node->m_next_node == k_bad_displacement);
+            assert(first_alloc_node->m_previous_node == k_bad_displacement);
+            //base must come directly after alloc nodes
+            assert(first_alloc_node->m_base == convert_to_displacement(m_memory + metadata_footprint(m_max_allocations, m_total_memory_size)));
+
+            size_type_t size_after_nodes = m_total_memory_size - metadata_footprint(m_max_allocations, m_total_memory_size);
+
+            assert(static_cast<size_type_t>(first_alloc_node->m_size) == size_after_nodes);
+#endif
+        }
+
+        void dump_allocation_state() {
+            auto node = m_first_allocation_node;
+
+            while (node != k_bad_displacement) {
+                auto xnode = translate_node(node);
+                printf("Node at %llX, base = 0x%llX, size = 0x%llX\n", static_cast<unsigned long long>(node),
+                    static_cast<unsigned long long>(xnode->m_base), static_cast<unsigned long long>(xnode->m_size));
+                node = xnode->m_next_node;
+            }
+
+        }
+
+        void validate_freelist() {
+#if MINIALLOC_VERIFY == 1
+            auto node = m_first_allocation_node;
+            size_type_t computed_avail = 0;
+            size_type_t free_node_count = 0;
+            while (node != k_bad_displacement) {
+                auto current_node = translate_node(node);
+                assert_allocation_node_correct(current_node);
+                if constexpr (k_track_allocation_sizes) {
+                    //no live block may end inside a free region
+                    size_type_t end_bit = size_table_end_bit(translate_displacement<uint8_t>(current_node->m_base), current_node->m_size);
+                    assert(((size_table()[end_bit / 64] >> (end_bit % 64)) & 1) == 0);
+                }
+                computed_avail += current_node->m_size;
+                ++free_node_count;
+                node = current_node->m_next_node;
+            }
+            assert(computed_avail == m_available_memory);
+            if constexpr (k_collect_statistics) {
+                assert(m_statistics.m_nodes_in_use == free_node_count);
+            }
+            validate_size_classes(free_node_count);
+            validate_address_tree(free_node_count);
+            validate_packed_sizes(free_node_count);
+#endif
+        }
+
+        //every free node must have exactly one packed entry, holding its current size
+        void validate_packed_sizes(size_type_t expected_node_count) {
+#if MINIALLOC_VERIFY == 1
+            if constexpr (k_use_packed_sizes) {
+                assert(m_packed_count == expected_node_count);
+                for (size_type_t packed_index = 0; packed_index < m_packed_count; ++packed_index) {
+                    auto node = translate_node(packed_nodes()[packed_index]);
+                    assert_allocation_node_correct(node);
+                    assert(node->m_packed_index == packed_index);
+                    assert(packed_sizes()[packed_index] == packed_key(node->m_size));
+                }
+            }
+#endif
+        }
+
+        //checks the red-black invariants, and that an in order walk of the tree visits the free list in order
+        void validate_address_tree(size_type_t expected_node_count) {
+#if MINIALLOC_VERIFY == 1
+            if constexpr (k_use_address_tree) {
+                auto root = node_or_null(m_address_tree_root);
+                assert(root == nullptr || (tree_parent(root) == nullptr && !tree_is_red(root)));
+
+                size_type_t nodes_in_tree = 0;
+                validate_address_subtree(root, nodes_in_tree);
+                assert(nodes_in_tree == expected_node_count);
+
+                auto tree_node = root;
+                while (tree_node != nullptr && tree_left(tree_node) != nullptr) {
+                    tree_node = tree_left(tree_node);
+                }
+
+                for (auto list_node = m_first_allocation_node; list_node != k_bad_displacement; list_node = translate_node(list_node)->m_next_node) {
+                    assert(tree_node == translate_node(list_node));
+
+                    if (tree_right(tree_node) != nullptr) {
+                        tree_node = tree_right(tree_node);
+                        while (tree_left(tree_node) != nullptr) {
+                            tree_node = tree_left(tree_node);
+                        }
+                    }
+                    else {
+                        auto parent = tree_parent(tree_node);
+                        while (parent != nullptr && tree_node == tree_right(parent)) {
+                            tree_node = parent;
+                            parent = tree_parent(parent);
+                        }
+                        tree_node = parent;
+                    }
+                }
+                assert(tree_node == nullptr);
+            }
+#endif
+        }
+
+        //returns the black height of the subtree
+        size_type_t validate_address_subtree(allocation_node_t* node, size_type_t& node_count) {
+            if (node == nullptr) {
+                return 1;
+            }
+            ++node_count;
+
+            auto left = tree_left(node);
+            auto right = tree_right(node);
+            if (left != nullptr) {
+                assert(tree_parent(left) == node);
+                assert(left->m_base < node->m_base);
+            }
+            if (right != nullptr) {
+                assert(tree_parent(right) == node);
+                assert(right->m_base > node->m_base);
+            }
+            if (tree_is_red(node)) {
+                assert(!tree_is_red(left) && !tree_is_red(right));
+            }
+
+            size_type_t left_height = validate_address_subtree(left, node_count);
+            size_type_t right_height = validate_address_subtree(right, node_count);
+            assert(left_height == right_height);
+            return left_height + (tree_is_red(node) ? 0 : 1);
+        }
+
+        //every free node must be in exactly the size class its size maps to, and the bitmaps must match the heads
+        void validate_size_classes(size_type_t expected_node_count) {
+#if MINIALLOC_VERIFY == 1
+            if constexpr (k_use_size_classes) {
+                size_type_t nodes_in_classes = 0;
+                for (uint32_t first_level = 0; first_level < k_first_level_count; ++first_level) {
+                    bool first_level_set = (m_size_classes.m_first_level_bitmap >> first_level) & 1;
+                    assert(first_level_set == (m_size_classes.m_second_level_bitmaps[first_level] != 0));
+
+                    for (uint32_t second_level = 0; second_level < k_second_level_count; ++second_level) {
+                        auto node = m_size_classes.m_heads[first_level][second_level];
+                        bool second_level_set = (m_size_classes.m_second_level_bitmaps[first_level] >> second_level) & 1;
+                        assert(second_level_set == (node != k_bad_displacement));
+
+                        while (node != k_bad_displacement) {
+                            auto current_node = translate_node(node);
+                            uint32_t node_first_level, node_second_level;
+                            size_class_mapping(current_node->m_size, node_first_level, node_second_level);
+                            assert(node_first_level == first_level && node_second_level == second_level);
+                            ++nodes_in_classes;
+                            node = current_node->m_next_in_class;
+                        }
+                    }
+                }
+                assert(nodes_in_classes == expected_node_count);
+            }
+#endif
+        }
+
+        void validate_nodepool() {
+#if MINIALLOC_VERIFY == 1
+            auto node = m_first_pooled_node;
+            while (node != k_bad_displacement) {
+                assert_pooled_node_correct(translate_node(node));
+                node = translate_node(node)->m_next_node;
+            }
+#endif
+        }
+    };
 
-                    //erase second from the list
-                    first->m_next_node = second->m_next_node;
+    /*
+        boundary tag layout, selected with k_layout = allocator_layout_t::boundary_tags. there is no node pool:
+        every block starts with a header word holding its size and two flags, and a free block additionally
+        keeps its size class links right after the header and a copy of its size (the footer) in its last
+        word. the header leads to the block after a block and the footer of a free block to the block in front
+        of it, so deallocate coalesces in O(1) and the number of free regions is bounded only by the memory.
+
+        free blocks are always found through the segregated fit size classes, k_search_policy and
+        k_use_address_tree do not apply. the memory is framed by a used prologue block, which keeps displacement
+        0 out of the block range, and a zero sized used epilogue header, so every block has a successor.
+        each allocation costs k_block_header_size bytes of header and is rounded up to k_min_block_size
+    */
+    struct boundary_tag_allocator_t {
+        static_assert(!k_collect_statistics, "k_collect_statistics is only supported by the node pool layout");
 
+    private:
+        static constexpr size_type_t k_block_granularity = k_imposed_alignment > sizeof(size_type_t) ? k_imposed_alignment : static_cast<size_type_t>(sizeof(size_type_t));
+        //the header is padded so user memory keeps the granularity of the block
+        static constexpr size_type_t k_block_header_size = k_block_granularity;
+        //the flags live in the low bits of the header, block sizes are multiples of the granularity
+        static constexpr size_type_t k_block_free = 1;
+        static constexpr size_type_t k_previous_block_free = 2;
+        static constexpr size_type_t k_block_flags = k_block_free | k_previous_block_free;
+        //header, size class links and footer of a free block
+        static constexpr size_type_t k_min_block_size = (k_block_header_size + sizeof(size_class_links_t) + sizeof(size_type_t) + k_block_granularity - 1) & ~(k_block_granularity - 1);
+        static_assert(k_block_granularity > k_block_flags);
 
-                    if (first->m_next_node != k_bad_displacement) {
-                        translate_node(first->m_next_node)->m_previous_node = convert_to_displacement(first);
-                    }
+        uint8_t* m_memory;
+        size_type_t m_total_memory_size;
+        //sum of the sizes of all free blocks, headers included
+        size_type_t m_available_memory;
 
-                    release_node_to_pool(second);
-                    assert_allocation_node_correct(first);
-                    return;
+        size_type_t m_in_place_reallocations;
+        size_type_t m_moved_reallocations;
 
-                }
-                first->m_size += allocation_size;
-                assert_allocation_node_correct(first);
-                return;
+        size_class_index_t m_size_classes;
+        //same as in node_pool_allocator_t
+        uint32_t m_operations_since_validation;
+        operation_hooks_t m_hooks;
 
+        uint8_t* translate_block(allocation_displacement_t displacement) {
+            if constexpr (k_use_absolute_pointers) {
+                return reinterpret_cast<uint8_t*>(displacement);
+            }
+            else {
+                return &m_memory[displacement];
             }
+        }
 
-            else if ((allocation_base + allocation_size) == second->m_base) {
-                second->m_base = allocation_base;
-                second->m_size += allocation_size;
-                assert_allocation_node_correct(second);
-                return;
+        allocation_displacement_t convert_to_displacement(uint8_t* block) {
+            if constexpr (k_use_absolute_pointers) {
+                return reinterpret_cast<allocation_displacement_t>(block);
             }
             else {
-                auto new_node = new_node_from_pool();
+                return block - m_memory;
+            }
+        }
 
-                new_node->m_base = allocation_base;
-                new_node->m_size = allocation_size;
-                new_node->m_previous_node = convert_to_displacement(first);
-                new_node->m_next_node = convert_to_displacement(second);
-                first->m_next_node = convert_to_displacement(new_node);
-                second->m_previous_node = convert_to_displacement(new_node);
-                assert_allocation_node_correct(new_node);
-                return;
+        static size_type_t& block_header(uint8_t* block) {
+            return *reinterpret_cast<size_type_t*>(block);
+        }
+
+        static size_type_t block_size(uint8_t* block) {
+            return block_header(block) & ~k_block_flags;
+        }
+
+        static bool block_is_free(uint8_t* block) {
+            return (block_header(block) & k_block_free) != 0;
+        }
+
+        static bool previous_block_is_free(uint8_t* block) {
+            return (block_header(block) & k_previous_block_free) != 0;
+        }
+
+        static size_class_links_t* block_links(uint8_t* block) {
+            return reinterpret_cast<size_class_links_t*>(block + k_block_header_size);
+        }
+
+        static size_type_t& block_footer(uint8_t* block) {
+            return *reinterpret_cast<size_type_t*>(block + block_size(block) - sizeof(size_type_t));
+        }
+
+        //only meaningful while previous_block_is_free, a used block keeps no footer
+        static uint8_t* previous_block(uint8_t* block) {
+            return block - *reinterpret_cast<size_type_t*>(block - sizeof(size_type_t));
+        }
+
+        static uint8_t* block_of(void* memory) {
+            return static_cast<uint8_t*>(memory) - k_block_header_size;
+        }
+
+        //larger requests would wrap around size_type_t in block_size_for, they fail instead
+        static constexpr size_type_t k_max_allocation_size = static_cast<size_type_t>(~static_cast<size_type_t>(0) - k_block_header_size - (k_block_granularity - 1));
+
+        static size_type_t block_size_for(size_type_t allocation_size) {
+            assert(allocation_size <= k_max_allocation_size);
+            size_type_t size = (allocation_size + k_block_header_size + k_block_granularity - 1) & ~(k_block_granularity - 1);
+            return size < k_min_block_size ? k_min_block_size : size;
+        }
+
+        uint8_t* first_block() {
+            return m_memory + k_block_granularity;
+        }
+
+        size_type_t usable_memory_size() const {
+            return (m_total_memory_size - 2 * k_block_granularity) & ~(k_block_granularity - 1);
+        }
+
+        uint8_t* epilogue_block() {
+            return first_block() + usable_memory_size();
+        }
+
+        void free_block_insert(uint8_t* block) {
+            uint32_t first_level, second_level;
+            size_class_mapping(block_size(block), first_level, second_level);
+
+            auto block_displ = convert_to_displacement(block);
+            auto& head = m_size_classes.m_heads[first_level][second_level];
+            auto links = block_links(block);
+
+            links->m_next_in_class = head;
+            links->m_previous_in_class = k_bad_displacement;
+            if (head != k_bad_displacement) {
+                block_links(translate_block(head))->m_previous_in_class = block_displ;
             }
+            head = block_displ;
 
+            m_size_classes.mark_non_empty(first_level, second_level);
         }
-    public:
-        void* allocate(size_type_t allocation_size) {
-            allocation_size = allocation_align(allocation_size);
-            allocation_node_t* current_node = nullptr;
-            for (allocation_displacement_t node_displacement = m_first_allocation_node; node_displacement != k_bad_displacement; node_displacement = current_node->m_next_node) {
-                current_node = translate_node(node_displacement);
-                if (current_node->m_size >= allocation_size) {
-
-                    if (current_node->m_size != allocation_size) {
-                        //shrink the node
-                        auto result_displacement = current_node->m_base;
-                        current_node->m_base += allocation_size;
-                        current_node->m_size -= allocation_size;
-                        m_available_memory -= allocation_size;
-                        validate_freelist();
-                        return translate_displacement<uint8_t>(result_displacement);
 
-                    }
-                    else {
-                        //exact match!
+        //O(1) good fit lookup, walks the class of size itself only when no larger class has a block
+        allocation_displacement_t free_block_find(size_type_t size) {
+            return m_size_classes.find(size,
+                [this](allocation_displacement_t block) -> size_type_t { return block_size(translate_block(block)); },
+                [this](allocation_displacement_t block) -> allocation_displacement_t { return block_links(translate_block(block))->m_next_in_class; });
+        }
 
-                        if (node_displacement != m_first_allocation_node) {
-                            auto result_displacement = current_node->m_base;
+        void free_block_remove(uint8_t* block) {
+            uint32_t first_level, second_level;
+            size_class_mapping(block_size(block), first_level, second_level);
 
-                            if (current_node->m_next_node != k_bad_displacement) {
-                                translate_node(current_node->m_next_node)->m_previous_node = current_node->m_previous_node;
-                            }
-                            translate_node(current_node->m_previous_node)->m_next_node = current_node->m_next_node;
+            auto links = block_links(block);
+            if (links->m_next_in_class != k_bad_displacement) {
+                block_links(translate_block(links->m_next_in_class))->m_previous_in_class = links->m_previous_in_class;
+            }
 
-                            release_node_to_pool(current_node);
-                            m_available_memory -= allocation_size;
-                            validate_freelist();
+            if (links->m_previous_in_class != k_bad_displacement) {
+                block_links(translate_block(links->m_previous_in_class))->m_next_in_class = links->m_next_in_class;
+            }
+            else {
+                auto& head = m_size_classes.m_heads[first_level][second_level];
+                assert(head == convert_to_displacement(block));
+                head = links->m_next_in_class;
 
-                            return translate_displacement<uint8_t>(result_displacement);
-                        }
-                        else {
-                            //exact match on the front of the list
-                            m_first_allocation_node = current_node->m_next_node;
-                            if (m_first_allocation_node != k_bad_displacement) {
-                                translate_node(m_first_allocation_node)->m_previous_node = k_bad_displacement;
+                if (head == k_bad_displacement) {
+                    m_size_classes.mark_empty(first_level, second_level);
+                }
+            }
+        }
 
-                            }
-                            auto result_displacement = current_node->m_base;
-                            release_node_to_pool(current_node);
-                            m_available_memory -= allocation_size;
-                            validate_freelist();
-                            return translate_displacement<uint8_t>(result_displacement);
-                        }
-                    }
+        //a granularity aligned address between the prologue and the epilogue
+        bool is_block_address(uint8_t* block) {
+            return block >= first_block() && block < epilogue_block() && ((block - m_memory) & (k_block_granularity - 1)) == 0;
+        }
+
+        bool is_valid_block_size(uint8_t* block, size_type_t size) {
+            return size >= k_min_block_size && (size & (k_block_granularity - 1)) == 0 && size <= static_cast<size_type_t>(epilogue_block() - block);
+        }
+
+        //the O(1) checks of hardening_level_t::local on a free block, its neighbors and its size class links
+        void check_free_block(uint8_t* block) {
+            minialloc_hardening_check(is_block_address(block) && block_is_free(block) && !previous_block_is_free(block), "free block header mismatch");
+            size_type_t size = block_size(block);
+            minialloc_hardening_check(is_valid_block_size(block, size) && block_footer(block) == size, "free block size mismatch");
+            minialloc_hardening_check(previous_block_is_free(block + size) && !block_is_free(block + size), "block after a free block has the wrong flags");
+
+            auto displacement = convert_to_displacement(block);
+            auto links = block_links(block);
+            if (links->m_previous_in_class != k_bad_displacement) {
+                auto previous = translate_block(links->m_previous_in_class);
+                minialloc_hardening_check(is_block_address(previous) && block_links(previous)->m_next_in_class == displacement, "size class link mismatch");
+            }
+            if (links->m_next_in_class != k_bad_displacement) {
+                auto next = translate_block(links->m_next_in_class);
+                minialloc_hardening_check(is_block_address(next) && block_links(next)->m_previous_in_class == displacement, "size class link mismatch");
+            }
+        }
+
+        //the checks of hardening_level_t::local on a used block about to be freed, and on the free blocks it merges with
+        void check_released_block(uint8_t* block) {
+            minialloc_hardening_check(is_block_address(block), "freed block outside of the heap");
+            minialloc_hardening_check(!block_is_free(block), "freed block is already free, a double free");
+            size_type_t size = block_size(block);
+            minialloc_hardening_check(is_valid_block_size(block, size), "freed block has a corrupted header");
+
+            auto next = block + size;
+            minialloc_hardening_check(!previous_block_is_free(next), "freed block lies in free memory, a double free");
+            if (block_is_free(next)) {
+                check_free_block(next);
+            }
+            if (previous_block_is_free(block)) {
+                auto previous = previous_block(block);
+                minialloc_hardening_check(previous >= first_block() && previous < block, "freed block has a corrupted header");
+                check_free_block(previous);
+                minialloc_hardening_check(previous + block_size(previous) == block, "freed block has a corrupted header");
+            }
+        }
 
+        void hardening_count_operation() {
+            if constexpr (k_validation_interval != 0) {
+                if (++m_operations_since_validation == k_validation_interval) {
+                    m_operations_since_validation = 0;
+                    check_integrity();
                 }
             }
-            assert(false);
-            return nullptr;
         }
 
+        //removes a free block from its size class and marks it used, its size is unchanged
+        void take_free_block(uint8_t* block) {
+            if constexpr (k_local_checks) {
+                check_free_block(block);
+            }
+            assert(block_is_free(block) && !previous_block_is_free(block));
+            free_block_remove(block);
+            size_type_t size = block_size(block);
+            m_available_memory -= size;
+            block_header(block) = size;
+            block_header(block + size) &= ~k_previous_block_free;
+        }
+
+        //frees a used block and merges it with free neighbors, the neighbors of a free block are never free themselves
+        void release_block(uint8_t* block) {
+            if constexpr (k_local_checks) {
+                check_released_block(block);
+            }
+            assert(!block_is_free(block));
+            size_type_t size = block_size(block);
+            m_available_memory += size;
+
+            auto next = block + size;
+            if (block_is_free(next)) {
+                free_block_remove(next);
+                size += block_size(next);
+            }
+            if (previous_block_is_free(block)) {
+                auto previous = previous_block(block);
+                assert(block_is_free(previous));
+                free_block_remove(previous);
+                size += block_size(previous);
+                block = previous;
+            }
 
-        void deallocate(void* memory, size_type_t allocation_size) {
-            allocation_size = allocation_align(allocation_size);
-            validate_freelist();
-            auto mem_displacement = convert_to_displacement(memory);
+            block_header(block) = size | k_block_free;
+            block_footer(block) = size;
+            block_header(block + size) |= k_previous_block_free;
+            free_block_insert(block);
+        }
 
-            auto previous_node = k_bad_displacement;
+        //prologue, one free block and the epilogue, for the constructor and reset()
+        void initialize() {
+            m_available_memory = 0;
+            m_in_place_reallocations = 0;
+            m_moved_reallocations = 0;
+            m_size_classes = size_class_index_t{};
+            m_operations_since_validation = 0;
 
-            auto current_node = m_first_allocation_node;
+            block_header(m_memory) = k_block_granularity;
 
-            while (current_node != k_bad_displacement) {
-                auto translated_node = translate_node(current_node);
+            auto block = first_block();
+            block_header(block) = usable_memory_size();
+            block_header(epilogue_block()) = 0;
+            release_block(block);
+        }
 
-                if (translated_node->m_base > mem_displacement) {
-                    break;
-                }
+        //returns everything of a used block past size to the free blocks, if it is large enough to form a block
+        void trim_block(uint8_t* block, size_type_t size) {
+            size_type_t current_size = block_size(block);
+            assert(size <= current_size);
+            if (current_size - size < k_min_block_size) {
+                return;
+            }
+            block_header(block) = size | (block_header(block) & k_previous_block_free);
+            auto tail = block + size;
+            block_header(tail) = current_size - size;
+            release_block(tail);
+        }
+
+    public:
+        boundary_tag_allocator_t(uint8_t* mem, size_type_t total_memory_size) :
+            m_memory(mem),
+            m_total_memory_size(total_memory_size),
+            m_available_memory(0),
+            m_in_place_reallocations(0),
+            m_moved_reallocations(0),
+            m_size_classes(),
+            m_operations_since_validation(0),
+            m_hooks() {
+
+            //headers are read as size_type_t and user memory is aligned to the granularity
+            assert((reinterpret_cast<uintptr_t>(m_memory) & (k_block_granularity - 1)) == 0);
+            assert(total_memory_size >= 2 * k_block_granularity + k_min_block_size);
+            initialize();
+        }
+
+        //the node count is meaningless here, this lets code written for the node pool layout construct either one
+        boundary_tag_allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_allocations) :
+            boundary_tag_allocator_t(mem, total_memory_size) {
+            (void)max_allocations;
+        }
+
+        //same contract as node_pool_allocator_t::rebase
+        void rebase(uint8_t* mem) {
+            static_assert(!k_use_absolute_pointers, "rebase() requires relative displacements");
+            assert((reinterpret_cast<uintptr_t>(mem) & (k_block_granularity - 1)) == 0);
+            m_memory = mem;
+            m_hooks = operation_hooks_t{};
+        }
 
-                previous_node = current_node;
-                current_node = translated_node->m_next_node;
+        //rewrites the prologue, the epilogue and one free block in between
+        void reset() {
+            m_hooks.reset();
+            initialize();
+        }
+
+        //the footer of a free last block leads straight to the frontier
+        allocation_mark_t mark() {
+            auto end = epilogue_block();
+            auto frontier = previous_block_is_free(end) ? previous_block(end) : end;
+            return allocation_mark_t{ convert_to_displacement(frontier), m_available_memory, 0 };
+        }
 
+        //same contract as node_pool_allocator_t::release_to, costs one step per block above the frontier
+        void release_to(const allocation_mark_t& mark) {
+            auto frontier = translate_block(mark.m_frontier);
+            m_hooks.release_to(frontier + k_block_header_size);
+            auto end = epilogue_block();
+            if (frontier == end) {
+                return;
             }
 
-            if (previous_node == k_bad_displacement) {
-                append_allocation_to_front(mem_displacement, allocation_size);
-                m_available_memory += allocation_size;
+            //only blocks allocated since the mark were freed, so the frontier is still a block boundary
+            for (auto block = frontier; block != end; block += block_size(block)) {
+                assert(block < end);
+                if (block_is_free(block)) {
+                    free_block_remove(block);
+                    m_available_memory -= block_size(block);
+                }
             }
-            else if (current_node == k_bad_displacement) {
+            block_header(frontier) = static_cast<size_type_t>(end - frontier) | (block_header(frontier) & k_previous_block_free);
+            block_header(end) &= ~k_previous_block_free;
+            release_block(frontier);
+            assert(m_available_memory >= mark.m_available_memory);
+            validate_freelist();
+        }
 
-                insert_allocation_to_tail(translate_node(previous_node), mem_displacement, allocation_size);
-                m_available_memory += allocation_size;
+        //like allocate, but running out of memory is not an error
+        void* try_allocate(size_type_t allocation_size) {
+            if (allocation_size > k_max_allocation_size) {
+                return nullptr;
             }
-            else {
-                insert_allocation_between(translate_node(previous_node), translate_node(current_node), mem_displacement, allocation_size);
-                m_available_memory += allocation_size;
+            size_type_t size = block_size_for(allocation_size);
+            auto fitting_block = free_block_find(size);
+            if (fitting_block == k_bad_displacement) {
+                return nullptr;
             }
+            auto block = translate_block(fitting_block);
+            take_free_block(block);
+            trim_block(block, size);
             validate_freelist();
+            hardening_count_operation();
+            m_hooks.allocate(block + k_block_header_size, allocation_size, 1);
+            return block + k_block_header_size;
         }
 
-        void assert_allocation_node_correct(allocation_node_t* node) {
-#if MINIALLOC_VERIFY == 1
-            auto displacement = convert_to_displacement(node);
+        void* allocate(size_type_t allocation_size) {
+            void* result = try_allocate(allocation_size);
+            if (result == nullptr) {
+                m_hooks.allocation_failed(allocation_size);
+            }
+            assert(result != nullptr);
+            return result;
+        }
 
-            assert(displacement >= sizeof(allocation_node_t));
-            if constexpr (!k_use_absolute_pointers) {
-                assert((displacement % sizeof(allocation_node_t)) == 0);
+        /*
+            alignment must be a power of two. the block is looked up with enough slack that the bytes in front
+            of the aligned address can always form a free block of their own, which goes straight back to the
+            size classes
+        */
+        void* try_allocate_aligned(size_type_t allocation_size, size_type_t alignment) {
+            assert((alignment & (alignment - 1)) == 0);
+            if (alignment <= k_block_granularity) {
+                return try_allocate(allocation_size);
             }
-            if (node->m_previous_node == k_bad_displacement) {
-                assert(m_first_allocation_node == displacement);
+            //the block is looked up alignment + k_min_block_size bytes larger
+            if (allocation_size > k_max_allocation_size - alignment - k_min_block_size) {
+                return nullptr;
             }
-            else {
-                auto prev = translate_node(node->m_previous_node);
-                assert(prev->m_next_node == displacement);
-                assert((prev->m_base + prev->m_size) < node->m_base);
+            size_type_t size = block_size_for(allocation_size);
+            auto fitting_block = free_block_find(size + alignment + k_min_block_size);
+            if (fitting_block == k_bad_displacement) {
+                return nullptr;
             }
+            auto block = translate_block(fitting_block);
+            take_free_block(block);
+
+            auto memory = reinterpret_cast<uintptr_t>(block + k_block_header_size);
+            size_type_t padding = static_cast<size_type_t>(((memory + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1)) - memory);
+            if (padding != 0) {
+                while (padding < k_min_block_size) {
+                    padding += alignment;
+                }
+                size_type_t total_size = block_size(block);
+                block_header(block) = padding;
+                block_header(block + padding) = total_size - padding;
+                release_block(block);
+                block += padding;
+            }
+            trim_block(block, size);
+            validate_freelist();
+            hardening_count_operation();
+            m_hooks.allocate(block + k_block_header_size, allocation_size, alignment);
+            return block + k_block_header_size;
+        }
 
-            if (node->m_next_node != k_bad_displacement) {
-                auto next = translate_node(node->m_next_node);
+        void* allocate_aligned(size_type_t allocation_size, size_type_t alignment) {
+            void* result = try_allocate_aligned(allocation_size, alignment);
+            if (result == nullptr) {
+                m_hooks.allocation_failed(allocation_size);
+            }
+            assert(result != nullptr);
+            return result;
+        }
 
-                assert(next->m_previous_node == displacement);
+        void deallocate_aligned(void* memory, size_type_t allocation_size, size_type_t alignment) {
+            assert((reinterpret_cast<uintptr_t>(memory) & (alignment - 1)) == 0);
+            (void)alignment;
+            deallocate(memory, allocation_size);
+        }
 
-                auto node_base_psize = node->m_base + node->m_size;
-                assert(next->m_base > node_base_psize);
+        //allocation_size is only checked, the header records the real block size
+        void deallocate(void* memory, size_type_t allocation_size) {
+            if constexpr (k_size_tags) {
+                //a block is never more than one unsplittable remainder larger than its last requested size
+                auto block = block_of(static_cast<uint8_t*>(memory));
+                minialloc_hardening_check(is_block_address(block), "freed block outside of the heap");
+                minialloc_hardening_check(allocation_size <= k_max_allocation_size && block_size_for(allocation_size) <= block_size(block) && block_size(block) < block_size_for(allocation_size) + k_min_block_size,
+                    "block size does not match, a double free or the wrong size");
             }
+            assert(block_size_for(allocation_size) <= block_size(block_of(memory)));
+            m_hooks.deallocate(memory, allocation_size);
+            release_block(block_of(memory));
+            validate_freelist();
+            hardening_count_operation();
+        }
 
-            assert(node->m_base + node->m_size <= m_total_memory_size);
+        void deallocate(void* memory) {
+            m_hooks.deallocate(memory, allocation_size(memory));
+            release_block(block_of(memory));
+            validate_freelist();
+            hardening_count_operation();
+        }
 
-            assert(node < &reinterpret_cast<allocation_node_t*>(m_memory)[m_max_allocations + 1]);
-#endif
+        //usable bytes of a live block, at least what was asked for
+        size_type_t allocation_size(void* memory) {
+            return block_size(block_of(memory)) - k_block_header_size;
         }
 
-        void assert_pooled_node_correct(allocation_node_t* node) {
-#if MINIALLOC_VERIFY == 1
-            auto displacement = convert_to_displacement(node);
+        //same contract as node_pool_allocator_t::try_expand, a block that already holds new_size is trimmed to it
+        bool try_expand(void* memory, size_type_t old_size, size_type_t new_size) {
+            if (new_size > k_max_allocation_size) {
+                return false;
+            }
+            auto block = block_of(memory);
+            size_type_t size = block_size_for(new_size);
+            size_type_t current_size = block_size(block);
+            if (size <= current_size) {
+                m_hooks.resize(memory, old_size, new_size);
+                trim_block(block, size);
+                validate_freelist();
+                return true;
+            }
 
-            assert(displacement >= sizeof(allocation_node_t));
-            if constexpr (!k_use_absolute_pointers) {
-                assert((displacement % sizeof(allocation_node_t)) == 0);
+            auto next = block + current_size;
+            if (!block_is_free(next) || current_size + block_size(next) < size) {
+                return false;
             }
-            if (node->m_previous_node == k_bad_displacement) {
-                assert(m_first_pooled_node == displacement);
+            take_free_block(next);
+            block_header(block) = (current_size + block_size(next)) | (block_header(block) & k_previous_block_free);
+            trim_block(block, size);
+            validate_freelist();
+            m_hooks.resize(memory, old_size, new_size);
+            return true;
+        }
+
+        void shrink(void* memory, size_type_t old_size, size_type_t new_size) {
+            assert(new_size <= old_size);
+            m_hooks.resize(memory, old_size, new_size);
+            trim_block(block_of(memory), block_size_for(new_size));
+            validate_freelist();
+        }
+
+        //same contract as node_pool_allocator_t::reallocate
+        void* reallocate(void* memory, size_type_t old_size, size_type_t new_size) {
+            if (memory == nullptr) {
+                return try_allocate(new_size);
             }
-            else {
-                auto prev = translate_node(node->m_previous_node);
-                assert(prev->m_next_node == displacement);
+            if (new_size == 0) {
+                deallocate(memory, old_size);
+                return nullptr;
             }
 
-            if (node->m_next_node != k_bad_displacement) {
-                auto next = translate_node(node->m_next_node);
+            if (new_size <= old_size) {
+                shrink(memory, old_size, new_size);
+                ++m_in_place_reallocations;
+                return memory;
+            }
+            if (try_expand(memory, old_size, new_size)) {
+                ++m_in_place_reallocations;
+                return memory;
+            }
 
-                assert(next->m_previous_node == displacement);
+            void* new_memory = try_allocate(new_size);
+            if (new_memory == nullptr) {
+                return nullptr;
             }
+            memcpy(new_memory, memory, old_size);
+            deallocate(memory, old_size);
+            ++m_moved_reallocations;
+            return new_memory;
+        }
 
-            assert(node->m_base == k_bad_displacement);
-            assert(node->m_size == 0);
-#endif
+        //every allocation is O(1) already, these exist so both layouts offer the same interface
+        void allocate_n(const size_type_t* allocation_sizes, void** out_memory, size_type_t count) {
+            for (size_type_t allocation_index = 0; allocation_index < count; ++allocation_index) {
+                out_memory[allocation_index] = allocate(allocation_sizes[allocation_index]);
+            }
         }
 
-        void assert_is_in_initial_state() {
-#if MINIALLOC_VERIFY == 1
-            dump_allocation_state();
-            size_type_t nodes_in_pool = 0;
+        void deallocate_batch(void** memory, size_type_t* allocation_sizes, size_type_t count) {
+            for (size_type_t allocation_index = 0; allocation_index < count; ++allocation_index) {
+                deallocate(memory[allocation_index], allocation_sizes[allocation_index]);
+            }
+        }
 
-            allocation_displacement_t first_pooled = m_first_pooled_node;
+        //free bytes including the headers of the free blocks, whether or not they are contiguous
+        size_type_t available_memory() const {
+            return m_available_memory;
+        }
 
-            while (first_pooled != k_bad_displacement) {
-                ++nodes_in_pool;
-                first_pooled = translate_node(first_pooled)->m_next_node;
-            }
+        //same contract as node_pool_allocator_t::set_recorder
+        void set_recorder(allocation_recorder_t* recorder) {
+            static_assert(k_record_operations, "set_recorder() requires k_record_operations in the traits");
+            m_hooks.m_recorder = recorder;
+        }
 
-            assert(nodes_in_pool == m_max_allocations - 1);
+        //same contract as node_pool_allocator_t::set_sampler
+        void set_sampler(allocation_sampler_t* sampler) {
+            static_assert(k_sample_allocations, "set_sampler() requires k_sample_allocations in the traits");
+            m_hooks.attach(sampler);
+        }
 
+        //size of the largest free block, header included
+        size_type_t largest_free_region() {
+            size_type_t largest = 0;
+            if (m_size_classes.m_first_level_bitmap != 0) {
+                uint32_t first_level = minialloc_bitscan_reverse(m_size_classes.m_first_level_bitmap);
+                uint32_t second_level = minialloc_bitscan_reverse(m_size_classes.m_second_level_bitmaps[first_level]);
 
-            assert(m_first_allocation_node != k_bad_displacement);
+                for (auto block = m_size_classes.m_heads[first_level][second_level]; block != k_bad_displacement; block = block_links(translate_block(block))->m_next_in_class) {
+                    if (block_size(translate_block(block)) > largest) {
+                        largest = block_size(translate_block(block));
+                    }
+                }
+            }
+            return largest;
+        }
 
-            auto first_alloc_node = translate_node(m_first_allocation_node);
-            assert(m_available_memory == first_alloc_node->m_size);
-            assert(first_alloc_node->m_next_node == k_bad_displacement);
-            assert(first_alloc_node->m_previous_node == k_bad_displacement);
-            //base must come directly after alloc nodes
-            assert(first_alloc_node->m_base == sizeof(allocation_node_t) * (m_max_allocations + 1));
+        size_type_t in_place_reallocation_count() const {
+            return m_in_place_reallocations;
+        }
 
-            size_type_t size_after_nodes = m_total_memory_size - (sizeof(allocation_node_t) * (m_max_allocations + 1));
+        size_type_t moved_reallocation_count() const {
+            return m_moved_reallocations;
+        }
 
-            assert(first_alloc_node->m_size == size_after_nodes);
+        void assert_is_in_initial_state() {
+#if MINIALLOC_VERIFY == 1
+            dump_allocation_state();
+            auto block = first_block();
+            assert(block_is_free(block));
+            assert(block_size(block) == usable_memory_size());
+            assert(m_available_memory == usable_memory_size());
+            assert(block + block_size(block) == epilogue_block());
 #endif
         }
 
         void dump_allocation_state() {
-            auto node = m_first_allocation_node;
-
-            while (node != k_bad_displacement) {
-                auto xnode = translate_node(node);
-                printf("Node at %llX, base = 0x%llX, size = 0x%llX\n", node, xnode->m_base, xnode->m_size);
-                node = xnode->m_next_node;
+            for (auto block = first_block(); block != epilogue_block(); block += block_size(block)) {
+                printf("Block at %llX, size = 0x%llX%s\n", static_cast<unsigned long long>(block - m_memory),
+                    static_cast<unsigned long long>(block_size(block)), block_is_free(block) ? ", free" : "");
             }
+        }
 
+        //same contract as node_pool_allocator_t::check_integrity, walks every block in address order
+        void check_integrity() {
+            minialloc_hardening_check(block_header(m_memory) == k_block_granularity, "prologue overwritten");
+            size_type_t computed_avail = 0;
+            bool previous_free = false;
+            auto end = epilogue_block();
+            for (auto block = first_block(); block != end; block += block_size(block)) {
+                size_type_t size = block_size(block);
+                minialloc_hardening_check(is_valid_block_size(block, size), "block size out of range");
+                minialloc_hardening_check(previous_block_is_free(block) == previous_free, "previous block free flag mismatch");
+                if (block_is_free(block)) {
+                    minialloc_hardening_check(!previous_free && block_footer(block) == size, "free block footer mismatch");
+                    computed_avail += size;
+                }
+                previous_free = block_is_free(block);
+            }
+            minialloc_hardening_check((block_header(end) & ~k_previous_block_free) == 0 && previous_block_is_free(end) == previous_free, "epilogue overwritten");
+            minialloc_hardening_check(computed_avail == m_available_memory, "free bytes do not add up");
         }
 
+        //walks every block in address order and checks the flags, footers, coalescing and the free byte count
         void validate_freelist() {
 #if MINIALLOC_VERIFY == 1
-            auto node = m_first_allocation_node;
+            assert(block_header(m_memory) == k_block_granularity);
+
             size_type_t computed_avail = 0;
-            while (node != k_bad_displacement) {
-                auto current_node = translate_node(node);
-                assert_allocation_node_correct(current_node);
-                computed_avail += current_node->m_size;
-                node = current_node->m_next_node;
+            size_type_t free_block_count = 0;
+            bool previous_free = false;
+            auto end = epilogue_block();
+            auto block = first_block();
+            while (block != end) {
+                assert(block < end);
+                size_type_t size = block_size(block);
+                assert(size >= k_min_block_size);
+                assert((size & (k_block_granularity - 1)) == 0);
+                assert(previous_block_is_free(block) == previous_free);
+
+                if (block_is_free(block)) {
+                    //two free blocks in a row should have been merged
+                    assert(!previous_free);
+                    assert(block_footer(block) == size);
+                    computed_avail += size;
+                    ++free_block_count;
+                }
+                previous_free = block_is_free(block);
+                block += size;
             }
+            assert(block_size(end) == 0 && !block_is_free(end));
+            assert(previous_block_is_free(end) == previous_free);
             assert(computed_avail == m_available_memory);
+            validate_size_classes(free_block_count);
 #endif
         }
 
-        void validate_nodepool() {
+        void validate_size_classes(size_type_t expected_block_count) {
 #if MINIALLOC_VERIFY == 1
-            auto node = m_first_pooled_node;
-            while (node != k_bad_displacement) {
-                assert_pooled_node_correct(translate_node(node));
-                node = translate_node(node)->m_next_node;
+            size_type_t blocks_in_classes = 0;
+            for (uint32_t first_level = 0; first_level < k_first_level_count; ++first_level) {
+                bool first_level_set = (m_size_classes.m_first_level_bitmap >> first_level) & 1;
+                assert(first_level_set == (m_size_classes.m_second_level_bitmaps[first_level] != 0));
+
+                for (uint32_t second_level = 0; second_level < k_second_level_count; ++second_level) {
+                    auto block = m_size_classes.m_heads[first_level][second_level];
+                    bool second_level_set = (m_size_classes.m_second_level_bitmaps[first_level] >> second_level) & 1;
+                    assert(second_level_set == (block != k_bad_displacement));
+
+                    auto previous = k_bad_displacement;
+                    while (block != k_bad_displacement) {
+                        auto current_block = translate_block(block);
+                        assert(block_is_free(current_block));
+                        assert(block_links(current_block)->m_previous_in_class == previous);
+                        uint32_t block_first_level, block_second_level;
+                        size_class_mapping(block_size(current_block), block_first_level, block_second_level);
+                        assert(block_first_level == first_level && block_second_level == second_level);
+                        ++blocks_in_classes;
+                        previous = block;
+                        block = block_links(current_block)->m_next_in_class;
+                    }
+                }
             }
-        }
+            assert(blocks_in_classes == expected_block_count);
 #endif
+        }
+
+        //there is no node pool in this layout
+        void validate_nodepool() {
+        }
     };
+
+    using allocator_t = std::conditional_t<k_use_boundary_tags, boundary_tag_allocator_t, node_pool_allocator_t>;
 };
\ No newline at end of file
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "minialloc.hpp"
+
+//most regions a growable heap can hold at once, with doubling sizes this is never the limit in practice
+MINIALLOC_OPTIONAL_TRAIT(k_max_regions, uint32_t, 48)
+//hand regions that no longer hold any allocation back to the region provider
+MINIALLOC_OPTIONAL_TRAIT(k_release_empty_regions, bool, false)
+
+/*
+    the default region provider, fresh pages straight from the operating system. a provider only needs these
+    two members, regions must be at least 64 byte aligned
+*/
+struct virtual_memory_region_provider_t {
+    void* map_region(size_t region_size) {
+#if defined(_WIN32)
+        return VirtualAlloc(nullptr, region_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+        void* memory = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return memory == MAP_FAILED ? nullptr : memory;
+#endif
+    }
+
+    void unmap_region(void* memory, size_t region_size) {
+#if defined(_WIN32)
+        (void)region_size;
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, region_size);
+#endif
+    }
+};
+
+/*
+    a heap made of several allocator_t regions, so it does not have to be sized for its worst case up front.
+    when no region can serve a request a new one is mapped from the region provider, twice as large (and with
+    twice the node count) as the previous one, or larger if the request needs it.
+
+    each region holds its allocator object in its first bytes. the regions are kept sorted by address, so a
+    free finds its region with a binary search. allocation tries the region that served the last one first,
+    then the others from the largest down.
+
+    a node pool region never takes more than max_allocations - 1 live blocks, which bounds its free nodes by
+    max_allocations, so frees cannot run out of nodes
+*/
+template<typename Traits, typename RegionProvider = virtual_memory_region_provider_t>
+struct growable_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static constexpr uint32_t k_max_regions = optional_k_max_regions_t<Traits>::value;
+    static constexpr bool k_release_empty_regions = optional_k_release_empty_regions_t<Traits>::value;
+    static constexpr size_t k_region_header_size = (sizeof(backing_allocator_t) + 63) & ~static_cast<size_t>(63);
+
+    struct region_t {
+        uint8_t* m_memory;
+        size_t m_size;
+        size_type_t m_max_allocations;
+        size_type_t m_live_allocations;
+
+        backing_allocator_t* allocator() const {
+            return std::launder(reinterpret_cast<backing_allocator_t*>(m_memory));
+        }
+
+        bool is_full() const {
+            return m_live_allocations + 1 >= m_max_allocations;
+        }
+
+        bool contains(void* memory) const {
+            return static_cast<uint8_t*>(memory) >= m_memory && static_cast<uint8_t*>(memory) < m_memory + m_size;
+        }
+    };
+
+    struct allocator_t {
+    private:
+        RegionProvider m_provider;
+        //sorted by address
+        region_t m_regions[k_max_regions];
+        uint32_t m_region_count;
+        //the region that served the last allocation, or k_max_regions when there is none
+        uint32_t m_current_region;
+        //size and node count of the next region
+        size_t m_next_region_size;
+        size_type_t m_next_max_allocations;
+
+        uint32_t region_index_of(void* memory) const {
+            uint32_t low = 0;
+            uint32_t high = m_region_count;
+            //the last region that starts at or below memory
+            while (high - low > 1) {
+                uint32_t middle = (low + high) / 2;
+                if (m_regions[middle].m_memory <= static_cast<uint8_t*>(memory)) {
+                    low = middle;
+                }
+                else {
+                    high = middle;
+                }
+            }
+            assert(m_region_count != 0 && m_regions[low].contains(memory));
+            return low;
+        }
+
+        void* try_allocate_in(region_t& region, size_type_t allocation_size, size_type_t alignment) {
+            if (region.is_full()) {
+                return nullptr;
+            }
+            void* result = region.allocator()->try_allocate_aligned(allocation_size, alignment);
+            if (result != nullptr) {
+                ++region.m_live_allocations;
+            }
+            return result;
+        }
+
+        //returns the index of the new region, or k_max_regions if none could be mapped
+        uint32_t add_region(size_t region_size, size_type_t max_allocations) {
+            if (m_region_count == k_max_regions) {
+                return k_max_regions;
+            }
+            auto memory = static_cast<uint8_t*>(m_provider.map_region(region_size));
+            if (memory == nullptr) {
+                return k_max_regions;
+            }
+            assert((reinterpret_cast<uintptr_t>(memory) & 63) == 0);
+            new (memory) backing_allocator_t(memory + k_region_header_size,
+                static_cast<size_type_t>(region_size - k_region_header_size), max_allocations);
+
+            uint32_t region_index = m_region_count;
+            while (region_index != 0 && m_regions[region_index - 1].m_memory > memory) {
+                m_regions[region_index] = m_regions[region_index - 1];
+                --region_index;
+            }
+            m_regions[region_index] = region_t{ memory, region_size, max_allocations, 0 };
+            ++m_region_count;
+            if (m_current_region != k_max_regions && m_current_region >= region_index) {
+                ++m_current_region;
+            }
+            return region_index;
+        }
+
+        void remove_region(uint32_t region_index) {
+            region_t region = m_regions[region_index];
+            region.allocator()->~backing_allocator_t();
+            m_provider.unmap_region(region.m_memory, region.m_size);
+
+            for (uint32_t index = region_index; index + 1 < m_region_count; ++index) {
+                m_regions[index] = m_regions[index + 1];
+            }
+            --m_region_count;
+            m_current_region = k_max_regions;
+        }
+
+        //maps regions until one can hold the request, growing geometrically
+        void* grow_and_allocate(size_type_t allocation_size, size_type_t alignment) {
+            //room for the request after metadata, size class rounding and alignment padding
+            size_t needed_size = k_region_header_size + 2 * (static_cast<size_t>(allocation_size) + alignment);
+            while (m_next_region_size < needed_size) {
+                m_next_region_size *= 2;
+                m_next_max_allocations *= 2;
+            }
+
+            for (;;) {
+                uint32_t region_index = add_region(m_next_region_size, m_next_max_allocations);
+                if (region_index == k_max_regions) {
+                    return nullptr;
+                }
+                m_next_region_size *= 2;
+                m_next_max_allocations *= 2;
+
+                void* result = try_allocate_in(m_regions[region_index], allocation_size, alignment);
+                if (result != nullptr) {
+                    m_current_region = region_index;
+                    return result;
+                }
+                //the metadata left too little room, the next, larger region will do
+                remove_region(region_index);
+            }
+        }
+
+    public:
+        /*
+            the first region is mapped on the first allocation. its node count bounds the live blocks it can
+            hold, later regions double both
+        */
+        allocator_t(size_t initial_region_size, size_type_t initial_max_allocations, RegionProvider provider = RegionProvider{}) :
+            m_provider(provider),
+            m_regions(),
+            m_region_count(0),
+            m_current_region(k_max_regions),
+            m_next_region_size(initial_region_size),
+            m_next_max_allocations(initial_max_allocations) {
+            assert(initial_region_size > k_region_header_size);
+            assert(initial_max_allocations > 1);
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        ~allocator_t() {
+            while (m_region_count != 0) {
+                remove_region(m_region_count - 1);
+            }
+        }
+
+        //returns nullptr only when the provider runs out of memory or k_max_regions is reached
+        void* allocate_aligned(size_type_t allocation_size, size_type_t alignment) {
+            if (m_current_region != k_max_regions) {
+                if (void* result = try_allocate_in(m_regions[m_current_region], allocation_size, alignment)) {
+                    return result;
+                }
+            }
+            //newer regions are larger, and usually at higher addresses
+            for (uint32_t region_index = m_region_count; region_index-- > 0;) {
+                if (region_index == m_current_region) {
+                    continue;
+                }
+                if (void* result = try_allocate_in(m_regions[region_index], allocation_size, alignment)) {
+                    m_current_region = region_index;
+                    return result;
+                }
+            }
+            return grow_and_allocate(allocation_size, alignment);
+        }
+
+        void* allocate(size_type_t allocation_size) {
+            return allocate_aligned(allocation_size, 1);
+        }
+
+        void deallocate(void* memory, size_type_t allocation_size) {
+            uint32_t region_index = region_index_of(memory);
+            auto& region = m_regions[region_index];
+            region.allocator()->deallocate(memory, allocation_size);
+            --region.m_live_allocations;
+
+            if constexpr (k_release_empty_regions) {
+                if (region.m_live_allocations == 0) {
+                    remove_region(region_index);
+                }
+            }
+        }
+
+        void deallocate_aligned(void* memory, size_type_t allocation_size, size_type_t alignment) {
+            assert((reinterpret_cast<uintptr_t>(memory) & (alignment - 1)) == 0);
+            (void)alignment;
+            deallocate(memory, allocation_size);
+        }
+
+        //the region holding memory, which must have come from this heap
+        backing_allocator_t& region_allocator_of(void* memory) {
+            return *m_regions[region_index_of(memory)].allocator();
+        }
+
+        uint32_t region_count() const {
+            return m_region_count;
+        }
+
+        const region_t& region(uint32_t region_index) const {
+            return m_regions[region_index];
+        }
+    };
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+#include "minialloc.hpp"
+
+/*
+    adapters that put standard containers on top of allocator_template_t<Traits>::allocator_t, of either layout.
+    neither adds locking, a single allocator must not be used from several threads at once.
+
+    allocator_memory_resource_t is a std::pmr::memory_resource, so pmr containers can use it directly. every call
+    carries its alignment, over aligned types get memory aligned for them.
+
+    allocator_adapter_t<T, Traits> is a typed allocator for the non pmr containers, it only holds a pointer to
+    the shared allocator so copies and rebinds are cheap and compare equal.
+
+    both throw std::bad_alloc when the allocator cannot satisfy a request, as the standard requires. zero byte
+    requests are served as one byte blocks.
+*/
+template<typename Traits>
+struct allocator_memory_resource_t : std::pmr::memory_resource {
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+private:
+    backing_allocator_t* m_allocator;
+
+public:
+    explicit allocator_memory_resource_t(backing_allocator_t& allocator) noexcept :
+        m_allocator(&allocator) {
+    }
+
+    backing_allocator_t& backing_allocator() const noexcept {
+        return *m_allocator;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (bytes > (std::numeric_limits<size_type_t>::max)() || alignment > (std::numeric_limits<size_type_t>::max)()) {
+            throw std::bad_alloc{};
+        }
+        void* memory = m_allocator->try_allocate_aligned(static_cast<size_type_t>(bytes == 0 ? 1 : bytes), static_cast<size_type_t>(alignment));
+        if (memory == nullptr) {
+            throw std::bad_alloc{};
+        }
+        return memory;
+    }
+
+    void do_deallocate(void* memory, size_t bytes, size_t alignment) override {
+        m_allocator->deallocate_aligned(memory, static_cast<size_type_t>(bytes == 0 ? 1 : bytes), static_cast<size_type_t>(alignment));
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        auto other_resource = dynamic_cast<const allocator_memory_resource_t*>(&other);
+        return other_resource != nullptr && other_resource->m_allocator == m_allocator;
+    }
+};
+
+template<typename T, typename Traits>
+struct allocator_adapter_t {
+    using value_type = T;
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    backing_allocator_t* m_allocator;
+
+    explicit allocator_adapter_t(backing_allocator_t& allocator) noexcept :
+        m_allocator(&allocator) {
+    }
+
+    template<typename U>
+    allocator_adapter_t(const allocator_adapter_t<U, Traits>& other) noexcept :
+        m_allocator(other.m_allocator) {
+    }
+
+    T* allocate(size_t count) {
+        if (count > (std::numeric_limits<size_type_t>::max)() / sizeof(T)) {
+            throw std::bad_array_new_length{};
+        }
+        size_t bytes = count == 0 ? 1 : count * sizeof(T);
+        void* memory = m_allocator->try_allocate_aligned(static_cast<size_type_t>(bytes), static_cast<size_type_t>(alignof(T)));
+        if (memory == nullptr) {
+            throw std::bad_alloc{};
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, size_t count) noexcept {
+        size_t bytes = count == 0 ? 1 : count * sizeof(T);
+        m_allocator->deallocate_aligned(memory, static_cast<size_type_t>(bytes), static_cast<size_type_t>(alignof(T)));
+    }
+
+    template<typename U>
+    bool operator==(const allocator_adapter_t<U, Traits>& other) const noexcept {
+        return m_allocator == other.m_allocator;
+    }
+
+    template<typename U>
+    bool operator!=(const allocator_adapter_t<U, Traits>& other) const noexcept {
+        return m_allocator != other.m_allocator;
+    }
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#if __has_include(<numaif.h>)
+//only for the MPOL_ constants, the calls go through syscall() so nothing has to link libnuma
+#include <numaif.h>
+#define MINIALLOC_NUMA_BINDING 1
+#endif
+#endif
+#endif
+
+#include "minialloc.hpp"
+
+//most shards one sharded allocator can have, nodes times shards per node
+MINIALLOC_OPTIONAL_TRAIT(k_max_numa_shards, uint32_t, 64)
+
+/*
+    one allocator_t per NUMA node, or per group of cores on a node, each on memory that is bound to its node.
+    allocate() serves the calling thread from the shard of the node (and core group) it runs on and only falls
+    back to the other shards, nearest index first, when that one is full.
+
+    all shards are slices of one reservation, shard_size bytes each with shard_size a power of two, so the
+    owner of a block is found from its address with a subtraction and a shift. a block freed by a thread of
+    another shard is pushed onto the owners lock free queue, the owner frees the whole queue under one lock
+    acquisition the next time it allocates or frees itself, or when collect_remote_frees() is called.
+
+    the nodes are the ones the process may allocate memory on, so numactl --membind narrows them. on a
+    machine with one node, shards_per_node splits the cores into groups instead:
+
+        numactl --physcpubind=0-7 --membind=0 program     with shards_per_node = 4
+
+    routes cores 0 and 4 to the first shard, 1 and 5 to the second and so on. windows binds the shards with
+    VirtualAllocExNuma, other systems get no binding and route threads round robin.
+
+    every shard keeps its allocator_t object in its first bytes, so the metadata is local to the node as well.
+    freed blocks are linked through their own memory while they wait in a queue, requests are rounded up to
+    the size of that link
+*/
+template<typename Traits>
+struct numa_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static constexpr uint32_t k_max_shards = optional_k_max_numa_shards_t<Traits>::value;
+    //node ids have to be below this, it is the width of the node mask given to mbind
+    static constexpr uint32_t k_max_nodes = 64;
+    static constexpr size_t k_shard_header_size = (sizeof(backing_allocator_t) + 63) & ~static_cast<size_t>(63);
+
+    struct remote_free_t {
+        remote_free_t* m_next;
+        size_type_t m_allocation_size;
+    };
+
+    static_assert(allocator_template_t<Traits>::k_imposed_alignment >= alignof(remote_free_t), "remote frees are linked through the freed blocks");
+
+    struct shard_statistics_t {
+        //blocks this shard handed out, and those of them that went to threads of a shard that was full
+        uint64_t m_allocations;
+        uint64_t m_fallback_allocations;
+        uint64_t m_local_frees;
+        //frees of this shards blocks by threads of other shards, and the number of times its queue was drained
+        uint64_t m_remote_frees;
+        uint64_t m_remote_batches;
+    };
+
+    struct allocator_t {
+    private:
+        struct alignas(64) shard_t {
+            std::mutex m_lock;
+            backing_allocator_t* m_allocator;
+            uint32_t m_node;
+            //false where the system refused the binding (mbind needs CAP_SYS_NICE in some containers)
+            bool m_bound;
+            //pushed by other shards without the lock, taken all at once by this one
+            std::atomic<remote_free_t*> m_remote_frees;
+            std::atomic<uint64_t> m_remote_free_count;
+            //only touched with m_lock held
+            uint64_t m_allocations;
+            uint64_t m_fallback_allocations;
+            uint64_t m_local_frees;
+            uint64_t m_remote_batches;
+        };
+
+        uint8_t* m_memory;
+        size_t m_shard_size;
+        uint32_t m_shard_shift;
+        uint32_t m_shard_count;
+        uint32_t m_shards_per_node;
+        //first shard of every node id, k_max_shards for nodes without shards
+        uint32_t m_node_first_shard[k_max_nodes];
+        shard_t m_shards[k_max_shards];
+        //next shard handed to a thread where the cpu is not known, see local_shard
+        std::atomic<uint32_t> m_next_round_robin_shard;
+
+        static size_type_t block_size_for(size_type_t allocation_size) {
+            return allocation_size < sizeof(remote_free_t) ? static_cast<size_type_t>(sizeof(remote_free_t)) : allocation_size;
+        }
+
+        //ids of the nodes this process may allocate on, in ascending order, returns how many
+        static uint32_t allowed_nodes(uint32_t* nodes) {
+            uint32_t node_count = 0;
+#if defined(_WIN32)
+            ULONG highest_node = 0;
+            GetNumaHighestNodeNumber(&highest_node);
+            for (ULONG node = 0; node <= highest_node && node < k_max_nodes; ++node) {
+                nodes[node_count++] = static_cast<uint32_t>(node);
+            }
+#elif defined(MINIALLOC_NUMA_BINDING)
+            unsigned long node_mask[1024 / (8 * sizeof(unsigned long))] = {};
+            int mode = 0;
+            if (syscall(SYS_get_mempolicy, &mode, node_mask, sizeof(node_mask) * 8, nullptr, MPOL_F_MEMS_ALLOWED) == 0) {
+                for (uint32_t node = 0; node < k_max_nodes; ++node) {
+                    if ((node_mask[node / (8 * sizeof(unsigned long))] >> (node % (8 * sizeof(unsigned long)))) & 1) {
+                        nodes[node_count++] = node;
+                    }
+                }
+            }
+#endif
+            if (node_count == 0) {
+                nodes[node_count++] = 0;
+            }
+            return node_count;
+        }
+
+        //reserves the address space of every shard, nullptr on failure
+        static uint8_t* reserve_memory(size_t size) {
+#if defined(_WIN32)
+            return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+#else
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            return memory == MAP_FAILED ? nullptr : static_cast<uint8_t*>(memory);
+#endif
+        }
+
+        //has to happen before the first touch of the memory, pages are placed when they fault in. the memory is
+        //usable either way, the result says whether it is bound
+        static bool bind_memory(uint8_t* memory, size_t size, uint32_t node) {
+#if defined(_WIN32)
+            if (VirtualAllocExNuma(GetCurrentProcess(), memory, size, MEM_COMMIT, PAGE_READWRITE, node) != nullptr) {
+                return true;
+            }
+            VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE);
+            return false;
+#elif defined(MINIALLOC_NUMA_BINDING)
+            unsigned long node_mask[k_max_nodes / (8 * sizeof(unsigned long))] = {};
+            node_mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+            //the kernel reads maxnode - 1 bits
+            return syscall(SYS_mbind, memory, size, MPOL_BIND, node_mask, static_cast<unsigned long>(k_max_nodes) + 1, 0) == 0;
+#else
+            (void)memory;
+            (void)size;
+            (void)node;
+            return false;
+#endif
+        }
+
+        shard_t& lock_and_drain(uint32_t shard_index, std::unique_lock<std::mutex>& lock) {
+            auto& shard = m_shards[shard_index];
+            lock = std::unique_lock<std::mutex>{ shard.m_lock };
+            drain_remote_frees_locked(shard);
+            return shard;
+        }
+
+        //frees everything other shards queued, m_lock must be held
+        static void drain_remote_frees_locked(shard_t& shard) {
+            auto entry = shard.m_remote_frees.exchange(nullptr, std::memory_order_acquire);
+            if (entry == nullptr) {
+                return;
+            }
+            ++shard.m_remote_batches;
+            while (entry != nullptr) {
+                auto next = entry->m_next;
+                shard.m_allocator->deallocate(entry, entry->m_allocation_size);
+                entry = next;
+            }
+        }
+
+    public:
+        /*
+            shard_size is the bytes of every shard including its allocator_t object, a power of two and a
+            multiple of the page size. max_allocations applies to every shard. valid() is false if the memory
+            could not be reserved. a shard whose memory could not be bound still works, see shard_bound
+        */
+        allocator_t(size_t shard_size, size_type_t max_allocations, uint32_t shards_per_node = 1) :
+            m_memory(nullptr),
+            m_shard_size(shard_size),
+            m_shard_shift(minialloc_log2(static_cast<uint64_t>(shard_size))),
+            m_shard_count(0),
+            m_shards_per_node(shards_per_node),
+            m_node_first_shard(),
+            m_shards(),
+            m_next_round_robin_shard(0) {
+
+            assert((shard_size & (shard_size - 1)) == 0 && shard_size > k_shard_header_size);
+            assert(shards_per_node != 0);
+
+            uint32_t nodes[k_max_nodes];
+            uint32_t node_count = allowed_nodes(nodes);
+            for (auto& first_shard : m_node_first_shard) {
+                first_shard = k_max_shards;
+            }
+            for (uint32_t node_index = 0; node_index < node_count && m_shard_count + shards_per_node <= k_max_shards; ++node_index) {
+                m_node_first_shard[nodes[node_index]] = m_shard_count;
+                for (uint32_t group = 0; group < shards_per_node; ++group) {
+                    m_shards[m_shard_count++].m_node = nodes[node_index];
+                }
+            }
+            assert(m_shard_count != 0);
+
+            m_memory = reserve_memory(m_shard_size * m_shard_count);
+            if (m_memory == nullptr) {
+                m_shard_count = 0;
+                return;
+            }
+            for (uint32_t shard_index = 0; shard_index < m_shard_count; ++shard_index) {
+                auto& shard = m_shards[shard_index];
+                uint8_t* shard_memory = m_memory + shard_index * m_shard_size;
+                shard.m_bound = bind_memory(shard_memory, m_shard_size, shard.m_node);
+                shard.m_allocator = new (shard_memory) backing_allocator_t(shard_memory + k_shard_header_size,
+                    static_cast<size_type_t>(m_shard_size - k_shard_header_size), max_allocations);
+            }
+        }
+
+        ~allocator_t() {
+            release();
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        bool valid() const {
+            return m_memory != nullptr;
+        }
+
+        uint32_t shard_count() const {
+            return m_shard_count;
+        }
+
+        //the NUMA node the memory of a shard is bound to
+        uint32_t shard_node(uint32_t shard_index) const {
+            return m_shards[shard_index].m_node;
+        }
+
+        bool shard_bound(uint32_t shard_index) const {
+            return m_shards[shard_index].m_bound;
+        }
+
+        //the shard whose memory holds the block, O(1)
+        uint32_t shard_of(const void* memory) const {
+            auto offset = static_cast<size_t>(static_cast<const uint8_t*>(memory) - m_memory);
+            assert(offset < m_shard_size * m_shard_count);
+            return static_cast<uint32_t>(offset >> m_shard_shift);
+        }
+
+        //the shard of the node and core group the calling thread runs on right now
+        uint32_t local_shard() {
+            uint32_t first_shard = k_max_shards;
+            uint32_t cpu = 0;
+#if defined(_WIN32)
+            PROCESSOR_NUMBER processor;
+            GetCurrentProcessorNumberEx(&processor);
+            USHORT node = 0;
+            if (GetNumaProcessorNodeEx(&processor, &node) && node < k_max_nodes) {
+                first_shard = m_node_first_shard[node];
+            }
+            cpu = processor.Group * 64u + processor.Number;
+#elif defined(__linux__)
+            unsigned int current_cpu = 0, node = 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+            int status = getcpu(&current_cpu, &node);
+#else
+            int status = static_cast<int>(syscall(SYS_getcpu, &current_cpu, &node, nullptr));
+#endif
+            if (status == 0 && node < k_max_nodes) {
+                first_shard = m_node_first_shard[node];
+                cpu = current_cpu;
+            }
+#endif
+            if (first_shard == k_max_shards) {
+                //unknown cpu or a node without shards, every thread keeps the shard it was given first
+                thread_local uint32_t round_robin_shard = m_next_round_robin_shard.fetch_add(1, std::memory_order_relaxed);
+                return round_robin_shard % m_shard_count;
+            }
+            return first_shard + cpu % m_shards_per_node;
+        }
+
+        //like allocate, but running out of memory in every shard is not an error
+        void* try_allocate(size_type_t allocation_size) {
+            uint32_t local = local_shard();
+            allocation_size = block_size_for(allocation_size);
+            for (uint32_t attempt = 0; attempt < m_shard_count; ++attempt) {
+                uint32_t shard_index = local + attempt < m_shard_count ? local + attempt : local + attempt - m_shard_count;
+                std::unique_lock<std::mutex> lock{};
+                auto& shard = lock_and_drain(shard_index, lock);
+                void* result = shard.m_allocator->try_allocate(allocation_size);
+                if (result != nullptr) {
+                    ++shard.m_allocations;
+                    shard.m_fallback_allocations += attempt != 0;
+                    return result;
+                }
+            }
+            return nullptr;
+        }
+
+        void* allocate(size_type_t allocation_size) {
+            void* result = try_allocate(allocation_size);
+            assert(result != nullptr);
+            return result;
+        }
+
+        //from one shard only, whichever thread calls it
+        void* try_allocate_on(uint32_t shard_index, size_type_t allocation_size) {
+            std::unique_lock<std::mutex> lock{};
+            auto& shard = lock_and_drain(shard_index, lock);
+            void* result = shard.m_allocator->try_allocate(block_size_for(allocation_size));
+            shard.m_allocations += result != nullptr;
+            return result;
+        }
+
+        //a block of another shard is queued for its owner instead of taking that shards lock
+        void deallocate(void* memory, size_type_t allocation_size) {
+            uint32_t owner = shard_of(memory);
+            auto& shard = m_shards[owner];
+            if (owner != local_shard()) {
+                auto entry = static_cast<remote_free_t*>(memory);
+                entry->m_allocation_size = block_size_for(allocation_size);
+                auto head = shard.m_remote_frees.load(std::memory_order_relaxed);
+                do {
+                    entry->m_next = head;
+                } while (!shard.m_remote_frees.compare_exchange_weak(head, entry, std::memory_order_release, std::memory_order_relaxed));
+                shard.m_remote_free_count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::unique_lock<std::mutex> lock{};
+            lock_and_drain(owner, lock);
+            shard.m_allocator->deallocate(memory, block_size_for(allocation_size));
+            ++shard.m_local_frees;
+        }
+
+        //frees every queued block of every shard, for shards whose threads stopped allocating
+        void collect_remote_frees() {
+            for (uint32_t shard_index = 0; shard_index < m_shard_count; ++shard_index) {
+                std::unique_lock<std::mutex> lock{};
+                lock_and_drain(shard_index, lock);
+            }
+        }
+
+        shard_statistics_t shard_statistics(uint32_t shard_index) {
+            auto& shard = m_shards[shard_index];
+            std::lock_guard<std::mutex> guard{ shard.m_lock };
+            return shard_statistics_t{ shard.m_allocations, shard.m_fallback_allocations, shard.m_local_frees,
+                shard.m_remote_free_count.load(std::memory_order_relaxed), shard.m_remote_batches };
+        }
+
+        //no thread may use the shard while the result is in use
+        backing_allocator_t& backing_allocator(uint32_t shard_index) {
+            return *m_shards[shard_index].m_allocator;
+        }
+
+    private:
+        void release() {
+            if (m_memory == nullptr) {
+                return;
+            }
+            for (uint32_t shard_index = 0; shard_index < m_shard_count; ++shard_index) {
+                if (m_shards[shard_index].m_allocator != nullptr) {
+                    m_shards[shard_index].m_allocator->~backing_allocator_t();
+                    m_shards[shard_index].m_allocator = nullptr;
+                }
+            }
+#if defined(_WIN32)
+            VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+            munmap(m_memory, m_shard_size * m_shard_count);
+#endif
+            m_memory = nullptr;
+            m_shard_count = 0;
+        }
+    };
+};
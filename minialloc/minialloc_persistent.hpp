@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "minialloc.hpp"
+
+enum class persistent_attach_result_t {
+    attached,
+    //open_or_create found no heap and formatted a new one
+    created,
+    //the region is smaller than the header or not 64 byte aligned
+    bad_region,
+    //the region does not start with a heap header
+    bad_magic,
+    //written by an incompatible version of this header
+    version_mismatch,
+    //written with traits that lay the heap out differently
+    layout_mismatch,
+    //the header records a different region size
+    size_mismatch,
+    //the previous user never detached, the heap may have been left in the middle of an operation
+    not_closed_cleanly
+};
+
+/*
+    heaps that live entirely inside their region, so a region kept in a file can be mapped again later (at any
+    address) and used as is. the region starts with a header holding a magic value, a version, a signature of the
+    traits that affect the layout and the allocator object itself, followed by the memory the allocator manages.
+
+    create formats a region, attach validates the header of an existing one and only refreshes the memory pointer
+    of the allocator (rebase() also drops a recorder or sampler the previous user set), nothing is rebuilt.
+    detach marks the heap as closed cleanly, a heap that was never detached is refused by attach since a crash
+    may have left it half updated.
+
+    the heap can hold one root pointer, stored as a displacement, to find the data again after attaching.
+    requires relative displacements
+*/
+template<typename Traits>
+struct persistent_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static_assert(!Traits::k_use_absolute_pointers, "persistent heaps require relative displacements");
+
+    //"minialoc" in little endian
+    static constexpr uint64_t k_magic = 0x636F6C61696E696Dull;
+    static constexpr uint32_t k_version = 1;
+
+    struct region_header_t {
+        uint64_t m_magic;
+        uint32_t m_version;
+        //1 from create or attach until detach
+        uint32_t m_open;
+        uint64_t m_layout_signature;
+        uint64_t m_region_size;
+        //displacement of the root object from the region, 0 when there is none
+        uint64_t m_root;
+        alignas(backing_allocator_t) uint8_t m_allocator_storage[sizeof(backing_allocator_t)];
+    };
+
+    //the managed memory starts on the next cache line
+    static constexpr size_t k_header_footprint = (sizeof(region_header_t) + 63) & ~static_cast<size_t>(63);
+
+    //fnv-1a over everything that changes the meaning of the bytes in the region
+    static constexpr uint64_t layout_signature() {
+        using template_t = allocator_template_t<Traits>;
+        const uint64_t layout_values[] = {
+            sizeof(backing_allocator_t),
+            sizeof(typename template_t::allocation_node_t),
+            sizeof(size_type_t),
+            sizeof(typename Traits::displacement_type_t),
+            template_t::k_imposed_alignment,
+            static_cast<uint64_t>(template_t::k_layout),
+            static_cast<uint64_t>(template_t::k_search_policy),
+            template_t::k_use_address_tree,
+            template_t::k_track_allocation_sizes,
+            template_t::k_collect_statistics,
+            sizeof(typename template_t::node_field_type_t),
+            template_t::k_scale_node_fields
+        };
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (uint64_t value : layout_values) {
+            for (uint32_t byte_index = 0; byte_index < 8; ++byte_index) {
+                hash ^= (value >> (byte_index * 8)) & 0xFF;
+                hash *= 0x100000001B3ull;
+            }
+        }
+        return hash;
+    }
+
+    static region_header_t* header_of(uint8_t* region) {
+        return reinterpret_cast<region_header_t*>(region);
+    }
+
+    static backing_allocator_t* allocator_of(uint8_t* region) {
+        return std::launder(reinterpret_cast<backing_allocator_t*>(header_of(region)->m_allocator_storage));
+    }
+
+    //formats the region as an empty heap, whatever it held before is lost
+    static backing_allocator_t* create(uint8_t* region, size_type_t region_size, size_type_t max_allocations) {
+        assert((reinterpret_cast<uintptr_t>(region) & 63) == 0);
+        assert(region_size > k_header_footprint);
+
+        auto header = new (region) region_header_t{};
+        header->m_magic = k_magic;
+        header->m_version = k_version;
+        header->m_open = 1;
+        header->m_layout_signature = layout_signature();
+        header->m_region_size = region_size;
+        header->m_root = 0;
+
+        return new (header->m_allocator_storage) backing_allocator_t(region + k_header_footprint,
+            static_cast<size_type_t>(region_size - k_header_footprint), max_allocations);
+    }
+
+    //on success allocator points into the region, on failure the region is left untouched
+    static persistent_attach_result_t attach(uint8_t* region, size_type_t region_size, backing_allocator_t*& allocator) {
+        allocator = nullptr;
+        if ((reinterpret_cast<uintptr_t>(region) & 63) != 0 || region_size <= k_header_footprint) {
+            return persistent_attach_result_t::bad_region;
+        }
+
+        auto header = header_of(region);
+        if (header->m_magic != k_magic) {
+            return persistent_attach_result_t::bad_magic;
+        }
+        if (header->m_version != k_version) {
+            return persistent_attach_result_t::version_mismatch;
+        }
+        if (header->m_layout_signature != layout_signature()) {
+            return persistent_attach_result_t::layout_mismatch;
+        }
+        if (header->m_region_size != region_size) {
+            return persistent_attach_result_t::size_mismatch;
+        }
+        if (header->m_open != 0) {
+            return persistent_attach_result_t::not_closed_cleanly;
+        }
+
+        header->m_open = 1;
+        allocator = allocator_of(region);
+        allocator->rebase(region + k_header_footprint);
+        allocator->validate_freelist();
+        return persistent_attach_result_t::attached;
+    }
+
+    //the allocator must not be used after this, until the region is attached again
+    static void detach(uint8_t* region) {
+        assert(header_of(region)->m_open == 1);
+        header_of(region)->m_open = 0;
+    }
+
+    //root must point into the region, or be nullptr
+    static void set_root(uint8_t* region, void* root) {
+        header_of(region)->m_root = root == nullptr ? 0 : static_cast<uint64_t>(static_cast<uint8_t*>(root) - region);
+    }
+
+    static void* root(uint8_t* region) {
+        auto root_displacement = header_of(region)->m_root;
+        return root_displacement == 0 ? nullptr : region + root_displacement;
+    }
+
+    /*
+        maps a file read/write and shared, so stores reach the file. a missing or empty file is created with
+        the requested size, an existing one is mapped with its own size
+    */
+    struct mapped_file_t {
+        uint8_t* m_memory = nullptr;
+        size_t m_size = 0;
+        //true if open found no data and created or extended the file
+        bool m_created = false;
+#if defined(_WIN32)
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#else
+        int m_file = -1;
+#endif
+
+        mapped_file_t() = default;
+        mapped_file_t(const mapped_file_t&) = delete;
+        mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+        ~mapped_file_t() {
+            close();
+        }
+
+        bool open(const char* path, size_t size) {
+            assert(m_memory == nullptr);
+#if defined(_WIN32)
+            m_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(m_file, &file_size)) {
+                close();
+                return false;
+            }
+            m_created = file_size.QuadPart == 0;
+            m_size = m_created ? size : static_cast<size_t>(file_size.QuadPart);
+
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(m_size) >> 32), static_cast<DWORD>(m_size), nullptr);
+            if (m_mapping == nullptr) {
+                close();
+                return false;
+            }
+            m_memory = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_size));
+#else
+            m_file = ::open(path, O_RDWR | O_CREAT, 0644);
+            if (m_file < 0) {
+                return false;
+            }
+            struct stat file_status;
+            if (fstat(m_file, &file_status) != 0) {
+                close();
+                return false;
+            }
+            m_created = file_status.st_size == 0;
+            m_size = m_created ? size : static_cast<size_t>(file_status.st_size);
+            if (m_created && ftruncate(m_file, static_cast<off_t>(m_size)) != 0) {
+                close();
+                return false;
+            }
+
+            void* memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+            m_memory = memory == MAP_FAILED ? nullptr : static_cast<uint8_t*>(memory);
+#endif
+            if (m_memory == nullptr) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        //writes dirty pages back to the file
+        void flush() {
+#if defined(_WIN32)
+            FlushViewOfFile(m_memory, m_size);
+            FlushFileBuffers(m_file);
+#else
+            msync(m_memory, m_size, MS_SYNC);
+#endif
+        }
+
+        void close() {
+#if defined(_WIN32)
+            if (m_memory != nullptr) {
+                UnmapViewOfFile(m_memory);
+            }
+            if (m_mapping != nullptr) {
+                CloseHandle(m_mapping);
+            }
+            if (m_file != INVALID_HANDLE_VALUE) {
+                CloseHandle(m_file);
+            }
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_memory != nullptr) {
+                munmap(m_memory, m_size);
+            }
+            if (m_file >= 0) {
+                ::close(m_file);
+            }
+            m_file = -1;
+#endif
+            m_memory = nullptr;
+            m_size = 0;
+        }
+    };
+
+    //attaches to the heap in a freshly opened file, or formats the file if it was just created
+    static persistent_attach_result_t open_or_create(mapped_file_t& file, size_type_t max_allocations, backing_allocator_t*& allocator) {
+        if (file.m_created) {
+            allocator = create(file.m_memory, static_cast<size_type_t>(file.m_size), max_allocations);
+            return persistent_attach_result_t::created;
+        }
+        return attach(file.m_memory, static_cast<size_type_t>(file.m_size), allocator);
+    }
+
+    //detaches and writes the heap back, the file stays open
+    static void close(mapped_file_t& file) {
+        detach(file.m_memory);
+        file.flush();
+    }
+};
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define MINIALLOC_PROFILER_BACKTRACE 1
+#endif
+
+#include "minialloc.hpp"
+
+/*
+    a sampling heap profiler, give it to allocator_t::set_sampler of an allocator with k_sample_allocations.
+
+    the gaps between samples are drawn from an exponential distribution with the sample interval as mean, so
+    every allocated byte has the same chance to be the one a sample lands on and a block of size s is sampled
+    with probability 1 - exp(-s / interval), no matter how the allocations before it were sized. an interval of
+    0 samples every allocation. a sampled block is attributed to a callsite, the call stack of the allocating
+    thread or the tag it set with set_thread_tag(), and stays in the live set until it is freed.
+
+    dump() writes the legacy text heap profile that pprof and the gperftools tools read:
+
+        heap profile:   <live count>: <live bytes> [<allocated count>: <allocated bytes>] @ heap_v2/<interval>
+              <live count>: <live bytes> [<allocated count>: <allocated bytes>] @ 0x<frame> 0x<frame> ...
+        ...
+        MAPPED_LIBRARIES:
+        <the contents of /proc/self/maps>
+
+    the counts are those of the samples, pprof scales them back up from the heap_v2 interval (-inuse_space for
+    the live heap, -alloc_space for everything allocated since the profiler was attached). tags get a made up
+    address each, listed in "# 0x<address> <tag>" comment lines. captured stacks start inside the allocator,
+    pprof -drop_frame or -focus hide those frames
+*/
+struct heap_profiler_t final : allocation_sampler_t {
+    enum class capture_mode_t : uint8_t {
+        stack,
+        tag
+    };
+
+    struct callsite_statistics_t {
+        uint64_t m_live_count;
+        uint64_t m_live_bytes;
+        uint64_t m_allocated_count;
+        uint64_t m_allocated_bytes;
+    };
+
+    //sets the tag of the calling thread for tag_scope_t and capture_mode_t::tag, the string has to outlive the profile
+    static void set_thread_tag(const char* tag) {
+        thread_tag() = tag;
+    }
+
+    static const char* current_thread_tag() {
+        return thread_tag();
+    }
+
+    //tags the allocations of the calling thread until it goes out of scope
+    struct tag_scope_t {
+        const char* m_previous_tag;
+
+        explicit tag_scope_t(const char* tag) :
+            m_previous_tag(current_thread_tag()) {
+            set_thread_tag(tag);
+        }
+
+        tag_scope_t(const tag_scope_t&) = delete;
+        tag_scope_t& operator=(const tag_scope_t&) = delete;
+
+        ~tag_scope_t() {
+            set_thread_tag(m_previous_tag);
+        }
+    };
+
+private:
+    static constexpr uint32_t k_max_frames = 32;
+    //where the made up addresses of tags start, far from anything a symbolizer would find
+    static constexpr uint64_t k_tag_address_base = 0x7a6000000000ull;
+
+    struct callsite_t {
+        std::vector<uint64_t> m_frames;
+        std::string m_tag;
+        callsite_statistics_t m_statistics;
+    };
+
+    struct live_sample_t {
+        uint32_t m_callsite;
+        size_t m_size;
+    };
+
+    size_t m_sample_interval;
+    capture_mode_t m_capture_mode;
+    uint64_t m_random_state;
+    FILE* m_failure_file;
+    std::vector<callsite_t> m_callsites;
+    //frames (or the tag) as bytes to index into m_callsites
+    std::unordered_map<std::string, uint32_t> m_callsite_index;
+    std::unordered_map<void*, live_sample_t> m_live_samples;
+    uint64_t m_live_bytes;
+
+    static const char*& thread_tag() {
+        thread_local const char* tag = nullptr;
+        return tag;
+    }
+
+    //xorshift64*, a uniform double in (0, 1]
+    double next_uniform() {
+        m_random_state ^= m_random_state >> 12;
+        m_random_state ^= m_random_state << 25;
+        m_random_state ^= m_random_state >> 27;
+        uint64_t bits = (m_random_state * 0x2545F4914F6CDD1Dull) >> 11;
+        return (static_cast<double>(bits) + 1.0) * (1.0 / 9007199254740992.0);
+    }
+
+    uint32_t capture_stack(void** frames) {
+#if defined(_WIN32)
+        return CaptureStackBackTrace(0, k_max_frames, frames, nullptr);
+#elif defined(MINIALLOC_PROFILER_BACKTRACE)
+        int frame_count = backtrace(frames, static_cast<int>(k_max_frames));
+        return frame_count > 0 ? static_cast<uint32_t>(frame_count) : 0;
+#elif defined(__GNUC__)
+        frames[0] = __builtin_return_address(0);
+        return 1;
+#else
+        (void)frames;
+        return 0;
+#endif
+    }
+
+    uint32_t find_callsite() {
+        const char* tag = nullptr;
+        void* frames[k_max_frames];
+        uint32_t frame_count = 0;
+        std::string key{};
+        if (m_capture_mode == capture_mode_t::tag) {
+            tag = current_thread_tag() != nullptr ? current_thread_tag() : "(untagged)";
+            key.assign(tag);
+        }
+        else {
+            frame_count = capture_stack(frames);
+            key.assign(reinterpret_cast<const char*>(frames), frame_count * sizeof(void*));
+        }
+
+        auto found = m_callsite_index.find(key);
+        if (found != m_callsite_index.end()) {
+            return found->second;
+        }
+
+        uint32_t index = static_cast<uint32_t>(m_callsites.size());
+        callsite_t callsite{ {}, {}, {} };
+        if (tag != nullptr) {
+            callsite.m_tag.assign(tag);
+            callsite.m_frames.push_back(k_tag_address_base + 0x1000ull * index);
+        }
+        else {
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                callsite.m_frames.push_back(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(frames[frame])));
+            }
+            if (callsite.m_frames.empty()) {
+                callsite.m_frames.push_back(0);
+            }
+        }
+        m_callsites.push_back(std::move(callsite));
+        m_callsite_index.emplace(std::move(key), index);
+        return index;
+    }
+
+    void forget_sample(std::unordered_map<void*, live_sample_t>::iterator live_sample) {
+        auto& statistics = m_callsites[live_sample->second.m_callsite].m_statistics;
+        --statistics.m_live_count;
+        statistics.m_live_bytes -= live_sample->second.m_size;
+        m_live_bytes -= live_sample->second.m_size;
+        filter_remove(live_sample->first);
+    }
+
+public:
+    explicit heap_profiler_t(size_t sample_interval = 512 * 1024, capture_mode_t capture_mode = capture_mode_t::stack, uint64_t seed = 0x9E3779B97F4A7C15ull) :
+        m_sample_interval(sample_interval),
+        m_capture_mode(capture_mode),
+        m_random_state(seed != 0 ? seed : 1),
+        m_failure_file(nullptr),
+        m_callsites(),
+        m_callsite_index(),
+        m_live_samples(),
+        m_live_bytes(0) {
+    }
+
+    heap_profiler_t(const heap_profiler_t&) = delete;
+    heap_profiler_t& operator=(const heap_profiler_t&) = delete;
+
+    //where a failing allocate() dumps the profile before its assert, nullptr (the default) for nowhere
+    void set_failure_file(FILE* file) {
+        m_failure_file = file;
+    }
+
+    size_t next_sample_interval() override {
+        if (m_sample_interval == 0) {
+            return 0;
+        }
+        double interval = -std::log(next_uniform()) * static_cast<double>(m_sample_interval);
+        return static_cast<size_t>(interval);
+    }
+
+    void sample_allocate(void* memory, size_t allocation_size) override {
+        uint32_t callsite = find_callsite();
+        auto& statistics = m_callsites[callsite].m_statistics;
+        ++statistics.m_live_count;
+        statistics.m_live_bytes += allocation_size;
+        ++statistics.m_allocated_count;
+        statistics.m_allocated_bytes += allocation_size;
+        m_live_bytes += allocation_size;
+        m_live_samples[memory] = live_sample_t{ callsite, allocation_size };
+        filter_add(memory);
+    }
+
+    void sample_deallocate(void* memory) override {
+        //the filter lets some blocks through that were never sampled
+        auto live_sample = m_live_samples.find(memory);
+        if (live_sample != m_live_samples.end()) {
+            forget_sample(live_sample);
+            m_live_samples.erase(live_sample);
+        }
+    }
+
+    void sample_resize(void* memory, size_t new_size) override {
+        auto live_sample = m_live_samples.find(memory);
+        if (live_sample != m_live_samples.end()) {
+            auto& statistics = m_callsites[live_sample->second.m_callsite].m_statistics;
+            statistics.m_live_bytes = statistics.m_live_bytes - live_sample->second.m_size + new_size;
+            m_live_bytes = m_live_bytes - live_sample->second.m_size + new_size;
+            live_sample->second.m_size = new_size;
+        }
+    }
+
+    void sample_reset() override {
+        for (auto& callsite : m_callsites) {
+            callsite.m_statistics.m_live_count = 0;
+            callsite.m_statistics.m_live_bytes = 0;
+        }
+        m_live_samples.clear();
+        m_live_bytes = 0;
+        filter_clear();
+    }
+
+    void sample_release_to(void* frontier) override {
+        for (auto live_sample = m_live_samples.begin(); live_sample != m_live_samples.end();) {
+            if (static_cast<uint8_t*>(live_sample->first) >= static_cast<uint8_t*>(frontier)) {
+                forget_sample(live_sample);
+                live_sample = m_live_samples.erase(live_sample);
+            }
+            else {
+                ++live_sample;
+            }
+        }
+    }
+
+    void sample_move(void* from, void* to) override {
+        auto live_sample = m_live_samples.find(from);
+        if (live_sample != m_live_samples.end()) {
+            live_sample_t moved_sample = live_sample->second;
+            filter_remove(from);
+            m_live_samples.erase(live_sample);
+            m_live_samples[to] = moved_sample;
+            filter_add(to);
+        }
+    }
+
+    void allocation_failed(size_t allocation_size) override {
+        if (m_failure_file != nullptr) {
+            fprintf(m_failure_file, "# allocation of %zu bytes failed, %zu sampled blocks live\n", allocation_size, m_live_samples.size());
+            dump(m_failure_file);
+            fflush(m_failure_file);
+        }
+    }
+
+    size_t sample_interval() const {
+        return m_sample_interval;
+    }
+
+    size_t live_sample_count() const {
+        return m_live_samples.size();
+    }
+
+    //bytes in the live samples, not scaled
+    uint64_t live_sampled_bytes() const {
+        return m_live_bytes;
+    }
+
+    //the live heap as the samples estimate it, every sample counts for 1 / its probability to be sampled
+    double estimated_live_bytes() const {
+        if (m_sample_interval == 0) {
+            return static_cast<double>(m_live_bytes);
+        }
+        double estimate = 0.0;
+        for (const auto& live_sample : m_live_samples) {
+            double size = static_cast<double>(live_sample.second.m_size);
+            estimate += size / -std::expm1(-size / static_cast<double>(m_sample_interval));
+        }
+        return estimate;
+    }
+
+    size_t callsite_count() const {
+        return m_callsites.size();
+    }
+
+    //all zero for a tag nothing was sampled under
+    callsite_statistics_t tag_statistics(const char* tag) const {
+        auto found = m_callsite_index.find(std::string{ tag });
+        if (m_capture_mode != capture_mode_t::tag || found == m_callsite_index.end()) {
+            return callsite_statistics_t{ 0, 0, 0, 0 };
+        }
+        return m_callsites[found->second].m_statistics;
+    }
+
+    void dump(FILE* file) const {
+        callsite_statistics_t totals{ 0, 0, 0, 0 };
+        for (const auto& callsite : m_callsites) {
+            totals.m_live_count += callsite.m_statistics.m_live_count;
+            totals.m_live_bytes += callsite.m_statistics.m_live_bytes;
+            totals.m_allocated_count += callsite.m_statistics.m_allocated_count;
+            totals.m_allocated_bytes += callsite.m_statistics.m_allocated_bytes;
+        }
+        //an interval of 0 is "every byte", which pprof spells as 1
+        fprintf(file, "heap profile: %6llu: %8llu [%6llu: %8llu] @ heap_v2/%zu\n",
+            static_cast<unsigned long long>(totals.m_live_count), static_cast<unsigned long long>(totals.m_live_bytes),
+            static_cast<unsigned long long>(totals.m_allocated_count), static_cast<unsigned long long>(totals.m_allocated_bytes),
+            m_sample_interval != 0 ? m_sample_interval : 1);
+
+        for (const auto& callsite : m_callsites) {
+            const auto& statistics = callsite.m_statistics;
+            fprintf(file, "%6llu: %8llu [%6llu: %8llu] @",
+                static_cast<unsigned long long>(statistics.m_live_count), static_cast<unsigned long long>(statistics.m_live_bytes),
+                static_cast<unsigned long long>(statistics.m_allocated_count), static_cast<unsigned long long>(statistics.m_allocated_bytes));
+            for (uint64_t frame : callsite.m_frames) {
+                fprintf(file, " 0x%llx", static_cast<unsigned long long>(frame));
+            }
+            fprintf(file, "\n");
+        }
+        for (const auto& callsite : m_callsites) {
+            if (!callsite.m_tag.empty()) {
+                fprintf(file, "# 0x%llx %s\n", static_cast<unsigned long long>(callsite.m_frames[0]), callsite.m_tag.c_str());
+            }
+        }
+
+        fprintf(file, "\nMAPPED_LIBRARIES:\n");
+#if defined(__linux__)
+        if (FILE* maps = fopen("/proc/self/maps", "r")) {
+            char buffer[4096];
+            size_t length;
+            while ((length = fread(buffer, 1, sizeof(buffer), maps)) != 0) {
+                fwrite(buffer, 1, length, file);
+            }
+            fclose(maps);
+        }
+#endif
+    }
+};
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "minialloc.hpp"
+
+//only page aligned free interiors of at least this many bytes are handed back to the operating system
+MINIALLOC_OPTIONAL_TRAIT(k_purge_threshold, size_t, 64 * 1024)
+//allocations and frees per decay epoch, 0 leaves the epochs to decay_epoch() calls (from a timer for time based decay)
+MINIALLOC_OPTIONAL_TRAIT(k_purge_decay_operations, uint32_t, 8192)
+//release with MADV_FREE (MEM_RESET on windows), the kernel takes the pages only under memory pressure, instead of MADV_DONTNEED
+MINIALLOC_OPTIONAL_TRAIT(k_purge_lazy_free, bool, false)
+//align requests of k_huge_page_size or more to it and round them up to whole huge pages, with MADV_HUGEPAGE on linux
+MINIALLOC_OPTIONAL_TRAIT(k_huge_page_alignment, bool, false)
+
+/*
+    gives the pages of large free regions back to the operating system, so a heap that grew during a spike
+    does not stay resident afterwards.
+
+    every page of the memory has two bits: dirty (it may be resident) and recent (it was freed during the
+    current epoch). allocations set the dirty bits of their pages, frees set the recent bits. at the end of an
+    epoch the free nodes are walked and the page aligned interiors of the ones with at least k_purge_threshold
+    bytes are released, but only pages that are dirty and were not freed during that epoch, the recent bits of
+    the others are cleared so they go at the end of the next one. a page has to stay free for a whole epoch
+    before it is purged, memory that is reused right away is never released and faulted back in.
+
+    resident_bytes() counts the pages that were not released since they were last allocated. it is an upper
+    bound, pages that were never touched count as resident until they are first purged.
+
+    node pool layout only (free memory is never written by the allocator there), like allocator_t it adds no
+    locking
+*/
+template<typename Traits>
+struct purging_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static_assert(!allocator_template_t<Traits>::k_use_boundary_tags, "purging walks the free nodes with node_pool_allocator_t::first_free_range");
+
+    static constexpr size_t k_purge_threshold = optional_k_purge_threshold_t<Traits>::value;
+    static constexpr uint32_t k_purge_decay_operations = optional_k_purge_decay_operations_t<Traits>::value;
+    static constexpr bool k_purge_lazy_free = optional_k_purge_lazy_free_t<Traits>::value;
+    static constexpr bool k_huge_page_alignment = optional_k_huge_page_alignment_t<Traits>::value;
+    static constexpr size_type_t k_huge_page_size = 2 * 1024 * 1024;
+
+    static size_t system_page_size() {
+#if defined(_WIN32)
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        return system_info.dwPageSize;
+#else
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    struct allocator_t {
+    private:
+        backing_allocator_t m_allocator;
+        uint8_t* m_memory;
+        //page index 0 is the page m_memory lies in
+        uint8_t* m_first_page;
+        size_t m_page_size;
+        uint32_t m_page_shift;
+        size_t m_page_count;
+        //both live in the heap itself, as its lowest block
+        uint64_t* m_dirty_pages;
+        uint64_t* m_recent_pages;
+        size_t m_resident_pages;
+        uint32_t m_operations_since_epoch;
+        uint64_t m_released_bytes_total;
+        uint64_t m_release_calls;
+
+        static bool test_bit(const uint64_t* bitmap, size_t bit) {
+            return (bitmap[bit / 64] & (static_cast<uint64_t>(1) << (bit % 64))) != 0;
+        }
+
+        //sets bits [first, end) and returns how many of them were clear
+        static size_t set_bits(uint64_t* bitmap, size_t first, size_t end) {
+            size_t newly_set = 0;
+            while (first < end) {
+                size_t word_end = (first / 64 + 1) * 64 < end ? (first / 64 + 1) * 64 : end;
+                uint64_t mask = (word_end - first == 64 ? ~static_cast<uint64_t>(0) : ((static_cast<uint64_t>(1) << (word_end - first)) - 1)) << (first % 64);
+                newly_set += minialloc_popcount(~bitmap[first / 64] & mask);
+                bitmap[first / 64] |= mask;
+                first = word_end;
+            }
+            return newly_set;
+        }
+
+        static void clear_bits(uint64_t* bitmap, size_t first, size_t end) {
+            for (size_t bit = first; bit < end; ++bit) {
+                bitmap[bit / 64] &= ~(static_cast<uint64_t>(1) << (bit % 64));
+            }
+        }
+
+        size_t first_page_of(void* memory) const {
+            return static_cast<size_t>(static_cast<uint8_t*>(memory) - m_first_page) >> m_page_shift;
+        }
+
+        size_t end_page_of(void* memory, size_type_t size) const {
+            return (static_cast<size_t>(static_cast<uint8_t*>(memory) + size - m_first_page) + m_page_size - 1) >> m_page_shift;
+        }
+
+        //the bytes the block really covers
+        static size_type_t block_size_of(size_type_t allocation_size) {
+            constexpr size_type_t k_imposed_alignment = allocator_template_t<Traits>::k_imposed_alignment;
+            allocation_size = (allocation_size + k_imposed_alignment - 1) & ~(k_imposed_alignment - 1);
+            if constexpr (k_huge_page_alignment) {
+                if (allocation_size >= k_huge_page_size) {
+                    return (allocation_size + k_huge_page_size - 1) & ~(k_huge_page_size - 1);
+                }
+            }
+            return allocation_size;
+        }
+
+        void release_pages(size_t first, size_t end) {
+            clear_bits(m_dirty_pages, first, end);
+            m_resident_pages -= end - first;
+            void* memory = m_first_page + (first << m_page_shift);
+            size_t size = (end - first) << m_page_shift;
+#if defined(_WIN32)
+            VirtualAlloc(memory, size, MEM_RESET, PAGE_READWRITE);
+#else
+#if defined(MADV_FREE)
+            madvise(memory, size, k_purge_lazy_free ? MADV_FREE : MADV_DONTNEED);
+#else
+            madvise(memory, size, MADV_DONTNEED);
+#endif
+#endif
+            m_released_bytes_total += size;
+            ++m_release_calls;
+        }
+
+        //releases the dirty pages in [first, end) (only the ones not freed this epoch unless include_recent) in runs
+        size_t purge_pages(size_t first, size_t end, bool include_recent) {
+            size_t released_pages = 0;
+            size_t run_begin = 0;
+            bool in_run = false;
+            for (size_t page = first; page < end;) {
+                //whole words of purged pages are skipped
+                if (page % 64 == 0 && end - page >= 64 && m_dirty_pages[page / 64] == 0) {
+                    if (in_run) {
+                        release_pages(run_begin, page);
+                        released_pages += page - run_begin;
+                        in_run = false;
+                    }
+                    m_recent_pages[page / 64] = 0;
+                    page += 64;
+                    continue;
+                }
+
+                bool candidate = test_bit(m_dirty_pages, page) && (include_recent || !test_bit(m_recent_pages, page));
+                m_recent_pages[page / 64] &= ~(static_cast<uint64_t>(1) << (page % 64));
+                if (candidate && !in_run) {
+                    run_begin = page;
+                    in_run = true;
+                }
+                else if (!candidate && in_run) {
+                    release_pages(run_begin, page);
+                    released_pages += page - run_begin;
+                    in_run = false;
+                }
+                ++page;
+            }
+            if (in_run) {
+                release_pages(run_begin, end);
+                released_pages += end - run_begin;
+            }
+            return released_pages << m_page_shift;
+        }
+
+        size_t purge(bool include_recent) {
+            size_t released_bytes = 0;
+            //one pass along the free list, purging changes no node
+            typename backing_allocator_t::free_range_t range;
+            for (bool found = m_allocator.first_free_range(m_memory, range); found; found = m_allocator.next_free_range(range)) {
+                size_t first = first_page_of(range.m_base + m_page_size - 1);
+                size_t end = first_page_of(range.m_base + range.m_size);
+                if (end > first && ((end - first) << m_page_shift) >= k_purge_threshold) {
+                    released_bytes += purge_pages(first, end, include_recent);
+                }
+            }
+            m_operations_since_epoch = 0;
+            return released_bytes;
+        }
+
+        void count_operation() {
+            if constexpr (k_purge_decay_operations != 0) {
+                if (++m_operations_since_epoch >= k_purge_decay_operations) {
+                    decay_epoch();
+                }
+            }
+        }
+
+    public:
+        allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_allocations) :
+            m_allocator(mem, total_memory_size, max_allocations),
+            m_memory(mem),
+            m_first_page(nullptr),
+            m_page_size(system_page_size()),
+            m_page_shift(minialloc_log2(system_page_size())),
+            m_page_count(0),
+            m_dirty_pages(nullptr),
+            m_recent_pages(nullptr),
+            m_resident_pages(0),
+            m_operations_since_epoch(0),
+            m_released_bytes_total(0),
+            m_release_calls(0) {
+
+            m_first_page = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(mem) & ~static_cast<uintptr_t>(m_page_size - 1));
+            m_page_count = end_page_of(mem, total_memory_size);
+            size_t bitmap_words = (m_page_count + 63) / 64;
+
+            //allocated first, so it sits at the bottom of the heap
+            m_dirty_pages = static_cast<uint64_t*>(m_allocator.allocate_aligned(static_cast<size_type_t>(2 * bitmap_words * sizeof(uint64_t)), alignof(uint64_t)));
+            m_recent_pages = m_dirty_pages + bitmap_words;
+            memset(m_recent_pages, 0, bitmap_words * sizeof(uint64_t));
+            memset(m_dirty_pages, 0, bitmap_words * sizeof(uint64_t));
+            m_resident_pages = set_bits(m_dirty_pages, 0, m_page_count);
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        void* allocate_aligned(size_type_t allocation_size, size_type_t alignment) {
+            allocation_size = block_size_of(allocation_size);
+            if constexpr (k_huge_page_alignment) {
+                if (allocation_size >= k_huge_page_size && alignment < k_huge_page_size) {
+                    alignment = k_huge_page_size;
+                }
+            }
+
+            void* result = m_allocator.try_allocate_aligned(allocation_size, alignment);
+            if (result == nullptr) {
+                return nullptr;
+            }
+            m_resident_pages += set_bits(m_dirty_pages, first_page_of(result), end_page_of(result, allocation_size));
+#if defined(MADV_HUGEPAGE)
+            if constexpr (k_huge_page_alignment) {
+                if (allocation_size >= k_huge_page_size) {
+                    madvise(result, allocation_size, MADV_HUGEPAGE);
+                }
+            }
+#endif
+            count_operation();
+            return result;
+        }
+
+        void* allocate(size_type_t allocation_size) {
+            return allocate_aligned(allocation_size, 1);
+        }
+
+        void deallocate(void* memory, size_type_t allocation_size) {
+            allocation_size = block_size_of(allocation_size);
+            m_allocator.deallocate(memory, allocation_size);
+            set_bits(m_recent_pages, first_page_of(memory), end_page_of(memory, allocation_size));
+            count_operation();
+        }
+
+        void deallocate_aligned(void* memory, size_type_t allocation_size, size_type_t alignment) {
+            assert((reinterpret_cast<uintptr_t>(memory) & (alignment - 1)) == 0);
+            (void)alignment;
+            deallocate(memory, allocation_size);
+        }
+
+        /*
+            ends the current epoch: releases the free pages that stayed free for all of it and returns the bytes
+            released. runs by itself every k_purge_decay_operations operations unless that is 0
+        */
+        size_t decay_epoch() {
+            return purge(false);
+        }
+
+        //releases every dirty page in a large enough free node right away, regardless of the decay
+        size_t purge_all() {
+            return purge(true);
+        }
+
+        size_t resident_bytes() const {
+            return m_resident_pages << m_page_shift;
+        }
+
+        //bytes of the memory that are released right now
+        size_t purged_bytes() const {
+            return (m_page_count - m_resident_pages) << m_page_shift;
+        }
+
+        uint64_t released_bytes_total() const {
+            return m_released_bytes_total;
+        }
+
+        //madvise (or VirtualAlloc) calls made so far
+        uint64_t release_calls() const {
+            return m_release_calls;
+        }
+
+        size_t page_size() const {
+            return m_page_size;
+        }
+
+        backing_allocator_t& backing_allocator() {
+            return m_allocator;
+        }
+    };
+};
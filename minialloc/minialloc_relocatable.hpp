@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstring>
+#include <limits>
+
+#include "minialloc.hpp"
+
+//compaction starts once this share of the free memory (in percent) lies outside the largest free block
+MINIALLOC_OPTIONAL_TRAIT(k_compaction_threshold_percent, uint32_t, 50)
+
+/*
+    relocatable blocks behind stable handles, so the heap can compact itself. a handle is an index into a table
+    of block addresses, resolve() turns it into a pointer that stays valid until the next compaction step or
+    allocation (which may compact). pinned blocks are never moved.
+
+    every block starts with a header holding its handle, so the compactor can tell which handle owns the block
+    it finds behind a free node. a compaction pass walks the free nodes from the bottom of the heap up and
+    slides every block that directly follows one down into it (node_pool_allocator_t::slide_down), which
+    pushes the free bytes up and merges them with the next free node. pinned blocks and the handle table stop
+    the slide, the pass continues with the next free node above them. passes run in steps with a byte budget,
+    so the work can be spread over time.
+
+    node pool layout only, like allocator_t it adds no locking
+*/
+template<typename Traits>
+struct relocatable_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+    using handle_t = uint32_t;
+
+    static_assert(!allocator_template_t<Traits>::k_use_boundary_tags, "compaction relies on node_pool_allocator_t::slide_down");
+
+    static constexpr handle_t k_null_handle = 0;
+    static constexpr uint32_t k_compaction_threshold_percent = optional_k_compaction_threshold_percent_t<Traits>::value;
+
+    //the header keeps the alignment of the memory behind it
+    static constexpr size_type_t k_header_size = allocator_template_t<Traits>::k_imposed_alignment > sizeof(handle_t) ?
+        allocator_template_t<Traits>::k_imposed_alignment : static_cast<size_type_t>(sizeof(handle_t));
+
+    struct handle_entry_t {
+        //start of the block including its header, nullptr while the entry is free
+        uint8_t* m_block;
+        //size of the block including its header. free entries use it to link to the next free handle
+        size_type_t m_size;
+        uint32_t m_pin_count;
+    };
+
+    //the handle table block has a header too, the entries follow it at their own alignment
+    static constexpr size_type_t k_table_offset = k_header_size > alignof(handle_entry_t) ? k_header_size : static_cast<size_type_t>(alignof(handle_entry_t));
+
+    struct allocator_t {
+    private:
+        backing_allocator_t m_allocator;
+        //lives in the heap itself, as its lowest block
+        handle_entry_t* m_handles;
+        size_type_t m_handle_capacity;
+        handle_t m_first_free_handle;
+        //end of the memory blocks can be placed in
+        uint8_t* m_heap_end;
+        //where the running compaction pass continues, nullptr when no pass is running
+        uint8_t* m_compaction_cursor;
+
+        static handle_t read_header(uint8_t* block) {
+            handle_t handle;
+            memcpy(&handle, block, sizeof(handle));
+            return handle;
+        }
+
+        static void write_header(uint8_t* block, handle_t handle) {
+            memcpy(block, &handle, sizeof(handle));
+        }
+
+        handle_entry_t& entry(handle_t handle) {
+            assert(handle != k_null_handle && handle <= m_handle_capacity);
+            return m_handles[handle - 1];
+        }
+
+        void* try_allocate(size_type_t allocation_size) {
+            if (m_first_free_handle == k_null_handle) {
+                return nullptr;
+            }
+            return m_allocator.try_allocate(k_header_size + allocation_size);
+        }
+
+    public:
+        /*
+            max_handles bounds the live blocks. the handle table is taken from the heap, and the node pool is
+            sized for one more block than that
+        */
+        allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_handles) :
+            m_allocator(mem, total_memory_size, max_handles + 2),
+            m_handles(nullptr),
+            m_handle_capacity(max_handles),
+            m_first_free_handle(k_null_handle),
+            m_heap_end(nullptr),
+            m_compaction_cursor(nullptr) {
+
+            uint8_t* heap_start = nullptr;
+            size_type_t heap_size = 0;
+            bool found = m_allocator.next_free_range(mem, heap_start, heap_size);
+            assert(found);
+            (void)found;
+            m_heap_end = heap_start + heap_size;
+
+            //allocated first, so it sits at the bottom (the compactor steps over it like over a pinned block)
+            auto table = static_cast<uint8_t*>(m_allocator.allocate_aligned(k_table_offset + static_cast<size_type_t>(sizeof(handle_entry_t)) * max_handles, alignof(handle_entry_t)));
+            write_header(table, k_null_handle);
+            m_handles = reinterpret_cast<handle_entry_t*>(table + k_table_offset);
+            for (size_type_t handle_index = 0; handle_index < max_handles; ++handle_index) {
+                m_handles[handle_index].m_block = nullptr;
+                m_handles[handle_index].m_size = handle_index + 1 == max_handles ? k_null_handle : static_cast<size_type_t>(handle_index + 2);
+                m_handles[handle_index].m_pin_count = 0;
+            }
+            m_first_free_handle = max_handles == 0 ? k_null_handle : 1;
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        //when the heap is too fragmented for the request, compacts it completely and tries again
+        handle_t allocate(size_type_t allocation_size) {
+            auto block = static_cast<uint8_t*>(try_allocate(allocation_size));
+            if (block == nullptr && m_first_free_handle != k_null_handle && m_allocator.available_memory() >= k_header_size + allocation_size) {
+                compact();
+                block = static_cast<uint8_t*>(try_allocate(allocation_size));
+            }
+            if (block == nullptr) {
+                return k_null_handle;
+            }
+
+            handle_t handle = m_first_free_handle;
+            auto& handle_entry = entry(handle);
+            m_first_free_handle = static_cast<handle_t>(handle_entry.m_size);
+            handle_entry.m_block = block;
+            handle_entry.m_size = k_header_size + allocation_size;
+            handle_entry.m_pin_count = 0;
+            write_header(block, handle);
+            return handle;
+        }
+
+        void deallocate(handle_t handle) {
+            auto& handle_entry = entry(handle);
+            assert(handle_entry.m_block != nullptr && handle_entry.m_pin_count == 0);
+            m_allocator.deallocate(handle_entry.m_block, handle_entry.m_size);
+            handle_entry.m_block = nullptr;
+            handle_entry.m_size = m_first_free_handle;
+            m_first_free_handle = handle;
+        }
+
+        //valid until the next allocate or compaction step, unless the block is pinned
+        void* resolve(handle_t handle) {
+            auto& handle_entry = entry(handle);
+            assert(handle_entry.m_block != nullptr);
+            return handle_entry.m_block + k_header_size;
+        }
+
+        size_type_t allocation_size(handle_t handle) {
+            return entry(handle).m_size - k_header_size;
+        }
+
+        //pinned blocks keep their address until they are unpinned as often as they were pinned
+        void* pin(handle_t handle) {
+            ++entry(handle).m_pin_count;
+            return resolve(handle);
+        }
+
+        void unpin(handle_t handle) {
+            assert(entry(handle).m_pin_count != 0);
+            --entry(handle).m_pin_count;
+        }
+
+        //share of the free memory outside the largest free block, 0 when everything free is contiguous
+        double fragmentation() {
+            size_type_t available = m_allocator.available_memory();
+            return available == 0 ? 0.0 : 1.0 - static_cast<double>(m_allocator.largest_free_region()) / static_cast<double>(available);
+        }
+
+        bool compaction_running() const {
+            return m_compaction_cursor != nullptr;
+        }
+
+        /*
+            moves up to byte_budget bytes (at least one block if any can move) and returns the bytes moved.
+            starts a new pass if none is running, a pass ends once no free node is followed by a movable block.
+            a step looks up where the pass stands once and then follows the free list, so apart from that one
+            lookup its cost is bounded by the free nodes it passes and the bytes it moves
+        */
+        size_type_t compact_step(size_type_t byte_budget) {
+            if (m_compaction_cursor == nullptr) {
+                m_compaction_cursor = reinterpret_cast<uint8_t*>(m_handles) - k_header_size;
+            }
+
+            size_type_t moved_bytes = 0;
+            typename backing_allocator_t::free_range_t free_range;
+            bool found = m_allocator.first_free_range(m_compaction_cursor, free_range);
+            while (moved_bytes < byte_budget) {
+                if (!found || free_range.m_base + free_range.m_size >= m_heap_end) {
+                    m_compaction_cursor = nullptr;
+                    return moved_bytes;
+                }
+
+                auto block = free_range.m_base + free_range.m_size;
+                handle_t handle = read_header(block);
+                if (handle == k_null_handle || entry(handle).m_pin_count != 0) {
+                    //the block stays, carry on with the next free node above it
+                    found = m_allocator.next_free_range(free_range);
+                    continue;
+                }
+
+                auto& handle_entry = entry(handle);
+                assert(handle_entry.m_block == block);
+                handle_entry.m_block = static_cast<uint8_t*>(m_allocator.slide_down(free_range, block, handle_entry.m_size));
+                moved_bytes += handle_entry.m_size;
+            }
+            //the next step picks up at the free bytes the pass reached
+            m_compaction_cursor = found ? free_range.m_base : nullptr;
+            return moved_bytes;
+        }
+
+        //finishes the running pass, or runs a whole new one
+        void compact() {
+            do {
+                compact_step((std::numeric_limits<size_type_t>::max)());
+            } while (m_compaction_cursor != nullptr);
+        }
+
+        /*
+            call periodically: continues a running pass, or starts one when fragmentation() crossed
+            k_compaction_threshold_percent. returns the bytes moved
+        */
+        size_type_t maybe_compact(size_type_t byte_budget) {
+            if (m_compaction_cursor == nullptr && fragmentation() * 100.0 < k_compaction_threshold_percent) {
+                return 0;
+            }
+            return compact_step(byte_budget);
+        }
+
+        backing_allocator_t& backing_allocator() {
+            return m_allocator;
+        }
+    };
+};
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "minialloc.hpp"
+#include "minialloc_persistent.hpp"
+
+//offset of a block from the start of its shared segment, the same in every process. 0 is the null handle
+using shared_handle_t = uint64_t;
+
+/*
+    one heap shared by several processes (posix only). the segment starts with a header holding a process
+    shared robust mutex, the allocator object and a journal, followed by two bitmaps that record the first and
+    the last granule of every live block, followed by the heap. every process maps the segment wherever it likes
+    and creates its own allocator_t on top of the mapping, blocks are passed between processes as handles.
+
+    recovery: if a process dies while holding the lock, the next one to lock gets EOWNERDEAD. the allocator
+    object may then be half updated, so it is not trusted at all. the bitmaps are changed by single bit stores
+    with a journal entry written in front of them, so after undoing or completing the journaled operation they
+    describe the live blocks exactly. the free list is then rebuilt from them: a fresh allocator, one allocation
+    covering the whole heap, and a deallocate for every gap between live blocks. blocks the dead process owned
+    stay allocated, since it may have handed them to others. a process that dies during recovery leaves the
+    mutex inconsistent, so the next one gets EOWNERDEAD as well and starts the recovery over.
+
+    a mutex that became unrecoverable (ENOTRECOVERABLE, or any other error from locking) is never taken
+    again: allocate() returns nullptr, deallocate() leaves the block alone and with_backing_allocator()
+    returns false.
+
+    only the node pool layout with relative displacements is supported, blocks are handed out in
+    k_granularity steps. every lock rebases the allocator object, which detaches any recorder or sampler,
+    their pointers would only be valid in the process that set them
+*/
+template<typename Traits>
+struct shared_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static_assert(!Traits::k_use_absolute_pointers, "shared heaps require relative displacements");
+    static_assert(!allocator_template_t<Traits>::k_use_boundary_tags, "recovery rebuilds a node pool free list");
+
+    static constexpr size_type_t k_granularity = allocator_template_t<Traits>::k_imposed_alignment > 16 ?
+        allocator_template_t<Traits>::k_imposed_alignment : 16;
+
+    //"minishm1" in little endian
+    static constexpr uint64_t k_magic = 0x316D6873696E696Dull;
+    static constexpr uint32_t k_version = 1;
+
+    enum journal_operation_t : uint32_t {
+        k_journal_idle,
+        //the allocator is being changed but no bitmap bit has been touched yet
+        k_journal_allocating,
+        //m_offset and m_size are valid, the bits of that block may be set or not
+        k_journal_allocated,
+        //m_offset and m_size are valid, the bits of that block may be cleared or not
+        k_journal_deallocating
+    };
+
+    struct journal_t {
+        uint32_t m_operation;
+        //offset of the block from the heap
+        uint64_t m_offset;
+        uint64_t m_size;
+    };
+
+    struct segment_header_t {
+        uint64_t m_magic;
+        uint32_t m_version;
+        uint64_t m_layout_signature;
+        uint64_t m_segment_size;
+        uint64_t m_max_allocations;
+        uint64_t m_bitmap_words;
+        uint64_t m_heap_offset;
+        uint64_t m_heap_size;
+        uint64_t m_recoveries;
+        pthread_mutex_t m_lock;
+        journal_t m_journal;
+        alignas(backing_allocator_t) uint8_t m_allocator_storage[sizeof(backing_allocator_t)];
+    };
+
+    static constexpr size_t k_header_footprint = (sizeof(segment_header_t) + 63) & ~static_cast<size_t>(63);
+
+    /*
+        maps a shared memory segment. a named segment (shm_open) can be opened by unrelated processes, an
+        anonymous one (memfd on linux) is shared by inheriting or passing its descriptor
+    */
+    struct shared_segment_t {
+        uint8_t* m_memory = nullptr;
+        size_t m_size = 0;
+        int m_descriptor = -1;
+
+        shared_segment_t() = default;
+        shared_segment_t(const shared_segment_t&) = delete;
+        shared_segment_t& operator=(const shared_segment_t&) = delete;
+
+        ~shared_segment_t() {
+            close();
+        }
+
+        //name may be nullptr for an anonymous segment
+        bool create(const char* name, size_t size) {
+            assert(m_memory == nullptr);
+            int descriptor;
+            if (name != nullptr) {
+                descriptor = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+            }
+            else {
+#if defined(__linux__)
+                descriptor = memfd_create("minialloc_shared", 0);
+#else
+                char anonymous_name[64];
+                snprintf(anonymous_name, sizeof(anonymous_name), "/minialloc_%ld_%p", static_cast<long>(getpid()), static_cast<void*>(this));
+                descriptor = shm_open(anonymous_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+                if (descriptor >= 0) {
+                    shm_unlink(anonymous_name);
+                }
+#endif
+            }
+            if (descriptor < 0) {
+                return false;
+            }
+            if (ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+                ::close(descriptor);
+                return false;
+            }
+            return map(descriptor);
+        }
+
+        bool open(const char* name) {
+            assert(m_memory == nullptr);
+            int descriptor = shm_open(name, O_RDWR, 0600);
+            return descriptor >= 0 && map(descriptor);
+        }
+
+        //maps the segment behind a descriptor another segment (possibly in another process) uses, the descriptor is duplicated
+        bool open_descriptor(int descriptor) {
+            assert(m_memory == nullptr);
+            int duplicate = dup(descriptor);
+            return duplicate >= 0 && map(duplicate);
+        }
+
+        static void unlink(const char* name) {
+            shm_unlink(name);
+        }
+
+        void close() {
+            if (m_memory != nullptr) {
+                munmap(m_memory, m_size);
+            }
+            if (m_descriptor >= 0) {
+                ::close(m_descriptor);
+            }
+            m_memory = nullptr;
+            m_size = 0;
+            m_descriptor = -1;
+        }
+
+    private:
+        //takes ownership of the descriptor
+        bool map(int descriptor) {
+            struct stat segment_status;
+            if (fstat(descriptor, &segment_status) != 0) {
+                ::close(descriptor);
+                return false;
+            }
+            void* memory = mmap(nullptr, static_cast<size_t>(segment_status.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+            if (memory == MAP_FAILED) {
+                ::close(descriptor);
+                return false;
+            }
+            m_memory = static_cast<uint8_t*>(memory);
+            m_size = static_cast<size_t>(segment_status.st_size);
+            m_descriptor = descriptor;
+            return true;
+        }
+    };
+
+    //one per process and mapping, every call takes the segment lock
+    struct allocator_t {
+    private:
+        uint8_t* m_segment;
+        segment_header_t* m_header;
+        uint64_t* m_start_bits;
+        uint64_t* m_end_bits;
+        uint8_t* m_heap;
+
+        backing_allocator_t* backing() {
+            return std::launder(reinterpret_cast<backing_allocator_t*>(m_header->m_allocator_storage));
+        }
+
+        size_type_t granule_of(uint8_t* memory) const {
+            return static_cast<size_type_t>((memory - m_heap) / k_granularity);
+        }
+
+        static void set_bit(uint64_t* bits, size_type_t index) {
+            bits[index / 64] |= static_cast<uint64_t>(1) << (index % 64);
+        }
+
+        static void clear_bit(uint64_t* bits, size_type_t index) {
+            bits[index / 64] &= ~(static_cast<uint64_t>(1) << (index % 64));
+        }
+
+        //first set bit at or after index, the bit must exist
+        static size_type_t next_bit(const uint64_t* bits, size_type_t index) {
+            size_type_t word_index = index / 64;
+            uint64_t word = bits[word_index] & (~static_cast<uint64_t>(0) << (index % 64));
+            while (word == 0) {
+                word = bits[++word_index];
+            }
+            return static_cast<size_type_t>(word_index * 64 + minialloc_bitscan_forward(word));
+        }
+
+        size_type_t block_size(size_type_t start_granule) const {
+            return (next_bit(m_end_bits, start_granule) - start_granule + 1) * k_granularity;
+        }
+
+        //keeps the journal ahead of the bitmap stores it describes, and those ahead of clearing it
+        static void journal_fence() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        //false when the lock is not held and can never be taken, the segment must not be touched then
+        bool lock() {
+            int result = pthread_mutex_lock(&m_header->m_lock);
+            if (result == EOWNERDEAD) {
+                recover();
+                result = pthread_mutex_consistent(&m_header->m_lock);
+                if (result != 0) {
+                    //unlocking an inconsistent robust mutex marks it unrecoverable for everyone
+                    pthread_mutex_unlock(&m_header->m_lock);
+                }
+            }
+            if (result != 0) {
+                return false;
+            }
+            //every process sees the heap at its own address
+            backing()->rebase(m_heap);
+            return true;
+        }
+
+        void unlock() {
+            pthread_mutex_unlock(&m_header->m_lock);
+        }
+
+        //the lock is held but its previous owner died, see the comment at the top
+        void recover() {
+            auto& journal = m_header->m_journal;
+            if (journal.m_operation == k_journal_allocated || journal.m_operation == k_journal_deallocating) {
+                //an allocation the dead process never returned, or a free it asked for, either way the block is free
+                size_type_t start_granule = static_cast<size_type_t>(journal.m_offset / k_granularity);
+                size_type_t end_granule = start_granule + static_cast<size_type_t>(journal.m_size / k_granularity) - 1;
+                clear_bit(m_start_bits, start_granule);
+                clear_bit(m_end_bits, end_granule);
+            }
+            journal.m_operation = k_journal_idle;
+
+            auto allocator = new (m_header->m_allocator_storage) backing_allocator_t(m_heap,
+                static_cast<size_type_t>(m_header->m_heap_size), static_cast<size_type_t>(m_header->m_max_allocations));
+
+            //a small block grown over the whole heap, the size class search could not find it in one go
+            size_type_t usable_size = allocator->largest_free_region();
+            auto cursor = static_cast<uint8_t*>(allocator->allocate(1));
+            bool expanded = allocator->try_expand(cursor, 1, usable_size);
+            assert(expanded);
+            (void)expanded;
+            auto heap_end = cursor + usable_size;
+
+            for (size_type_t word_index = 0; word_index < m_header->m_bitmap_words; ++word_index) {
+                for (uint64_t word = m_start_bits[word_index]; word != 0; word &= word - 1) {
+                    size_type_t start_granule = static_cast<size_type_t>(word_index * 64 + minialloc_bitscan_forward(word));
+                    auto block = m_heap + start_granule * k_granularity;
+                    if (block > cursor) {
+                        allocator->deallocate(cursor, static_cast<size_type_t>(block - cursor));
+                    }
+                    cursor = block + block_size(start_granule);
+                }
+            }
+            if (cursor < heap_end) {
+                allocator->deallocate(cursor, static_cast<size_type_t>(heap_end - cursor));
+            }
+            ++m_header->m_recoveries;
+            allocator->validate_freelist();
+        }
+
+    public:
+        //formats a mapped segment as an empty heap, before any process creates an allocator_t on it
+        static void format(uint8_t* segment, size_t segment_size, size_type_t max_allocations) {
+            assert((reinterpret_cast<uintptr_t>(segment) & 63) == 0);
+
+            auto header = new (segment) segment_header_t{};
+            header->m_magic = k_magic;
+            header->m_version = k_version;
+            header->m_layout_signature = persistent_allocator_template_t<Traits>::layout_signature();
+            header->m_segment_size = segment_size;
+            header->m_max_allocations = max_allocations;
+            //covers the whole segment, which is a little more than the heap needs
+            header->m_bitmap_words = (segment_size / k_granularity + 63) / 64;
+            header->m_heap_offset = (k_header_footprint + 2 * sizeof(uint64_t) * header->m_bitmap_words + 63) & ~static_cast<uint64_t>(63);
+            assert(header->m_heap_offset < segment_size);
+            header->m_heap_size = segment_size - header->m_heap_offset;
+            header->m_recoveries = 0;
+            header->m_journal.m_operation = k_journal_idle;
+
+            pthread_mutexattr_t attributes;
+            pthread_mutexattr_init(&attributes);
+            pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+            pthread_mutex_init(&header->m_lock, &attributes);
+            pthread_mutexattr_destroy(&attributes);
+
+            memset(segment + k_header_footprint, 0, 2 * sizeof(uint64_t) * header->m_bitmap_words);
+            new (header->m_allocator_storage) backing_allocator_t(segment + header->m_heap_offset,
+                static_cast<size_type_t>(header->m_heap_size), max_allocations);
+        }
+
+        explicit allocator_t(uint8_t* segment) :
+            m_segment(segment),
+            m_header(reinterpret_cast<segment_header_t*>(segment)),
+            m_start_bits(reinterpret_cast<uint64_t*>(segment + k_header_footprint)),
+            m_end_bits(m_start_bits + m_header->m_bitmap_words),
+            m_heap(segment + m_header->m_heap_offset) {
+
+            assert(m_header->m_magic == k_magic);
+            assert(m_header->m_version == k_version);
+            assert(m_header->m_layout_signature == persistent_allocator_template_t<Traits>::layout_signature());
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        void* allocate(size_type_t allocation_size) {
+            allocation_size = allocation_size == 0 ? k_granularity : (allocation_size + k_granularity - 1) & ~(k_granularity - 1);
+            auto& journal = m_header->m_journal;
+
+            if (!lock()) {
+                return nullptr;
+            }
+            journal.m_operation = k_journal_allocating;
+            journal_fence();
+
+            auto memory = static_cast<uint8_t*>(backing()->try_allocate_aligned(allocation_size, k_granularity));
+            if (memory != nullptr) {
+                journal.m_offset = static_cast<uint64_t>(memory - m_heap);
+                journal.m_size = allocation_size;
+                journal_fence();
+                journal.m_operation = k_journal_allocated;
+                journal_fence();
+
+                set_bit(m_start_bits, granule_of(memory));
+                set_bit(m_end_bits, granule_of(memory + allocation_size - 1));
+                journal_fence();
+            }
+            journal.m_operation = k_journal_idle;
+            unlock();
+            return memory;
+        }
+
+        //the size of the block comes from the bitmaps
+        void deallocate(void* memory) {
+            auto block = static_cast<uint8_t*>(memory);
+            auto& journal = m_header->m_journal;
+
+            if (!lock()) {
+                return;
+            }
+            size_type_t start_granule = granule_of(block);
+            assert((m_start_bits[start_granule / 64] >> (start_granule % 64)) & 1);
+            size_type_t allocation_size = block_size(start_granule);
+
+            journal.m_offset = static_cast<uint64_t>(block - m_heap);
+            journal.m_size = allocation_size;
+            journal_fence();
+            journal.m_operation = k_journal_deallocating;
+            journal_fence();
+
+            clear_bit(m_start_bits, start_granule);
+            clear_bit(m_end_bits, start_granule + allocation_size / k_granularity - 1);
+            backing()->deallocate_aligned(block, allocation_size, k_granularity);
+            journal_fence();
+
+            journal.m_operation = k_journal_idle;
+            unlock();
+        }
+
+        shared_handle_t to_handle(void* memory) const {
+            return memory == nullptr ? 0 : static_cast<shared_handle_t>(static_cast<uint8_t*>(memory) - m_segment);
+        }
+
+        void* from_handle(shared_handle_t handle) const {
+            return handle == 0 ? nullptr : m_segment + handle;
+        }
+
+        uint64_t recovery_count() const {
+            return m_header->m_recoveries;
+        }
+
+        //takes the lock first, so it also runs a pending recovery. false if function was not called because the lock is lost
+        template<typename Function>
+        bool with_backing_allocator(Function&& function) {
+            if (!lock()) {
+                return false;
+            }
+            function(*backing());
+            unlock();
+            return true;
+        }
+
+#if MINIALLOC_VERIFY == 1
+        //dies in the middle of an allocation while holding the lock, for testing recovery
+        [[noreturn]] void debug_exit_during_allocate(size_type_t allocation_size) {
+            if (!lock()) {
+                _exit(1);
+            }
+            m_header->m_journal.m_operation = k_journal_allocating;
+            journal_fence();
+            auto memory = static_cast<uint8_t*>(backing()->allocate_aligned(allocation_size, k_granularity));
+            m_header->m_journal.m_offset = static_cast<uint64_t>(memory - m_heap);
+            m_header->m_journal.m_size = allocation_size;
+            journal_fence();
+            m_header->m_journal.m_operation = k_journal_allocated;
+            journal_fence();
+            set_bit(m_start_bits, granule_of(memory));
+            _exit(0);
+        }
+#endif
+    };
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cstring>
+
+#include "minialloc.hpp"
+
+//requests up to this many bytes are served from slabs, larger ones go straight to the underlying allocator
+MINIALLOC_OPTIONAL_TRAIT(k_slab_max_size, uint32_t, 256)
+//bytes per slab, a power of two. slabs are aligned to their size
+MINIALLOC_OPTIONAL_TRAIT(k_slab_size, uint32_t, 4096)
+
+/*
+    small object front end. every small size class carves slabs out of the underlying allocator_t and hands
+    out the slots in them, tracked by a bitmap per slab, so small blocks cost neither a split of the general
+    free list nor a pool node, and blocks of one class stay packed together.
+
+    slabs are aligned to their size, the slab of a block is found by masking its address. a size class keeps
+    its slabs that have free slots in a list, allocation takes the first free slot of the first slab in it.
+    a slab that becomes empty goes back to the underlying allocator, except for one spare per size class so
+    a class hovering around a slab boundary does not keep carving and releasing the same slab. trim()
+    releases the spares too.
+
+    allocate() returns nullptr when the underlying allocator is out of memory, like its try_allocate. like
+    allocator_t, it adds no locking
+*/
+template<typename Traits>
+struct slab_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static constexpr size_type_t k_slot_granularity = allocator_template_t<Traits>::k_imposed_alignment > 16 ?
+        allocator_template_t<Traits>::k_imposed_alignment : 16;
+    static constexpr uint32_t k_max_slab_object_size = optional_k_slab_max_size_t<Traits>::value;
+    static constexpr uint32_t k_slab_size = optional_k_slab_size_t<Traits>::value;
+    static constexpr uint32_t k_size_class_count = static_cast<uint32_t>(k_max_slab_object_size / k_slot_granularity);
+    //enough for slabs of the smallest class, larger classes leave the tail words zero
+    static constexpr uint32_t k_bitmap_words = static_cast<uint32_t>((k_slab_size / k_slot_granularity + 63) / 64);
+
+    static_assert((k_slab_size & (k_slab_size - 1)) == 0, "slabs must be a power of two in size");
+    static_assert((k_max_slab_object_size % k_slot_granularity) == 0);
+
+    struct slab_header_t {
+        slab_header_t* m_next;
+        slab_header_t* m_previous;
+        uint32_t m_size_class;
+        uint32_t m_used_count;
+        uint32_t m_slot_count;
+        //set bits are used slots, bits past m_slot_count are set so they are never found
+        uint64_t m_used_slots[k_bitmap_words];
+    };
+
+    static constexpr size_type_t k_slab_header_size = (sizeof(slab_header_t) + k_slot_granularity - 1) & ~(k_slot_granularity - 1);
+
+    static_assert(k_slab_header_size + k_max_slab_object_size <= k_slab_size, "a slab must hold at least one object of the largest class");
+
+    struct allocator_t {
+    private:
+        struct size_class_t {
+            //slabs with at least one free slot
+            slab_header_t* m_partial_slabs;
+            //an empty slab kept back from the underlying allocator
+            slab_header_t* m_spare_slab;
+        };
+
+        backing_allocator_t m_allocator;
+        size_class_t m_size_classes[k_size_class_count];
+        size_type_t m_slab_count;
+
+        static uint32_t size_class_of(size_type_t allocation_size) {
+            return allocation_size == 0 ? 0 : static_cast<uint32_t>((allocation_size - 1) / k_slot_granularity);
+        }
+
+        static size_type_t slot_size_of(uint32_t size_class) {
+            return (static_cast<size_type_t>(size_class) + 1) * k_slot_granularity;
+        }
+
+        static slab_header_t* slab_of(void* memory) {
+            return reinterpret_cast<slab_header_t*>(reinterpret_cast<uintptr_t>(memory) & ~static_cast<uintptr_t>(k_slab_size - 1));
+        }
+
+        static uint8_t* slot_memory(slab_header_t* slab, uint32_t slot_index) {
+            return reinterpret_cast<uint8_t*>(slab) + k_slab_header_size + slot_index * slot_size_of(slab->m_size_class);
+        }
+
+        static void push_partial(size_class_t& size_class, slab_header_t* slab) {
+            slab->m_previous = nullptr;
+            slab->m_next = size_class.m_partial_slabs;
+            if (slab->m_next != nullptr) {
+                slab->m_next->m_previous = slab;
+            }
+            size_class.m_partial_slabs = slab;
+        }
+
+        static void unlink_partial(size_class_t& size_class, slab_header_t* slab) {
+            if (slab->m_previous != nullptr) {
+                slab->m_previous->m_next = slab->m_next;
+            }
+            else {
+                size_class.m_partial_slabs = slab->m_next;
+            }
+            if (slab->m_next != nullptr) {
+                slab->m_next->m_previous = slab->m_previous;
+            }
+        }
+
+        slab_header_t* create_slab(uint32_t size_class_index) {
+            auto& size_class = m_size_classes[size_class_index];
+            slab_header_t* slab = size_class.m_spare_slab;
+            if (slab != nullptr) {
+                size_class.m_spare_slab = nullptr;
+                return slab;
+            }
+
+            slab = static_cast<slab_header_t*>(m_allocator.try_allocate_aligned(k_slab_size, k_slab_size));
+            if (slab == nullptr) {
+                return nullptr;
+            }
+            ++m_slab_count;
+
+            uint32_t slot_count = static_cast<uint32_t>((k_slab_size - k_slab_header_size) / slot_size_of(size_class_index));
+            slab->m_size_class = size_class_index;
+            slab->m_used_count = 0;
+            slab->m_slot_count = slot_count;
+            for (uint32_t word_index = 0; word_index < k_bitmap_words; ++word_index) {
+                uint32_t first_slot = word_index * 64;
+                if (first_slot >= slot_count) {
+                    slab->m_used_slots[word_index] = ~static_cast<uint64_t>(0);
+                }
+                else if (slot_count - first_slot < 64) {
+                    slab->m_used_slots[word_index] = ~static_cast<uint64_t>(0) << (slot_count - first_slot);
+                }
+                else {
+                    slab->m_used_slots[word_index] = 0;
+                }
+            }
+            return slab;
+        }
+
+        void release_slab(slab_header_t* slab) {
+            m_allocator.deallocate_aligned(slab, k_slab_size, k_slab_size);
+            --m_slab_count;
+        }
+
+    public:
+        allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_allocations) :
+            m_allocator(mem, total_memory_size, max_allocations),
+            m_size_classes(),
+            m_slab_count(0) {
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        void* allocate(size_type_t allocation_size) {
+            if (allocation_size > k_max_slab_object_size) {
+                return m_allocator.try_allocate(allocation_size);
+            }
+
+            uint32_t size_class_index = size_class_of(allocation_size);
+            auto& size_class = m_size_classes[size_class_index];
+            slab_header_t* slab = size_class.m_partial_slabs;
+            if (slab == nullptr) {
+                slab = create_slab(size_class_index);
+                if (slab == nullptr) {
+                    return nullptr;
+                }
+                push_partial(size_class, slab);
+            }
+
+            //a partial slab always has a zero bit
+            uint32_t word_index = 0;
+            while (slab->m_used_slots[word_index] == ~static_cast<uint64_t>(0)) {
+                ++word_index;
+            }
+            uint32_t bit_index = minialloc_bitscan_forward(~slab->m_used_slots[word_index]);
+            slab->m_used_slots[word_index] |= static_cast<uint64_t>(1) << bit_index;
+
+            if (++slab->m_used_count == slab->m_slot_count) {
+                unlink_partial(size_class, slab);
+            }
+            return slot_memory(slab, word_index * 64 + bit_index);
+        }
+
+        void deallocate(void* memory, size_type_t allocation_size) {
+            if (allocation_size > k_max_slab_object_size) {
+                m_allocator.deallocate(memory, allocation_size);
+                return;
+            }
+
+            auto slab = slab_of(memory);
+            auto& size_class = m_size_classes[slab->m_size_class];
+            assert(slab->m_size_class == size_class_of(allocation_size));
+
+            uint32_t slot_index = static_cast<uint32_t>((static_cast<uint8_t*>(memory) - slot_memory(slab, 0)) / slot_size_of(slab->m_size_class));
+            uint64_t slot_bit = static_cast<uint64_t>(1) << (slot_index % 64);
+            //a slot that is already free means a double free
+            assert((slab->m_used_slots[slot_index / 64] & slot_bit) != 0);
+            slab->m_used_slots[slot_index / 64] &= ~slot_bit;
+
+            if (slab->m_used_count-- == slab->m_slot_count) {
+                push_partial(size_class, slab);
+            }
+            if (slab->m_used_count == 0) {
+                unlink_partial(size_class, slab);
+                if (size_class.m_spare_slab == nullptr) {
+                    size_class.m_spare_slab = slab;
+                }
+                else {
+                    release_slab(slab);
+                }
+            }
+        }
+
+        //hands the spare slabs back to the underlying allocator
+        void trim() {
+            for (auto& size_class : m_size_classes) {
+                if (size_class.m_spare_slab != nullptr) {
+                    release_slab(size_class.m_spare_slab);
+                    size_class.m_spare_slab = nullptr;
+                }
+            }
+        }
+
+        //slabs currently carved from the underlying allocator, spares included
+        size_type_t slab_count() const {
+            return m_slab_count;
+        }
+
+        backing_allocator_t& backing_allocator() {
+            return m_allocator;
+        }
+    };
+};
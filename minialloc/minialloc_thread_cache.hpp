@@ -0,0 +1,318 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "minialloc.hpp"
+
+//requests up to this many bytes are served from the per thread magazines, larger ones always take the lock
+MINIALLOC_OPTIONAL_TRAIT(k_thread_cache_max_size, uint32_t, 512)
+//blocks a thread keeps per size class before handing some back to the shared allocator
+MINIALLOC_OPTIONAL_TRAIT(k_thread_cache_magazine_size, uint32_t, 32)
+//number of thread caches that can be attached to one shared allocator at the same time
+MINIALLOC_OPTIONAL_TRAIT(k_max_thread_caches, uint32_t, 64)
+
+/*
+    optional multi threaded front end. one allocator_t is shared between threads behind a mutex, and every
+    thread that attaches a thread_cache_t keeps magazines of free blocks per size class in front of it.
+    magazines are refilled from and flushed to the shared allocator in batches, so the lock is taken
+    once per batch rather than once per call.
+
+    every block carries a small header naming the thread cache that allocated it. a block freed by another
+    thread is pushed onto the owners lock free return queue and the owner moves it back into its magazines
+    the next time it runs dry.
+
+    allocate() returns nullptr once the shared allocator is out of memory. a thread cache created while all
+    k_max_thread_caches slots are taken gets none and serves every call through the locked uncached path.
+*/
+template<typename Traits>
+struct concurrent_allocator_template_t {
+
+    using backing_allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    static constexpr uint32_t k_size_class_granularity = 16;
+    static constexpr uint32_t k_max_cached_size = optional_k_thread_cache_max_size_t<Traits>::value;
+    static constexpr uint32_t k_size_class_count = k_max_cached_size / k_size_class_granularity;
+    static constexpr uint32_t k_magazine_size = optional_k_thread_cache_magazine_size_t<Traits>::value;
+    static constexpr uint32_t k_max_thread_caches = optional_k_max_thread_caches_t<Traits>::value;
+    //blocks moved between a magazine and the shared allocator per lock acquisition
+    static constexpr uint32_t k_transfer_batch_size = k_magazine_size / 2;
+
+    static_assert((k_max_cached_size % k_size_class_granularity) == 0);
+    static_assert(k_transfer_batch_size != 0);
+
+    //owner of blocks that bypassed the thread caches, they are always freed straight to the shared allocator
+    static constexpr uint32_t k_uncached_owner = ~0u;
+
+    struct block_header_t {
+        uint32_t m_owner;
+        uint32_t m_size_class;
+        //link in the owners return queue, only meaningful while the block is queued there
+        block_header_t* m_next_returned;
+    };
+
+    //the header is padded so user memory keeps the 16 byte alignment of the block
+    static constexpr size_type_t k_header_size = 16;
+    static_assert(sizeof(block_header_t) <= k_header_size);
+
+    struct alignas(64) thread_slot_t {
+        std::atomic<bool> m_attached;
+        //blocks owned by this slot that other threads freed, pushed lock free and taken all at once
+        std::atomic<block_header_t*> m_returned_blocks;
+    };
+
+    struct thread_cache_t;
+
+    struct allocator_t {
+    private:
+        backing_allocator_t m_allocator;
+        std::mutex m_lock;
+        thread_slot_t m_slots[k_max_thread_caches];
+
+        friend struct thread_cache_t;
+
+        static uint32_t size_class_of(size_type_t allocation_size) {
+            return allocation_size == 0 ? 0 : static_cast<uint32_t>((allocation_size - 1) / k_size_class_granularity);
+        }
+
+        static size_type_t size_class_block_size(uint32_t size_class) {
+            return k_header_size + (static_cast<size_type_t>(size_class) + 1) * k_size_class_granularity;
+        }
+
+        static size_type_t uncached_block_size(size_type_t allocation_size) {
+            return k_header_size + allocation_size;
+        }
+
+        static block_header_t* header_of(void* memory) {
+            return reinterpret_cast<block_header_t*>(static_cast<uint8_t*>(memory) - k_header_size);
+        }
+
+        static void* memory_of(block_header_t* header) {
+            return reinterpret_cast<uint8_t*>(header) + k_header_size;
+        }
+
+        //the lock must be held, nullptr when the shared allocator is full
+        block_header_t* allocate_block_locked(size_type_t block_size) {
+            return static_cast<block_header_t*>(m_allocator.try_allocate_aligned(block_size, k_size_class_granularity));
+        }
+
+        //frees a block that belongs to a thread cache, the lock must be held
+        void deallocate_block_locked(block_header_t* header) {
+            m_allocator.deallocate(header, size_class_block_size(header->m_size_class));
+        }
+
+        static void push_returned_block(thread_slot_t& slot, block_header_t* header) {
+            auto head = slot.m_returned_blocks.load(std::memory_order_relaxed);
+            do {
+                header->m_next_returned = head;
+            } while (!slot.m_returned_blocks.compare_exchange_weak(head, header, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        //the whole queue is detached with one exchange, so any thread may drain any slot
+        static block_header_t* take_returned_blocks(thread_slot_t& slot) {
+            return slot.m_returned_blocks.exchange(nullptr, std::memory_order_acquire);
+        }
+
+        //k_uncached_owner when every slot is taken
+        uint32_t attach_slot() {
+            for (uint32_t slot_index = 0; slot_index < k_max_thread_caches; ++slot_index) {
+                bool expected = false;
+                if (m_slots[slot_index].m_attached.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    return slot_index;
+                }
+            }
+            return k_uncached_owner;
+        }
+
+    public:
+        allocator_t(uint8_t* mem, size_type_t total_memory_size, size_type_t max_allocations) :
+            m_allocator(mem, total_memory_size, max_allocations),
+            m_lock(),
+            m_slots() {
+        }
+
+        allocator_t(const allocator_t&) = delete;
+        allocator_t& operator=(const allocator_t&) = delete;
+
+        //for threads without a thread cache, always takes the lock
+        void* allocate(size_type_t allocation_size) {
+            std::lock_guard<std::mutex> guard{ m_lock };
+            auto header = allocate_block_locked(uncached_block_size(allocation_size));
+            if (header == nullptr) {
+                return nullptr;
+            }
+            header->m_owner = k_uncached_owner;
+            header->m_size_class = 0;
+            return memory_of(header);
+        }
+
+        //accepts blocks from any thread cache or from allocate(), cached blocks go back to their owner
+        void deallocate(void* memory, size_type_t allocation_size) {
+            auto header = header_of(memory);
+            if (header->m_owner != k_uncached_owner) {
+                push_returned_block(m_slots[header->m_owner], header);
+                return;
+            }
+            std::lock_guard<std::mutex> guard{ m_lock };
+            m_allocator.deallocate(header, uncached_block_size(allocation_size));
+        }
+
+        //frees every block waiting in a return queue, including those of threads that have since detached
+        void collect_returned_blocks() {
+            std::lock_guard<std::mutex> guard{ m_lock };
+            for (auto& slot : m_slots) {
+                for (auto header = take_returned_blocks(slot); header != nullptr; ) {
+                    auto next = header->m_next_returned;
+                    deallocate_block_locked(header);
+                    header = next;
+                }
+            }
+        }
+
+        //no thread may use the allocator while the result is in use
+        backing_allocator_t& backing_allocator() {
+            return m_allocator;
+        }
+    };
+
+    /*
+        one per thread, it claims a slot in the shared allocator for its lifetime. destroying it (or calling
+        flush) hands every cached block back. blocks freed to a detached slot wait in its return queue until
+        the slot is attached again or collect_returned_blocks is called
+    */
+    struct thread_cache_t {
+    private:
+        struct magazine_t {
+            uint32_t m_count;
+            block_header_t* m_blocks[k_magazine_size];
+        };
+
+        allocator_t& m_shared;
+        uint32_t m_slot;
+        magazine_t m_magazines[k_size_class_count];
+
+        //moves the oldest blocks of a full magazine to the shared allocator
+        void flush_magazine(magazine_t& magazine, uint32_t block_count) {
+            assert(block_count <= magazine.m_count);
+            {
+                std::lock_guard<std::mutex> guard{ m_shared.m_lock };
+                for (uint32_t block_index = 0; block_index < block_count; ++block_index) {
+                    m_shared.deallocate_block_locked(magazine.m_blocks[block_index]);
+                }
+            }
+            magazine.m_count -= block_count;
+            for (uint32_t block_index = 0; block_index < magazine.m_count; ++block_index) {
+                magazine.m_blocks[block_index] = magazine.m_blocks[block_index + block_count];
+            }
+        }
+
+        void cache_block(block_header_t* header) {
+            auto& magazine = m_magazines[header->m_size_class];
+            if (magazine.m_count == k_magazine_size) {
+                flush_magazine(magazine, k_transfer_batch_size);
+            }
+            magazine.m_blocks[magazine.m_count++] = header;
+        }
+
+        //returns true if anything was moved back into the magazines
+        bool drain_returned_blocks() {
+            auto header = allocator_t::take_returned_blocks(m_shared.m_slots[m_slot]);
+            if (header == nullptr) {
+                return false;
+            }
+            while (header != nullptr) {
+                auto next = header->m_next_returned;
+                cache_block(header);
+                header = next;
+            }
+            return true;
+        }
+
+        //stops short of a full batch when the shared allocator runs out
+        void refill_magazine(magazine_t& magazine, uint32_t size_class) {
+            size_type_t block_size = allocator_t::size_class_block_size(size_class);
+
+            std::lock_guard<std::mutex> guard{ m_shared.m_lock };
+            for (uint32_t block_index = 0; block_index < k_transfer_batch_size; ++block_index) {
+                auto header = m_shared.allocate_block_locked(block_size);
+                if (header == nullptr) {
+                    return;
+                }
+                header->m_owner = m_slot;
+                header->m_size_class = size_class;
+                magazine.m_blocks[magazine.m_count++] = header;
+            }
+        }
+
+    public:
+        explicit thread_cache_t(allocator_t& shared) :
+            m_shared(shared),
+            m_slot(shared.attach_slot()),
+            m_magazines() {
+        }
+
+        ~thread_cache_t() {
+            if (attached()) {
+                flush();
+                m_shared.m_slots[m_slot].m_attached.store(false, std::memory_order_release);
+            }
+        }
+
+        thread_cache_t(const thread_cache_t&) = delete;
+        thread_cache_t& operator=(const thread_cache_t&) = delete;
+
+        //false when every slot was taken, the cache then passes everything to the shared allocator
+        bool attached() const {
+            return m_slot != k_uncached_owner;
+        }
+
+        void* allocate(size_type_t allocation_size) {
+            if (allocation_size > k_max_cached_size || !attached()) {
+                return m_shared.allocate(allocation_size);
+            }
+            uint32_t size_class = allocator_t::size_class_of(allocation_size);
+            auto& magazine = m_magazines[size_class];
+
+            if (magazine.m_count == 0) {
+                //blocks other threads handed back are cheaper than taking the lock
+                if (!drain_returned_blocks() || magazine.m_count == 0) {
+                    refill_magazine(magazine, size_class);
+                }
+                if (magazine.m_count == 0) {
+                    return nullptr;
+                }
+            }
+            return allocator_t::memory_of(magazine.m_blocks[--magazine.m_count]);
+        }
+
+        //memory may come from any thread cache attached to the same shared allocator
+        void deallocate(void* memory, size_type_t allocation_size) {
+            auto header = allocator_t::header_of(memory);
+
+            if (attached() && header->m_owner == m_slot) {
+                assert(header->m_size_class == allocator_t::size_class_of(allocation_size));
+                cache_block(header);
+            }
+            else {
+                m_shared.deallocate(memory, allocation_size);
+            }
+        }
+
+        //hands every cached block, and everything in this threads return queue, back to the shared allocator
+        void flush() {
+            if (!attached()) {
+                return;
+            }
+            drain_returned_blocks();
+
+            std::lock_guard<std::mutex> guard{ m_shared.m_lock };
+            for (auto& magazine : m_magazines) {
+                for (uint32_t block_index = 0; block_index < magazine.m_count; ++block_index) {
+                    m_shared.deallocate_block_locked(magazine.m_blocks[block_index]);
+                }
+                magazine.m_count = 0;
+            }
+        }
+    };
+};
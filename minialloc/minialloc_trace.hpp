@@ -0,0 +1,335 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "minialloc.hpp"
+
+/*
+    a compact binary trace of allocator operations, so a real workload can be captured once and replayed against
+    other traits offline.
+
+    a trace starts with the 8 byte magic "MATRACE1", followed by records of one operation byte and its operands as
+    LEB128 varints. blocks are named by small ids instead of addresses: an id is handed out on allocate and
+    reused after the block is freed, so a replay can keep its blocks in a plain array.
+
+        allocate    block, size, alignment
+        deallocate  block, size
+        resize      block, old size, new size       (in place, the block keeps its id)
+        reset                                       (every live block is gone)
+*/
+enum class trace_operation_t : uint8_t {
+    allocate = 1,
+    deallocate = 2,
+    resize = 3,
+    reset = 4
+};
+
+static constexpr char k_trace_magic[8] = { 'M', 'A', 'T', 'R', 'A', 'C', 'E', '1' };
+
+struct trace_record_t {
+    trace_operation_t m_operation;
+    uint32_t m_block;
+    //the allocation size, or the new size of a resize
+    uint64_t m_size;
+    //the alignment of an allocate, the old size of a resize
+    uint64_t m_argument;
+};
+
+/*
+    an allocation_recorder_t that writes the trace to a file, give it to allocator_t::set_recorder. it keeps the
+    id and size of every live block, release_to() is written as a deallocate of every block above the frontier.
+    a block slide_down moves keeps its id, so the move only changes where the writer looks it up and writes nothing.
+    records are buffered, flush() or the destructor writes them out
+*/
+struct trace_writer_t final : allocation_recorder_t {
+private:
+    struct live_block_t {
+        uint32_t m_block;
+        size_t m_size;
+    };
+
+    FILE* m_file;
+    std::vector<uint8_t> m_buffer;
+    std::unordered_map<void*, live_block_t> m_live_blocks;
+    std::vector<uint32_t> m_free_ids;
+    uint32_t m_next_id;
+    uint64_t m_record_count;
+
+    static constexpr size_t k_flush_size = 64 * 1024;
+
+    void write_varint(uint64_t value) {
+        while (value >= 0x80) {
+            m_buffer.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        m_buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void begin_record(trace_operation_t operation) {
+        if (m_buffer.size() >= k_flush_size) {
+            flush();
+        }
+        m_buffer.push_back(static_cast<uint8_t>(operation));
+        ++m_record_count;
+    }
+
+    void write_deallocate(uint32_t block, size_t allocation_size) {
+        begin_record(trace_operation_t::deallocate);
+        write_varint(block);
+        write_varint(allocation_size);
+        m_free_ids.push_back(block);
+    }
+
+public:
+    explicit trace_writer_t(FILE* file) :
+        m_file(file),
+        m_buffer(),
+        m_live_blocks(),
+        m_free_ids(),
+        m_next_id(0),
+        m_record_count(0) {
+        fwrite(k_trace_magic, 1, sizeof(k_trace_magic), m_file);
+    }
+
+    trace_writer_t(const trace_writer_t&) = delete;
+    trace_writer_t& operator=(const trace_writer_t&) = delete;
+
+    ~trace_writer_t() {
+        flush();
+    }
+
+    void record_allocate(void* memory, size_t allocation_size, size_t alignment) override {
+        uint32_t block = m_next_id;
+        if (!m_free_ids.empty()) {
+            block = m_free_ids.back();
+            m_free_ids.pop_back();
+        }
+        else {
+            ++m_next_id;
+        }
+        m_live_blocks[memory] = live_block_t{ block, allocation_size };
+
+        begin_record(trace_operation_t::allocate);
+        write_varint(block);
+        write_varint(allocation_size);
+        write_varint(alignment);
+    }
+
+    void record_deallocate(void* memory, size_t allocation_size) override {
+        auto live_block = m_live_blocks.find(memory);
+        assert(live_block != m_live_blocks.end());
+        write_deallocate(live_block->second.m_block, allocation_size);
+        m_live_blocks.erase(live_block);
+    }
+
+    void record_resize(void* memory, size_t old_size, size_t new_size) override {
+        auto live_block = m_live_blocks.find(memory);
+        assert(live_block != m_live_blocks.end());
+        live_block->second.m_size = new_size;
+
+        begin_record(trace_operation_t::resize);
+        write_varint(live_block->second.m_block);
+        write_varint(old_size);
+        write_varint(new_size);
+    }
+
+    void record_reset() override {
+        begin_record(trace_operation_t::reset);
+        m_live_blocks.clear();
+        m_free_ids.clear();
+        m_next_id = 0;
+    }
+
+    void record_release_to(void* frontier) override {
+        for (auto live_block = m_live_blocks.begin(); live_block != m_live_blocks.end();) {
+            if (live_block->first >= frontier) {
+                write_deallocate(live_block->second.m_block, live_block->second.m_size);
+                live_block = m_live_blocks.erase(live_block);
+            }
+            else {
+                ++live_block;
+            }
+        }
+    }
+
+    void record_move(void* from, void* to, size_t) override {
+        auto live_block = m_live_blocks.find(from);
+        assert(live_block != m_live_blocks.end());
+        live_block_t moved_block = live_block->second;
+        m_live_blocks.erase(live_block);
+        m_live_blocks[to] = moved_block;
+    }
+
+    void flush() {
+        if (!m_buffer.empty()) {
+            fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+            m_buffer.clear();
+        }
+        fflush(m_file);
+    }
+
+    uint64_t record_count() const {
+        return m_record_count;
+    }
+};
+
+//decodes a trace held in memory
+struct trace_reader_t {
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_position;
+
+    bool read_varint(uint64_t& value) {
+        value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (m_position == m_size) {
+                return false;
+            }
+            uint8_t byte = m_data[m_position++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    trace_reader_t(const uint8_t* data, size_t size) :
+        m_data(data),
+        m_size(size),
+        m_position(sizeof(k_trace_magic)) {
+    }
+
+    //false if the data does not start with the trace magic
+    bool valid() const {
+        return m_size >= sizeof(k_trace_magic) && memcmp(m_data, k_trace_magic, sizeof(k_trace_magic)) == 0;
+    }
+
+    //false at the end of the trace, or if the last record is cut off
+    bool next(trace_record_t& record) {
+        if (m_position == m_size) {
+            return false;
+        }
+        record.m_operation = static_cast<trace_operation_t>(m_data[m_position++]);
+        record.m_block = 0;
+        record.m_size = 0;
+        record.m_argument = 0;
+
+        uint64_t block = 0;
+        switch (record.m_operation) {
+        case trace_operation_t::allocate:
+            if (!read_varint(block) || !read_varint(record.m_size) || !read_varint(record.m_argument)) {
+                return false;
+            }
+            break;
+        case trace_operation_t::deallocate:
+            if (!read_varint(block) || !read_varint(record.m_size)) {
+                return false;
+            }
+            break;
+        case trace_operation_t::resize:
+            if (!read_varint(block) || !read_varint(record.m_argument) || !read_varint(record.m_size)) {
+                return false;
+            }
+            break;
+        case trace_operation_t::reset:
+            break;
+        default:
+            return false;
+        }
+        record.m_block = static_cast<uint32_t>(block);
+        return true;
+    }
+};
+
+/*
+    applies trace records to an allocator_template_t<Traits>::allocator_t, keeping the block of every id.
+    allocations the allocator cannot serve are counted and their id stays empty, later records for it are skipped.
+    a resize that cannot grow in place moves the block like reallocate does
+*/
+template<typename Traits>
+struct trace_replayer_t {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    allocator_t& m_allocator;
+    std::vector<void*> m_blocks;
+    std::vector<size_type_t> m_sizes;
+    //the alignment each block was allocated with, a block that has to move for a resize keeps it
+    std::vector<size_type_t> m_alignments;
+    uint64_t m_failed_allocations;
+
+    explicit trace_replayer_t(allocator_t& allocator) :
+        m_allocator(allocator),
+        m_blocks(),
+        m_sizes(),
+        m_alignments(),
+        m_failed_allocations(0) {
+    }
+
+    //returns the memory the record allocated (or moved a block to), nullptr otherwise
+    void* apply(const trace_record_t& record) {
+        if (record.m_operation == trace_operation_t::reset) {
+            m_allocator.reset();
+            m_blocks.assign(m_blocks.size(), nullptr);
+            return nullptr;
+        }
+        if (record.m_block >= m_blocks.size()) {
+            m_blocks.resize(record.m_block + 1, nullptr);
+            m_sizes.resize(record.m_block + 1, 0);
+            m_alignments.resize(record.m_block + 1, 1);
+        }
+        void*& block = m_blocks[record.m_block];
+        auto size = static_cast<size_type_t>(record.m_size);
+
+        switch (record.m_operation) {
+        case trace_operation_t::allocate:
+            block = record.m_argument > 1 ? m_allocator.try_allocate_aligned(size, static_cast<size_type_t>(record.m_argument)) : m_allocator.try_allocate(size);
+            m_sizes[record.m_block] = size;
+            m_alignments[record.m_block] = record.m_argument > 1 ? static_cast<size_type_t>(record.m_argument) : 1;
+            if (block == nullptr) {
+                ++m_failed_allocations;
+            }
+            return block;
+        case trace_operation_t::deallocate:
+            if (block != nullptr) {
+                m_allocator.deallocate(block, m_sizes[record.m_block]);
+                block = nullptr;
+            }
+            return nullptr;
+        case trace_operation_t::resize: {
+            if (block == nullptr) {
+                return nullptr;
+            }
+            size_type_t old_size = m_sizes[record.m_block];
+            m_sizes[record.m_block] = size;
+            if (size <= old_size) {
+                m_allocator.shrink(block, old_size, size);
+                return nullptr;
+            }
+            if (m_allocator.try_expand(block, old_size, size)) {
+                return block;
+            }
+            void* moved = m_allocator.try_allocate_aligned(size, m_alignments[record.m_block]);
+            if (moved == nullptr) {
+                ++m_failed_allocations;
+            }
+            else {
+                memcpy(moved, block, old_size);
+            }
+            m_allocator.deallocate(block, old_size);
+            block = moved;
+            return moved;
+        }
+        default:
+            return nullptr;
+        }
+    }
+};
@@ -1,29 +1,65 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstdio>
 #include <string>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <set>
 #include <cassert>
-#include <intrin.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <random>
 
 #define MINIALLOC_VERIFY    1
 
+//hardening checks throw in the tests, so a check that is expected to fail can be caught
+struct hardening_failure_t {
+    const char* m_message;
+};
+#define MINIALLOC_HARDENING_FAILURE(message) throw hardening_failure_t{ message }
+
 #include "../minialloc.hpp"
+#include "../minialloc_thread_cache.hpp"
+#include "../minialloc_memory_resource.hpp"
+#include "../minialloc_persistent.hpp"
+#include "../minialloc_slab.hpp"
+#include "../minialloc_growable.hpp"
+#include "../minialloc_relocatable.hpp"
+#include "../minialloc_purge.hpp"
+#include "../minialloc_trace.hpp"
+#include "../minialloc_numa.hpp"
+#include "../minialloc_profiler.hpp"
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../minialloc_shared.hpp"
+#endif
 
 static const char g_chartable[] = "abcdefghijklmnopqrstuvwxyz";
 
+//seeded from the command line, so a failing run can be repeated exactly
+static std::mt19937 g_random{ 1 };
+
+static uint16_t random_u16() {
+    return static_cast<uint16_t>(g_random() >> 16);
+}
+
 static std::string create_random_string() {
     std::string result{ };
 
     uint16_t length;
     do {
-        _rdrand16_step(&length);
+        length = random_u16();
         length &= 0x1f;
     } while (length == 0);
     for (unsigned i = 0; i < length; ++i) {
-        uint16_t currchar = 0;
-        _rdrand16_step(&currchar);
+        uint16_t currchar = random_u16();
         result.push_back(g_chartable[currchar % (sizeof(g_chartable) - 1)]);
     }
     return result;
@@ -48,7 +84,7 @@ static void test_allocator_template() {
     std::set<size_t> lengths_allocated{};
     uint16_t random_count = 0;
     do {
-        _rdrand16_step(&random_count);
+        random_count = random_u16();
 
         random_count %= 2048;
     } while (random_count == 0);
@@ -75,8 +111,7 @@ static void test_allocator_template() {
         uint32_t num_nodes_freed = 0;
         for (auto node_iter = current_strings.begin(); node_iter != current_strings.end(); ) {
 
-            uint16_t random_choice = 0;
-            _rdrand16_step(&random_choice);
+            uint16_t random_choice = random_u16();
 
             if ((random_choice & 1) || free_all) {
                 my_allocator.deallocate((void*)*node_iter,
@@ -118,33 +153,2109 @@ static void test_allocator_template() {
 
 }
 
-struct allocator_traits64_t {
-    using displacement_type_t = ptrdiff_t;
-    using size_type_t = size_t;
-    static constexpr size_t k_allocation_alignment = 1;
-    static constexpr bool k_use_absolute_pointers = false;
-};
+//a heap whose free memory is not on a size class boundary must still serve all of it in one allocation
+template<typename AllocatorTemplate>
+static void test_exact_fit() {
+    constexpr size_t memory_size = 1000064;
+    uint8_t* memory_pool_data = new uint8_t[memory_size];
 
-struct allocator_traits64_absolute_t {
-    using displacement_type_t = ptrdiff_t;
-    using size_type_t = size_t;
-    static constexpr size_t k_allocation_alignment = 1;
-    static constexpr bool k_use_absolute_pointers = true;
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
 
-};
+    allocator_t my_allocator{ memory_pool_data, memory_size, 2048 };
 
-struct allocator_traits32_t {
-    using displacement_type_t = int32_t;
-    using size_type_t = uint32_t;
-    static constexpr uint32_t k_allocation_alignment = 1;
-    static constexpr bool k_use_absolute_pointers = false;
-};
+    size_type_t largest = my_allocator.largest_free_region();
+    size_type_t exact_size = largest;
+    if constexpr (AllocatorTemplate::k_use_boundary_tags) {
+        //the block header, padded to the granularity of the blocks
+        exact_size -= (std::max)(static_cast<size_type_t>(AllocatorTemplate::k_imposed_alignment), static_cast<size_type_t>(sizeof(size_type_t)));
+    }
+    void* block = my_allocator.try_allocate(exact_size);
+    assert(block != nullptr && my_allocator.largest_free_region() < largest);
+    memset(block, 0x5a, exact_size);
+    my_allocator.deallocate(block, exact_size);
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+//requests that would wrap around size_type_t once rounded up fail instead of being served as tiny blocks
+template<typename AllocatorTemplate>
+static void test_oversized_requests() {
+    uint8_t* memory_pool_data = new uint8_t[256 * 1024];
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, 256 * 1024, 256 };
+
+    void* block = my_allocator.allocate(16);
+    for (size_type_t distance = 0; distance < 64; ++distance) {
+        size_type_t size = static_cast<size_type_t>(~static_cast<size_type_t>(0) - distance);
+        assert(my_allocator.try_allocate(size) == nullptr);
+        assert(!my_allocator.try_expand(block, 16, size));
+        assert(my_allocator.reallocate(block, 16, size) == nullptr);
+    }
+    //the aligned searches add the alignment to the size
+    for (size_type_t alignment : { 64, 4096 }) {
+        for (size_type_t distance = 0; distance < alignment + 128; distance += 8) {
+            size_type_t size = static_cast<size_type_t>(~static_cast<size_type_t>(0) - distance);
+            assert(my_allocator.try_allocate_aligned(size, alignment) == nullptr);
+        }
+    }
+    my_allocator.deallocate(block, 16);
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_aligned_allocations() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    struct aligned_block_t {
+        uint8_t* m_memory;
+        uint32_t m_size;
+        uint32_t m_alignment;
+    };
+
+    std::list<aligned_block_t> blocks{};
+
+    for (uint32_t round = 0; round < 4; ++round) {
+        for (uint32_t block_index = 0; block_index < 128; ++block_index) {
+            uint16_t random_value = random_u16();
+
+            //alignments from 16 bytes up to 4 KiB
+            uint32_t alignment = 16u << (random_value % 9);
+            uint32_t size = 1 + (random_value >> 4) % 512;
+
+            auto memory = static_cast<uint8_t*>(my_allocator.allocate_aligned(size, alignment));
+            assert((reinterpret_cast<uintptr_t>(memory) & (alignment - 1)) == 0);
+            memset(memory, static_cast<int>(size), size);
+            blocks.push_back({ memory, size, alignment });
+        }
+        my_allocator.validate_freelist();
+
+        for (auto block_iter = blocks.begin(); block_iter != blocks.end(); ) {
+            uint16_t random_choice = random_u16();
+
+            if ((random_choice & 1) || round == 3) {
+                for (uint32_t i = 0; i < block_iter->m_size; ++i) {
+                    assert(block_iter->m_memory[i] == static_cast<uint8_t>(block_iter->m_size));
+                }
+                my_allocator.deallocate_aligned(block_iter->m_memory, block_iter->m_size, block_iter->m_alignment);
+                block_iter = blocks.erase(block_iter);
+            }
+            else {
+                ++block_iter;
+            }
+        }
+        my_allocator.validate_freelist();
+        my_allocator.validate_nodepool();
+    }
+
+    //the padding in front of every block went back to the free list, so everything merges into one node again
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_batch_operations() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    constexpr uint32_t batch_size = 48;
+    std::list<std::pair<void*, size_type_t>> live_blocks{};
+
+    for (uint32_t round = 0; round < 16; ++round) {
+        size_type_t sizes[batch_size];
+        void* blocks[batch_size];
+
+        for (auto& size : sizes) {
+            uint16_t random_value = random_u16();
+            size = 1 + random_value % 300;
+        }
+        my_allocator.allocate_n(sizes, blocks, batch_size);
+
+        for (uint32_t block_index = 0; block_index < batch_size; ++block_index) {
+            memset(blocks[block_index], static_cast<int>(sizes[block_index]), sizes[block_index]);
+            live_blocks.push_back({ blocks[block_index], sizes[block_index] });
+        }
+
+        //free a random subset of everything allocated so far in one batch, in random order
+        void* free_blocks[batch_size * 16];
+        size_type_t free_sizes[batch_size * 16];
+        size_type_t free_count = 0;
+
+        for (auto block_iter = live_blocks.begin(); block_iter != live_blocks.end(); ) {
+            uint16_t random_choice = random_u16();
+
+            if ((random_choice & 1) || round == 15) {
+                auto memory = static_cast<uint8_t*>(block_iter->first);
+                for (size_type_t i = 0; i < block_iter->second; ++i) {
+                    assert(memory[i] == static_cast<uint8_t>(block_iter->second));
+                }
+                //insert at a random position so the batch is unsorted
+                size_type_t insert_at = free_count == 0 ? 0 : (random_choice >> 1) % (free_count + 1);
+                free_blocks[free_count] = free_blocks[insert_at];
+                free_sizes[free_count] = free_sizes[insert_at];
+                free_blocks[insert_at] = block_iter->first;
+                free_sizes[insert_at] = block_iter->second;
+                ++free_count;
+
+                block_iter = live_blocks.erase(block_iter);
+            }
+            else {
+                ++block_iter;
+            }
+        }
+        my_allocator.deallocate_batch(free_blocks, free_sizes, free_count);
+        my_allocator.validate_freelist();
+        my_allocator.validate_nodepool();
+    }
+
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_reallocation() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    //growable strings, each one is the same random letter repeated
+    struct growing_string_t {
+        char* m_data;
+        uint32_t m_length;
+        char m_letter;
+    };
+
+    std::vector<growing_string_t> strings{};
+    for (uint32_t string_index = 0; string_index < 64; ++string_index) {
+        auto data = static_cast<char*>(my_allocator.reallocate(nullptr, 0, 1));
+        char letter = g_chartable[string_index % (sizeof(g_chartable) - 1)];
+        data[0] = letter;
+        strings.push_back({ data, 1, letter });
+    }
+
+    for (uint32_t iteration = 0; iteration < 4096; ++iteration) {
+        uint16_t random_value = random_u16();
+
+        auto& str = strings[random_value % strings.size()];
+        uint32_t new_length;
+        if ((random_value >> 8) % 4 == 0) {
+            new_length = 1 + (str.m_length / 2);
+        }
+        else {
+            new_length = str.m_length + 1 + ((random_value >> 10) % 24);
+        }
+
+        str.m_data = static_cast<char*>(my_allocator.reallocate(str.m_data, str.m_length, new_length));
+        for (uint32_t i = 0; i < (std::min)(str.m_length, new_length); ++i) {
+            assert(str.m_data[i] == str.m_letter);
+        }
+        memset(str.m_data, str.m_letter, new_length);
+        str.m_length = new_length;
+    }
+
+    //neighboring strings block each other, so both the in place and the copying path get exercised
+    assert(my_allocator.in_place_reallocation_count() != 0);
+    assert(my_allocator.moved_reallocation_count() != 0);
+
+    for (auto& str : strings) {
+        for (uint32_t i = 0; i < str.m_length; ++i) {
+            assert(str.m_data[i] == str.m_letter);
+        }
+        if (str.m_length > 1 && my_allocator.try_expand(str.m_data, str.m_length, str.m_length + 8)) {
+            str.m_length += 8;
+        }
+        my_allocator.shrink(str.m_data, str.m_length, 1);
+        assert(my_allocator.reallocate(str.m_data, 1, 0) == nullptr);
+    }
+
+    //a try_expand that does not grow gives the tail back, freeing with the new size then loses nothing
+    auto block = static_cast<char*>(my_allocator.allocate(256));
+    assert(my_allocator.try_expand(block, 256, 32));
+    //a move that finds no room fails without touching the block
+    memset(block, 'x', 32);
+    assert(my_allocator.reallocate(block, 32, 4 * 1024 * 1024) == nullptr);
+    for (uint32_t i = 0; i < 32; ++i) {
+        assert(block[i] == 'x');
+    }
+    my_allocator.deallocate(block, 32);
+
+    my_allocator.validate_nodepool();
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_statistics() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    auto histogram_total = [](const uint64_t* histogram) {
+        uint64_t total = 0;
+        for (uint32_t bucket = 0; bucket < AllocatorTemplate::k_statistics_histogram_buckets; ++bucket) {
+            total += histogram[bucket];
+        }
+        return total;
+    };
+
+    auto initial = my_allocator.statistics();
+    assert(initial.m_bytes_in_use == 0 && initial.m_live_allocations == 0);
+    assert(initial.m_free_regions == 1 && initial.m_largest_free_region == initial.m_available_memory);
+    assert(initial.m_external_fragmentation == 0.0);
+
+    std::vector<std::pair<void*, size_type_t>> blocks{};
+    size_type_t bytes_allocated = 0;
+    for (uint32_t block_index = 0; block_index < 512; ++block_index) {
+        uint16_t random_value = random_u16();
+        size_type_t size = 1 + random_value % 200;
+
+        blocks.push_back({ my_allocator.allocate(size), size });
+        bytes_allocated += size;
+    }
+
+    auto after_allocating = my_allocator.statistics();
+    assert(after_allocating.m_live_allocations == 512);
+    assert(after_allocating.m_bytes_in_use == bytes_allocated);
+    assert(after_allocating.m_peak_bytes_in_use == bytes_allocated);
+    assert(histogram_total(after_allocating.m_allocate_scan_histogram) == 512);
+
+    //free every other block, each one becomes its own free region
+    size_type_t bytes_freed = 0;
+    for (size_t block_index = 0; block_index < blocks.size(); block_index += 2) {
+        my_allocator.deallocate(blocks[block_index].first, blocks[block_index].second);
+        bytes_freed += blocks[block_index].second;
+    }
+
+    auto fragmented = my_allocator.statistics();
+    assert(fragmented.m_live_allocations == 256);
+    assert(fragmented.m_bytes_in_use == bytes_allocated - bytes_freed);
+    assert(fragmented.m_peak_bytes_in_use == bytes_allocated);
+    assert(fragmented.m_free_regions == 257);
+    assert(fragmented.m_peak_nodes_in_use >= 257 && fragmented.m_peak_nodes_in_use <= fragmented.m_max_allocations);
+    assert(fragmented.m_largest_free_region < fragmented.m_available_memory);
+    assert(fragmented.m_external_fragmentation > 0.0 && fragmented.m_external_fragmentation < 1.0);
+    assert(histogram_total(fragmented.m_deallocate_walk_histogram) == 256);
+
+    for (size_t block_index = 1; block_index < blocks.size(); block_index += 2) {
+        my_allocator.deallocate(blocks[block_index].first, blocks[block_index].second);
+    }
+
+    auto drained = my_allocator.statistics();
+    assert(drained.m_live_allocations == 0 && drained.m_bytes_in_use == 0);
+    assert(drained.m_free_regions == 1 && drained.m_external_fragmentation == 0.0);
+
+    my_allocator.reset_statistics_peaks();
+    assert(my_allocator.statistics().m_peak_bytes_in_use == 0);
+    assert(histogram_total(my_allocator.statistics().m_allocate_scan_histogram) == 0);
+
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_reset_and_marks() {
+    //garbage on purpose, the pool nodes are only initialized when they are first handed out
+    uint8_t* memory_pool_data = new uint8_t[1024 * 1024];
+    memset(memory_pool_data, 0xCD, 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, 1024 * 1024, 1024 };
+
+    struct live_string_t {
+        char* m_data;
+        std::string m_expected;
+    };
+
+    auto allocate_strings = [&my_allocator](std::vector<live_string_t>& strings, uint32_t count) {
+        for (uint32_t string_index = 0; string_index < count; ++string_index) {
+            auto rand_str = create_random_string();
+            auto str_alloced = static_cast<char*>(my_allocator.allocate(static_cast<size_type_t>(rand_str.size() + 1)));
+            memcpy(str_alloced, rand_str.c_str(), rand_str.size() + 1);
+            strings.push_back({ str_alloced, rand_str });
+        }
+    };
+
+    auto check_strings = [](const std::vector<live_string_t>& strings) {
+        for (auto& str : strings) {
+            assert(str.m_expected == str.m_data);
+        }
+    };
+
+    //frees in the middle leave holes, reset forgets all of it
+    std::vector<live_string_t> strings{};
+    allocate_strings(strings, 512);
+    for (size_t string_index = 0; string_index < strings.size(); string_index += 3) {
+        my_allocator.deallocate(strings[string_index].m_data, static_cast<size_type_t>(strings[string_index].m_expected.size() + 1));
+    }
+    my_allocator.reset();
+    my_allocator.assert_is_in_initial_state();
+    my_allocator.validate_nodepool();
+    strings.clear();
+
+    //blocks from before the outer mark survive, everything after it goes away
+    allocate_strings(strings, 64);
+    auto outer_mark = my_allocator.mark();
+
+    std::vector<live_string_t> outer_strings{};
+    allocate_strings(outer_strings, 128);
+
+    auto inner_mark = my_allocator.mark();
+    std::vector<live_string_t> inner_strings{};
+    allocate_strings(inner_strings, 256);
+    check_strings(inner_strings);
+    //frees of blocks allocated since the mark are fine
+    for (size_t string_index = 0; string_index < inner_strings.size(); string_index += 4) {
+        my_allocator.deallocate(inner_strings[string_index].m_data, static_cast<size_type_t>(inner_strings[string_index].m_expected.size() + 1));
+    }
+    my_allocator.release_to(inner_mark);
+    check_strings(outer_strings);
+    assert(my_allocator.mark().m_frontier == inner_mark.m_frontier);
+
+    inner_strings.clear();
+    allocate_strings(inner_strings, 32);
+    check_strings(strings);
+    my_allocator.release_to(outer_mark);
+    assert(my_allocator.mark().m_frontier == outer_mark.m_frontier);
+    assert(my_allocator.mark().m_available_memory == outer_mark.m_available_memory);
+    check_strings(strings);
+
+    for (auto& str : strings) {
+        my_allocator.deallocate(str.m_data, static_cast<size_type_t>(str.m_expected.size() + 1));
+    }
+    my_allocator.assert_is_in_initial_state();
+    my_allocator.validate_nodepool();
+
+    //releasing to a mark taken on an empty heap is another reset
+    auto empty_mark = my_allocator.mark();
+    strings.clear();
+    allocate_strings(strings, 300);
+    my_allocator.release_to(empty_mark);
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_hardening() {
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+
+    uint8_t* memory_pool_data = new uint8_t[1024 * 1024];
+    auto allocator = new allocator_t{ memory_pool_data, 1024 * 1024, 1024 };
+
+    auto expect_failure = [](auto&& operation) {
+        bool failed = false;
+        try {
+            operation();
+        }
+        catch (const hardening_failure_t&) {
+            failed = true;
+        }
+        assert(failed);
+        (void)failed;
+    };
+
+    //correct use never trips a check, including the sampled validation with k_validation_interval
+    std::list<std::pair<char*, std::string>> strings{};
+    for (uint32_t string_index = 0; string_index < 2048; ++string_index) {
+        auto rand_str = create_random_string();
+        uint32_t length = static_cast<uint32_t>(rand_str.size()) + 1;
+        auto str_alloced = static_cast<char*>(allocator->allocate(length));
+        memcpy(str_alloced, rand_str.c_str(), length);
+        strings.push_back({ str_alloced, rand_str });
+
+        if ((string_index % 3) == 2) {
+            auto victim = std::next(strings.begin(), strings.size() / 2);
+            allocator->deallocate(victim->first, static_cast<uint32_t>(victim->second.size()) + 1);
+            strings.erase(victim);
+        }
+    }
+    allocator->check_integrity();
+
+    //a failed check leaves the heap untouched
+    auto first = allocator->allocate(200);
+    auto middle = allocator->allocate(200);
+    auto last = allocator->allocate(200);
+    allocator->deallocate(middle, 200);
+    expect_failure([&]() { allocator->deallocate(middle, 200); });
+    allocator->check_integrity();
+
+    if constexpr (AllocatorTemplate::k_size_tags) {
+        expect_failure([&]() { allocator->deallocate(first, 40); });
+        allocator->check_integrity();
+    }
+
+    if constexpr (AllocatorTemplate::k_use_boundary_tags) {
+        //an overrun into the header of the next block
+        auto next_header = static_cast<uint8_t*>(last) + allocator->allocation_size(last);
+        uint8_t saved_header[sizeof(size_t)];
+        memcpy(saved_header, next_header, sizeof(saved_header));
+        memset(next_header, 0x41, sizeof(saved_header));
+        expect_failure([&]() { allocator->check_integrity(); });
+        memcpy(next_header, saved_header, sizeof(saved_header));
+        allocator->check_integrity();
+    }
+
+    allocator->deallocate(first, 200);
+    allocator->deallocate(last, 200);
+    for (auto& str : strings) {
+        assert(str.second == str.first);
+        allocator->deallocate(str.first, static_cast<uint32_t>(str.second.size()) + 1);
+    }
+    allocator->check_integrity();
+    allocator->assert_is_in_initial_state();
+
+    delete allocator;
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_packed_best_fit() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    //holes of random sizes separated by live blocks, so none of them can merge
+    constexpr uint32_t hole_count = 256;
+    void* holes[hole_count];
+    size_type_t hole_sizes[hole_count];
+    void* separators[hole_count];
+    for (uint32_t hole_index = 0; hole_index < hole_count; ++hole_index) {
+        uint16_t random_value = random_u16();
+        hole_sizes[hole_index] = 16 + random_value % 4096;
+        holes[hole_index] = my_allocator.allocate(hole_sizes[hole_index]);
+        separators[hole_index] = my_allocator.allocate(16);
+    }
+    for (uint32_t hole_index = 0; hole_index < hole_count; ++hole_index) {
+        my_allocator.deallocate(holes[hole_index], hole_sizes[hole_index]);
+    }
+
+    void* allocations[64];
+    size_type_t allocation_sizes[64];
+    for (uint32_t request_index = 0; request_index < 64; ++request_index) {
+        uint16_t random_value = random_u16();
+        size_type_t request = 1 + random_value % 4096;
+
+        //the tightest hole, or the remainder of the heap behind the last separator if no hole fits
+        uint32_t best_hole = hole_count;
+        for (uint32_t hole_index = 0; hole_index < hole_count; ++hole_index) {
+            if (holes[hole_index] != nullptr && hole_sizes[hole_index] >= request &&
+                (best_hole == hole_count || hole_sizes[hole_index] < hole_sizes[best_hole])) {
+                best_hole = hole_index;
+            }
+        }
+
+        void* memory = my_allocator.allocate(request);
+        allocations[request_index] = memory;
+        allocation_sizes[request_index] = request;
+        my_allocator.validate_freelist();
+
+        if (best_hole == hole_count) {
+            assert(memory > separators[hole_count - 1]);
+            continue;
+        }
+        //holes of equal size are interchangeable
+        uint32_t used_hole = 0;
+        while (used_hole < hole_count && holes[used_hole] != memory) {
+            ++used_hole;
+        }
+        assert(used_hole < hole_count && hole_sizes[used_hole] == hole_sizes[best_hole]);
+
+        //whatever the allocation left of the hole stays free
+        hole_sizes[used_hole] -= request;
+        holes[used_hole] = hole_sizes[used_hole] == 0 ? nullptr : static_cast<uint8_t*>(memory) + request;
+    }
+    my_allocator.deallocate_batch(allocations, allocation_sizes, 64);
+
+    for (uint32_t hole_index = 0; hole_index < hole_count; ++hole_index) {
+        my_allocator.deallocate(separators[hole_index], 16);
+    }
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_lifetime_hints() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+    constexpr bool long_lived_by_default = AllocatorTemplate::k_default_lifetime == lifetime_t::long_lived;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+    size_type_t initial_largest = my_allocator.largest_free_region();
+
+    constexpr uint32_t block_count = 64;
+    void* transient_blocks[block_count];
+    size_type_t transient_sizes[block_count];
+    void* long_lived_blocks[block_count];
+    size_type_t long_lived_sizes[block_count];
+    size_type_t long_lived_total = 0;
+
+    //the two kinds grow towards each other, each long lived block right below the previous one
+    for (uint32_t block_index = 0; block_index < block_count; ++block_index) {
+        transient_sizes[block_index] = 1 + random_u16() % 4096;
+        long_lived_sizes[block_index] = 1 + random_u16() % 4096;
+        transient_blocks[block_index] = long_lived_by_default ?
+            my_allocator.allocate(transient_sizes[block_index], lifetime_t::transient) : my_allocator.allocate(transient_sizes[block_index]);
+        long_lived_blocks[block_index] = long_lived_by_default ?
+            my_allocator.allocate(long_lived_sizes[block_index]) : my_allocator.allocate(long_lived_sizes[block_index], lifetime_t::long_lived);
+        long_lived_total += long_lived_sizes[block_index];
+        my_allocator.validate_freelist();
+
+        if (block_index == 0) {
+            assert(static_cast<uint8_t*>(long_lived_blocks[0]) + long_lived_sizes[0] == memory_pool_data + 2 * 1024 * 1024);
+        }
+        else {
+            assert(static_cast<uint8_t*>(long_lived_blocks[block_index]) + long_lived_sizes[block_index] == long_lived_blocks[block_index - 1]);
+            assert(transient_blocks[block_index] > transient_blocks[block_index - 1]);
+        }
+        assert(static_cast<uint8_t*>(transient_blocks[block_index]) + transient_sizes[block_index] <= long_lived_blocks[block_index]);
+    }
+
+    //with the transient blocks gone, everything below the long lived ones is one region again
+    for (uint32_t block_index = 0; block_index < block_count; ++block_index) {
+        my_allocator.deallocate(transient_blocks[block_index], transient_sizes[block_index]);
+    }
+    assert(my_allocator.largest_free_region() == initial_largest - long_lived_total);
+
+    //a hole between long lived blocks is higher than the big region, so it serves a long lived request that fits
+    uint32_t hole_index = block_count / 2;
+    my_allocator.deallocate(long_lived_blocks[hole_index], long_lived_sizes[hole_index]);
+    size_type_t fitting_size = 1 + random_u16() % long_lived_sizes[hole_index];
+    void* fitting_block = my_allocator.allocate(fitting_size, lifetime_t::long_lived);
+    assert(static_cast<uint8_t*>(fitting_block) + fitting_size == static_cast<uint8_t*>(long_lived_blocks[hole_index]) + long_lived_sizes[hole_index]);
+    my_allocator.validate_freelist();
+
+    my_allocator.deallocate(fitting_block, fitting_size);
+    for (uint32_t block_index = 0; block_index < block_count; ++block_index) {
+        if (block_index != hole_index) {
+            my_allocator.deallocate(long_lived_blocks[block_index], long_lived_sizes[block_index]);
+        }
+    }
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_compact_nodes() {
+    constexpr uint32_t memory_size = 512 * 1024;
+    static_assert(memory_size <= AllocatorTemplate::k_max_compact_memory_size);
+    uint8_t* memory_pool_data = new uint8_t[memory_size];
+    memset(memory_pool_data, 0, memory_size);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, memory_size, 1024 };
+    size_type_t initial_available = my_allocator.available_memory();
+
+    //every block is filled with its slot index, a base or size that lost bits would hand out overlapping blocks
+    constexpr uint32_t slot_count = 256;
+    uint8_t* blocks[slot_count] = {};
+    size_type_t sizes[slot_count] = {};
+    size_type_t bytes_in_use = 0;
+    for (uint32_t step = 0; step < 4096; ++step) {
+        uint32_t slot = random_u16() % slot_count;
+        if (blocks[slot] != nullptr) {
+            for (size_type_t byte = 0; byte < sizes[slot]; ++byte) {
+                assert(blocks[slot][byte] == static_cast<uint8_t>(slot));
+            }
+            my_allocator.deallocate(blocks[slot], sizes[slot]);
+            bytes_in_use -= (sizes[slot] + 15) & ~static_cast<size_type_t>(15);
+            blocks[slot] = nullptr;
+            continue;
+        }
+        uint16_t random_value = random_u16();
+        sizes[slot] = 1 + random_value % 4096;
+        blocks[slot] = static_cast<uint8_t*>(my_allocator.allocate(sizes[slot], random_value & 1 ? lifetime_t::long_lived : lifetime_t::transient));
+        memset(blocks[slot], static_cast<uint8_t>(slot), sizes[slot]);
+        bytes_in_use += (sizes[slot] + 15) & ~static_cast<size_type_t>(15);
+        assert(my_allocator.available_memory() == initial_available - bytes_in_use);
+        if ((step & 63) == 0) {
+            my_allocator.validate_freelist();
+        }
+    }
+
+    for (uint32_t slot = 0; slot < slot_count; ++slot) {
+        if (blocks[slot] != nullptr) {
+            my_allocator.deallocate(blocks[slot], sizes[slot]);
+        }
+    }
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_boundary_tags() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024 };
+
+    //far more blocks than a node pool of any reasonable size could describe once every other one is freed
+    constexpr uint32_t block_count = 8192;
+    std::vector<uint8_t*> blocks(block_count);
+    for (uint32_t block_index = 0; block_index < block_count; ++block_index) {
+        uint16_t random_value = random_u16();
+        uint32_t size = 1 + random_value % 24;
+
+        blocks[block_index] = static_cast<uint8_t*>(my_allocator.allocate(size));
+        memset(blocks[block_index], static_cast<int>(block_index), size);
+    }
+    for (uint32_t block_index = 0; block_index < block_count; block_index += 2) {
+        my_allocator.deallocate(blocks[block_index]);
+    }
+    my_allocator.validate_freelist();
+
+    //freeing the rest in random order merges each block with one or both neighbors
+    for (uint32_t block_index = block_count / 2; block_index > 1; --block_index) {
+        uint16_t random_value = random_u16();
+        std::swap(blocks[2 * block_index - 1], blocks[2 * (random_value % block_index) + 1]);
+    }
+    for (uint32_t block_index = 1; block_index < block_count; block_index += 2) {
+        my_allocator.deallocate(blocks[block_index]);
+    }
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename AllocatorTemplate>
+static void test_sizeless_deallocation() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename AllocatorTemplate::allocator_t;
+    using size_type_t = typename AllocatorTemplate::size_type_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    std::vector<std::pair<uint8_t*, size_type_t>> blocks{};
+    for (uint32_t round = 0; round < 4; ++round) {
+        for (uint32_t block_index = 0; block_index < 256; ++block_index) {
+            uint16_t random_value = random_u16();
+            size_type_t size = 1 + random_value % 700;
+
+            uint8_t* memory;
+            if (random_value & 0x8000) {
+                memory = static_cast<uint8_t*>(my_allocator.allocate_aligned(size, 64));
+            }
+            else {
+                memory = static_cast<uint8_t*>(my_allocator.allocate(size));
+            }
+            memset(memory, static_cast<int>(size), size);
+            assert(my_allocator.allocation_size(memory) >= size);
+            blocks.push_back({ memory, size });
+        }
+
+        //grow and shrink some blocks in place or by moving, the recorded sizes must follow
+        for (auto& block : blocks) {
+            uint16_t random_value = random_u16();
+            if ((random_value & 3) == 0) {
+                size_type_t new_size = 1 + random_value % 900;
+                block.first = static_cast<uint8_t*>(my_allocator.reallocate(block.first, block.second, new_size));
+                memset(block.first, static_cast<int>(new_size), new_size);
+                block.second = new_size;
+                assert(my_allocator.allocation_size(block.first) >= new_size);
+            }
+        }
+
+        //free about half without telling the allocator how large the blocks are
+        for (auto block_iter = blocks.begin(); block_iter != blocks.end(); ) {
+            uint16_t random_choice = random_u16();
+
+            if ((random_choice & 1) || round == 3) {
+                for (size_type_t i = 0; i < block_iter->second; ++i) {
+                    assert(block_iter->first[i] == static_cast<uint8_t>(block_iter->second));
+                }
+                my_allocator.deallocate(block_iter->first);
+                block_iter = blocks.erase(block_iter);
+            }
+            else {
+                ++block_iter;
+            }
+        }
+        my_allocator.validate_freelist();
+        my_allocator.validate_nodepool();
+    }
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename Traits>
+static void test_memory_resource() {
+    uint8_t* memory_pool_data = new uint8_t[2 * 1024 * 1024];
+    memset(memory_pool_data, 0, 2 * 1024 * 1024);
+
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+
+    allocator_t my_allocator{ memory_pool_data, 2 * 1024 * 1024, 2048 };
+
+    struct alignas(64) cache_line_t {
+        uint32_t m_values[16];
+    };
+
+    {
+        allocator_memory_resource_t<Traits> resource{ my_allocator };
+
+        std::pmr::vector<uint32_t> numbers{ &resource };
+        std::pmr::unordered_map<uint32_t, std::pmr::string> names{ &resource };
+        std::pmr::vector<cache_line_t> lines{ &resource };
+
+        for (uint32_t i = 0; i < 512; ++i) {
+            numbers.push_back(i);
+            names.emplace(i, create_random_string());
+            lines.push_back(cache_line_t{ { i } });
+            assert((reinterpret_cast<uintptr_t>(lines.data()) & 63) == 0);
+        }
+        for (uint32_t i = 0; i < 512; i += 2) {
+            names.erase(i);
+        }
+        for (uint32_t i = 0; i < 512; ++i) {
+            assert(numbers[i] == i && lines[i].m_values[0] == i);
+            assert(names.count(i) == (i & 1));
+        }
+
+        //the typed adapter, rebound by the containers to their node types
+        using adapter_t = allocator_adapter_t<uint32_t, Traits>;
+        std::map<uint32_t, uint32_t, std::less<uint32_t>, allocator_adapter_t<std::pair<const uint32_t, uint32_t>, Traits>> squares{
+            allocator_adapter_t<std::pair<const uint32_t, uint32_t>, Traits>{ my_allocator } };
+        std::vector<uint32_t, adapter_t> copies{ adapter_t{ my_allocator } };
+        for (uint32_t i = 0; i < 512; ++i) {
+            squares.emplace(i, i * i);
+            copies.push_back(numbers[i]);
+        }
+        assert(squares.size() == 512 && copies.back() == 511);
+        assert(adapter_t{ my_allocator } == squares.get_allocator());
+
+        //a request larger than the heap throws instead of asserting
+        bool resource_threw = false, adapter_threw = false;
+        try {
+            (void)resource.allocate(4 * 1024 * 1024, 16);
+        }
+        catch (const std::bad_alloc&) {
+            resource_threw = true;
+        }
+        try {
+            adapter_t{ my_allocator }.allocate(1024 * 1024);
+        }
+        catch (const std::bad_alloc&) {
+            adapter_threw = true;
+        }
+        assert(resource_threw && adapter_threw);
+
+        //so does one that would wrap around size_type_t once the allocator rounds it up
+        using size_type_t = typename Traits::size_type_t;
+        for (size_t alignment : { 16, 64, 4096 }) {
+            for (size_t distance = 0; distance < alignment + 64; distance += 8) {
+                resource_threw = false;
+                try {
+                    (void)resource.allocate(static_cast<size_t>((std::numeric_limits<size_type_t>::max)()) - distance, alignment);
+                }
+                catch (const std::bad_alloc&) {
+                    resource_threw = true;
+                }
+                assert(resource_threw);
+            }
+        }
+        my_allocator.validate_freelist();
+    }
+    my_allocator.assert_is_in_initial_state();
+
+    delete[] memory_pool_data;
+}
+
+template<typename Traits>
+struct toggled_size_table_traits_t : Traits {
+    static constexpr bool k_track_allocation_sizes = !allocator_template_t<Traits>::k_track_allocation_sizes;
+};
+
+template<typename Traits>
+struct toggled_node_scale_traits_t : Traits {
+    static constexpr bool k_scale_node_fields = !allocator_template_t<Traits>::k_scale_node_fields;
+};
+
+template<typename Traits>
+static void test_persistent_heap() {
+    using persistent_t = persistent_allocator_template_t<Traits>;
+    using allocator_t = typename persistent_t::backing_allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    constexpr size_type_t region_size = 1024 * 1024;
+    constexpr uint32_t string_count = 256;
+
+    //the root is a table of string displacements from the region, raw pointers would not survive moving it
+    struct string_table_t {
+        uint32_t m_count;
+        uint32_t m_strings[string_count];
+    };
+
+    auto fill_heap = [](uint8_t* region, allocator_t* allocator) {
+        auto table = static_cast<string_table_t*>(allocator->allocate_aligned(sizeof(string_table_t), alignof(string_table_t)));
+        table->m_count = string_count;
+        for (uint32_t string_index = 0; string_index < string_count; ++string_index) {
+            auto rand_str = create_random_string();
+            auto memory = static_cast<char*>(allocator->allocate(static_cast<size_type_t>(rand_str.size() + 1)));
+            memcpy(memory, rand_str.c_str(), rand_str.size() + 1);
+            table->m_strings[string_index] = static_cast<uint32_t>(reinterpret_cast<uint8_t*>(memory) - region);
+        }
+        persistent_t::set_root(region, table);
+    };
+
+    auto check_and_empty_heap = [](uint8_t* region, allocator_t* allocator, const std::vector<std::string>& expected) {
+        auto table = static_cast<string_table_t*>(persistent_t::root(region));
+        assert(table != nullptr && table->m_count == string_count);
+        for (uint32_t string_index = 0; string_index < string_count; ++string_index) {
+            auto str = reinterpret_cast<const char*>(region + table->m_strings[string_index]);
+            assert(expected[string_index] == str);
+            allocator->deallocate(const_cast<char*>(str), static_cast<size_type_t>(strlen(str) + 1));
+        }
+        allocator->deallocate_aligned(table, sizeof(string_table_t), alignof(string_table_t));
+        persistent_t::set_root(region, nullptr);
+        allocator->assert_is_in_initial_state();
+    };
+
+    auto snapshot_strings = [](uint8_t* region) {
+        auto table = static_cast<string_table_t*>(persistent_t::root(region));
+        std::vector<std::string> strings{};
+        for (uint32_t string_index = 0; string_index < table->m_count; ++string_index) {
+            strings.push_back(reinterpret_cast<const char*>(region + table->m_strings[string_index]));
+        }
+        return strings;
+    };
+
+    uint8_t* first_buffer = static_cast<uint8_t*>(operator new(region_size, std::align_val_t{ 64 }));
+    uint8_t* second_buffer = static_cast<uint8_t*>(operator new(region_size, std::align_val_t{ 64 }));
+
+    auto allocator = persistent_t::create(first_buffer, region_size, 1024);
+    fill_heap(first_buffer, allocator);
+    auto expected = snapshot_strings(first_buffer);
+
+    //a heap that was never detached is refused
+    memcpy(second_buffer, first_buffer, region_size);
+    allocator_t* attached = nullptr;
+    assert(persistent_t::attach(second_buffer, region_size, attached) == persistent_attach_result_t::not_closed_cleanly);
+    assert(attached == nullptr);
+
+    //move the heap to another address and reopen it there
+    persistent_t::detach(first_buffer);
+    memcpy(second_buffer, first_buffer, region_size);
+    memset(first_buffer, 0xCD, region_size);
+
+    assert(persistent_t::attach(second_buffer, region_size - 64, attached) == persistent_attach_result_t::size_mismatch);
+    assert(persistent_t::attach(second_buffer + 64, region_size - 64, attached) == persistent_attach_result_t::bad_magic);
+    assert(persistent_t::attach(second_buffer, region_size, attached) == persistent_attach_result_t::attached);
+    check_and_empty_heap(second_buffer, attached, expected);
+    persistent_t::detach(second_buffer);
+
+    //different traits lay the heap out differently
+    using other_persistent_t = persistent_allocator_template_t<toggled_size_table_traits_t<Traits>>;
+    typename other_persistent_t::backing_allocator_t* other_allocator = nullptr;
+    assert(other_persistent_t::attach(second_buffer, region_size, other_allocator) == persistent_attach_result_t::layout_mismatch);
+
+    //scaled and unscaled compact fields give nodes of the same size whose fields mean different things
+    if constexpr (allocator_template_t<Traits>::k_compact_nodes) {
+        using unscaled_persistent_t = persistent_allocator_template_t<toggled_node_scale_traits_t<Traits>>;
+        static_assert(sizeof(typename allocator_template_t<toggled_node_scale_traits_t<Traits>>::allocation_node_t) ==
+            sizeof(typename allocator_template_t<Traits>::allocation_node_t));
+        typename unscaled_persistent_t::backing_allocator_t* unscaled_allocator = nullptr;
+        assert(unscaled_persistent_t::attach(second_buffer, region_size, unscaled_allocator) == persistent_attach_result_t::layout_mismatch);
+    }
+
+    //the same round trip through a file, one per process so that ctest can run the seeds in parallel
+#if defined(_WIN32)
+    std::string file_name = "minialloc_persistent_test_" + std::to_string(_getpid()) + ".heap";
+#else
+    std::string file_name = "minialloc_persistent_test_" + std::to_string(getpid()) + ".heap";
+#endif
+    const char* path = file_name.c_str();
+    std::remove(path);
+    {
+        typename persistent_t::mapped_file_t file{};
+        bool opened = file.open(path, region_size);
+        assert(opened);
+        assert(persistent_t::open_or_create(file, 1024, allocator) == persistent_attach_result_t::created);
+        fill_heap(file.m_memory, allocator);
+        expected = snapshot_strings(file.m_memory);
+        persistent_t::close(file);
+    }
+    {
+        typename persistent_t::mapped_file_t file{};
+        bool opened = file.open(path, region_size);
+        assert(opened && !file.m_created && file.m_size == region_size);
+        assert(persistent_t::open_or_create(file, 1024, allocator) == persistent_attach_result_t::attached);
+        check_and_empty_heap(file.m_memory, allocator, expected);
+        persistent_t::close(file);
+    }
+    std::remove(path);
+
+    operator delete(first_buffer, std::align_val_t{ 64 });
+    operator delete(second_buffer, std::align_val_t{ 64 });
+}
+
+#if !defined(_WIN32)
+template<typename Traits>
+static void test_shared_heap() {
+    using shared_t = shared_allocator_template_t<Traits>;
+    using size_type_t = typename Traits::size_type_t;
+
+    constexpr size_t segment_size = 4 * 1024 * 1024;
+    constexpr uint32_t worker_count = 4;
+    constexpr uint32_t worker_steps = 2000;
+
+    typename shared_t::shared_segment_t segment{};
+    bool created = segment.create(nullptr, segment_size);
+    assert(created);
+    shared_t::allocator_t::format(segment.m_memory, segment_size, 8192);
+    typename shared_t::allocator_t allocator{ segment.m_memory };
+
+    //blocks that live through the whole test, recovery must not lose them
+    std::vector<shared_handle_t> parent_blocks{};
+    for (uint32_t block_index = 0; block_index < 64; ++block_index) {
+        auto memory = allocator.allocate(100 + block_index);
+        memset(memory, static_cast<int>(block_index), 100 + block_index);
+        parent_blocks.push_back(allocator.to_handle(memory));
+    }
+
+    std::vector<pid_t> workers{};
+    for (uint32_t worker_index = 0; worker_index < worker_count; ++worker_index) {
+        pid_t worker = fork();
+        assert(worker >= 0);
+        if (worker != 0) {
+            workers.push_back(worker);
+            continue;
+        }
+
+        //every worker maps the segment again at its own address
+        typename shared_t::shared_segment_t mapping{};
+        if (!mapping.open_descriptor(segment.m_descriptor)) {
+            _exit(1);
+        }
+        typename shared_t::allocator_t worker_allocator{ mapping.m_memory };
+
+        //the first worker dies holding the lock, halfway through an allocation
+        if (worker_index == 0) {
+            worker_allocator.debug_exit_during_allocate(256);
+        }
+
+        struct live_block_t {
+            shared_handle_t m_handle;
+            size_type_t m_size;
+            uint8_t m_pattern;
+        };
+        std::vector<live_block_t> live{};
+
+        auto check_and_free = [&](size_t live_index) {
+            auto memory = static_cast<uint8_t*>(worker_allocator.from_handle(live[live_index].m_handle));
+            for (size_type_t byte_index = 0; byte_index < live[live_index].m_size; ++byte_index) {
+                if (memory[byte_index] != live[live_index].m_pattern) {
+                    _exit(3);
+                }
+            }
+            worker_allocator.deallocate(memory);
+            live[live_index] = live.back();
+            live.pop_back();
+        };
+
+        for (uint32_t step = 0; step < worker_steps; ++step) {
+            uint16_t random_value = random_u16();
+            if (live.empty() || random_value % 3 != 0) {
+                size_type_t size = 1 + random_value % 512;
+                auto memory = worker_allocator.allocate(size);
+                if (memory == nullptr) {
+                    _exit(2);
+                }
+                uint8_t pattern = static_cast<uint8_t>(worker_index * 64 + step);
+                memset(memory, pattern, size);
+                live.push_back({ worker_allocator.to_handle(memory), size, pattern });
+            }
+            else {
+                check_and_free(random_value % live.size());
+            }
+        }
+        while (!live.empty()) {
+            check_and_free(live.size() - 1);
+        }
+        _exit(0);
+    }
+
+    for (pid_t worker : workers) {
+        int status = 0;
+        waitpid(worker, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    for (uint32_t block_index = 0; block_index < 64; ++block_index) {
+        auto memory = static_cast<uint8_t*>(allocator.from_handle(parent_blocks[block_index]));
+        for (uint32_t byte_index = 0; byte_index < 100 + block_index; ++byte_index) {
+            assert(memory[byte_index] == block_index);
+        }
+        allocator.deallocate(memory);
+    }
+
+    //the allocation the dead worker was making is rolled back, nothing else is left
+    assert(allocator.recovery_count() == 1);
+    bool locked = allocator.with_backing_allocator([](typename shared_t::backing_allocator_t& backing_allocator) {
+        backing_allocator.assert_is_in_initial_state();
+    });
+    assert(locked);
+
+    //an owner that dies and a next one that unlocks without recovering leave the mutex unrecoverable
+    auto& segment_lock = reinterpret_cast<typename shared_t::segment_header_t*>(segment.m_memory)->m_lock;
+    pid_t holder = fork();
+    assert(holder >= 0);
+    if (holder == 0) {
+        pthread_mutex_lock(&segment_lock);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(holder, &status, 0);
+    int lock_result = pthread_mutex_lock(&segment_lock);
+    assert(lock_result == EOWNERDEAD);
+    (void)lock_result;
+    pthread_mutex_unlock(&segment_lock);
+    assert(allocator.allocate(64) == nullptr);
+    locked = allocator.with_backing_allocator([](typename shared_t::backing_allocator_t&) {});
+    assert(!locked);
+    (void)locked;
+}
+#endif
+
+//hands out 64 byte aligned heap memory and counts what is outstanding
+struct counting_region_provider_t {
+    size_t* m_mapped_bytes;
+
+    void* map_region(size_t region_size) {
+        *m_mapped_bytes += region_size;
+        return operator new(region_size, std::align_val_t{ 64 });
+    }
+
+    void unmap_region(void* memory, size_t region_size) {
+        *m_mapped_bytes -= region_size;
+        operator delete(memory, std::align_val_t{ 64 });
+    }
+};
+
+template<typename Traits>
+static void test_growable_heap() {
+    using growable_t = growable_allocator_template_t<Traits, counting_region_provider_t>;
+    using size_type_t = typename Traits::size_type_t;
+
+    size_t mapped_bytes = 0;
+    {
+        typename growable_t::allocator_t allocator{ 64 * 1024, 256, counting_region_provider_t{ &mapped_bytes } };
+
+        std::list<std::pair<char*, std::string>> strings{};
+        for (uint32_t string_index = 0; string_index < 4096; ++string_index) {
+            auto rand_str = create_random_string();
+            //some strings are larger than the first region
+            if ((string_index % 509) == 0) {
+                rand_str.append(96 * 1024, 'x');
+            }
+            auto str_alloced = static_cast<char*>(allocator.allocate(static_cast<size_type_t>(rand_str.size() + 1)));
+            assert(str_alloced != nullptr);
+            memcpy(str_alloced, rand_str.c_str(), rand_str.size() + 1);
+            strings.push_back({ str_alloced, rand_str });
+
+            if ((string_index % 4) == 3) {
+                auto victim = std::next(strings.begin(), strings.size() / 3);
+                allocator.deallocate(victim->first, static_cast<size_type_t>(victim->second.size() + 1));
+                strings.erase(victim);
+            }
+        }
+        assert(allocator.region_count() > 1);
+        for (uint32_t region_index = 1; region_index < allocator.region_count(); ++region_index) {
+            assert(allocator.region(region_index - 1).m_memory < allocator.region(region_index).m_memory);
+        }
+
+        auto aligned = allocator.allocate_aligned(100, 256);
+        assert((reinterpret_cast<uintptr_t>(aligned) & 255) == 0);
+        allocator.deallocate_aligned(aligned, 100, 256);
+
+        for (auto& str : strings) {
+            assert(str.second == str.first);
+            allocator.region_allocator_of(str.first).validate_freelist();
+            allocator.deallocate(str.first, static_cast<size_type_t>(str.second.size() + 1));
+        }
+
+        if constexpr (growable_t::k_release_empty_regions) {
+            assert(allocator.region_count() == 0 && mapped_bytes == 0);
+        }
+        else {
+            for (uint32_t region_index = 0; region_index < allocator.region_count(); ++region_index) {
+                assert(allocator.region(region_index).m_live_allocations == 0);
+                allocator.region(region_index).allocator()->assert_is_in_initial_state();
+            }
+        }
+    }
+    assert(mapped_bytes == 0);
+}
+
+template<typename RelocatableTemplate>
+static void test_relocatable_heap() {
+    using relocatable_allocator_t = typename RelocatableTemplate::allocator_t;
+    using handle_t = typename RelocatableTemplate::handle_t;
+
+    constexpr uint32_t memory_size = 256 * 1024;
+    uint8_t* memory_pool_data = new uint8_t[memory_size];
+    auto allocator = new relocatable_allocator_t{ memory_pool_data, memory_size, 2048 };
+
+    std::vector<std::pair<handle_t, std::string>> strings{};
+    for (uint32_t string_index = 0; string_index < 2048; ++string_index) {
+        auto rand_str = create_random_string();
+        rand_str.append(32 + string_index % 61, 'x');
+        handle_t handle = allocator->allocate(static_cast<uint32_t>(rand_str.size() + 1));
+        if (handle == RelocatableTemplate::k_null_handle) {
+            break;
+        }
+        memcpy(allocator->resolve(handle), rand_str.c_str(), rand_str.size() + 1);
+        strings.push_back({ handle, rand_str });
+    }
+
+    //free every other string, which leaves the heap full of small holes
+    std::vector<std::pair<handle_t, std::string>> survivors{};
+    for (size_t string_index = 0; string_index < strings.size(); ++string_index) {
+        if ((string_index & 1) == 0) {
+            allocator->deallocate(strings[string_index].first);
+        }
+        else {
+            survivors.push_back(strings[string_index]);
+        }
+    }
+    assert(allocator->fragmentation() > 0.4);
+
+    //a pinned block must stay where it is
+    handle_t pinned = survivors[survivors.size() / 2].first;
+    void* pinned_memory = allocator->pin(pinned);
+
+    //small steps, the largest free block only grows
+    size_t largest_free = allocator->backing_allocator().largest_free_region();
+    uint32_t step_count = 0;
+    while (allocator->maybe_compact(512) != 0) {
+        size_t now_largest = allocator->backing_allocator().largest_free_region();
+        assert(now_largest >= largest_free);
+        largest_free = now_largest;
+        allocator->backing_allocator().validate_freelist();
+        ++step_count;
+    }
+    assert(step_count > 1);
+    assert(allocator->resolve(pinned) == pinned_memory);
+    allocator->unpin(pinned);
+
+    for (auto& str : survivors) {
+        assert(str.second == static_cast<const char*>(allocator->resolve(str.first)));
+    }
+
+    //fragment the heap again, a block that fits in no hole makes allocate compact on its own
+    std::vector<std::pair<handle_t, std::string>> remaining{};
+    for (size_t string_index = 0; string_index < survivors.size(); ++string_index) {
+        if ((string_index & 1) == 0) {
+            allocator->deallocate(survivors[string_index].first);
+        }
+        else {
+            remaining.push_back(survivors[string_index]);
+        }
+    }
+    survivors.swap(remaining);
+    uint32_t largest_hole = static_cast<uint32_t>(allocator->backing_allocator().largest_free_region());
+    uint32_t big_size = largest_hole + static_cast<uint32_t>(allocator->backing_allocator().available_memory() - largest_hole) / 2;
+    handle_t big = allocator->allocate(big_size);
+    assert(big != RelocatableTemplate::k_null_handle);
+    assert(allocator->allocation_size(big) == big_size);
+    memset(allocator->resolve(big), 0xAB, big_size);
+    for (auto& str : survivors) {
+        assert(str.second == static_cast<const char*>(allocator->resolve(str.first)));
+        allocator->deallocate(str.first);
+    }
+    allocator->deallocate(big);
+    allocator->backing_allocator().validate_freelist();
+
+    delete allocator;
+    delete[] memory_pool_data;
+}
+
+template<typename PurgingTemplate>
+static void test_purging_heap() {
+    using purging_allocator_t = typename PurgingTemplate::allocator_t;
+
+    uint8_t* memory_pool_data = new uint8_t[16 * 1024 * 1024];
+    auto allocator = new purging_allocator_t{ memory_pool_data, 16 * 1024 * 1024, 1024 };
+    size_t block_size = 64 * allocator->page_size();
+
+    std::vector<uint8_t*> blocks{};
+    for (uint32_t block_index = 0; block_index < 24; ++block_index) {
+        auto block = static_cast<uint8_t*>(allocator->allocate(block_size));
+        memset(block, static_cast<int>(block_index + 1), block_size);
+        blocks.push_back(block);
+    }
+    auto check_block = [&](uint32_t block_index) {
+        for (size_t byte_index = 0; byte_index < block_size; byte_index += 512) {
+            assert(blocks[block_index][byte_index] == static_cast<uint8_t>(block_index + 1));
+        }
+    };
+
+    //nothing was freed during this epoch, the untouched rest of the heap goes right away
+    size_t resident = allocator->resident_bytes();
+    size_t released = allocator->decay_epoch();
+    assert(released > 0 && allocator->resident_bytes() == resident - released);
+    assert(allocator->purged_bytes() >= released);
+
+    for (uint32_t block_index = 0; block_index < 24; block_index += 2) {
+        allocator->deallocate(blocks[block_index], block_size);
+    }
+    //freed blocks get one whole epoch before they are purged
+    resident = allocator->resident_bytes();
+    assert(allocator->decay_epoch() == 0);
+    released = allocator->decay_epoch();
+    assert(released >= 12 * (block_size - 2 * allocator->page_size()));
+    assert(allocator->resident_bytes() == resident - released);
+    for (uint32_t block_index = 1; block_index < 24; block_index += 2) {
+        check_block(block_index);
+    }
+
+    //reused pages are counted as resident again
+    resident = allocator->resident_bytes();
+    for (uint32_t block_index = 0; block_index < 24; block_index += 2) {
+        blocks[block_index] = static_cast<uint8_t*>(allocator->allocate(block_size));
+        memset(blocks[block_index], static_cast<int>(block_index + 1), block_size);
+    }
+    assert(allocator->resident_bytes() > resident);
+    for (uint32_t block_index = 0; block_index < 24; ++block_index) {
+        check_block(block_index);
+    }
+
+    if constexpr (PurgingTemplate::k_huge_page_alignment) {
+        auto huge_block = allocator->allocate(3 * 1024 * 1024);
+        assert((reinterpret_cast<uintptr_t>(huge_block) & (PurgingTemplate::k_huge_page_size - 1)) == 0);
+        memset(huge_block, 0x5A, 3 * 1024 * 1024);
+        allocator->deallocate(huge_block, 3 * 1024 * 1024);
+    }
+
+    for (auto block : blocks) {
+        allocator->deallocate(block, block_size);
+    }
+    allocator->purge_all();
+    //only the node pool and the page bitmaps are left
+    assert(allocator->resident_bytes() < 32 * allocator->page_size());
+
+    if constexpr (PurgingTemplate::k_purge_decay_operations != 0) {
+        //a block that is reused within every epoch is never released
+        uint64_t release_calls = allocator->release_calls();
+        for (uint32_t operation_index = 0; operation_index < 4 * PurgingTemplate::k_purge_decay_operations; operation_index += 2) {
+            auto block = allocator->allocate(block_size);
+            memset(block, 0x33, block_size);
+            allocator->deallocate(block, block_size);
+        }
+        assert(allocator->release_calls() == release_calls);
+        allocator->decay_epoch();
+        assert(allocator->release_calls() > release_calls);
+    }
+    allocator->backing_allocator().validate_freelist();
+
+    delete allocator;
+    delete[] memory_pool_data;
+}
+
+template<typename Traits>
+static void test_trace_roundtrip() {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    uint8_t* memory_pool_data = new uint8_t[1024 * 1024];
+    auto allocator = new allocator_t{ memory_pool_data, 1024 * 1024, 1024 };
+
+    FILE* trace_file = tmpfile();
+    auto writer = new trace_writer_t{ trace_file };
+    allocator->set_recorder(writer);
+
+    std::vector<std::pair<void*, size_type_t>> blocks{};
+    uint32_t allocations = 0;
+    uint32_t deallocations = 0;
+
+    //the heap has no holes yet, as release_to requires. it is recorded as the deallocation of every block above the mark
+    auto mark = allocator->mark();
+    for (uint32_t block_index = 0; block_index < 8; ++block_index) {
+        allocator->allocate(256);
+        ++allocations;
+    }
+    allocator->release_to(mark);
+    deallocations += 8;
+
+    for (uint32_t block_index = 0; block_index < 256; ++block_index) {
+        uint16_t random_value = random_u16();
+        auto block_size = static_cast<size_type_t>(16 + random_value % 2048);
+        void* block = block_index % 16 == 0 ? allocator->allocate_aligned(block_size, 128) : allocator->allocate(block_size);
+        blocks.push_back({ block, block_size });
+        ++allocations;
+    }
+    for (uint32_t block_index = 0; block_index < 256; block_index += 3) {
+        allocator->deallocate(blocks[block_index].first, blocks[block_index].second);
+        blocks[block_index].first = nullptr;
+        ++deallocations;
+    }
+    uint32_t resizes = 0;
+    for (uint32_t block_index = 1; block_index < 256; block_index += 3) {
+        auto& block = blocks[block_index];
+        if (block_index % 2 == 0) {
+            allocator->shrink(block.first, block.second, block.second / 2);
+            block.second /= 2;
+            ++resizes;
+        }
+        else if (allocator->try_expand(block.first, block.second, block.second + 64)) {
+            block.second += 64;
+            ++resizes;
+        }
+    }
+
+    size_type_t available_memory = allocator->available_memory();
+    size_type_t largest_free_region = allocator->largest_free_region();
+    allocator->reset();
+    size_type_t reset_available_memory = allocator->available_memory();
+    writer->flush();
+    assert(writer->record_count() == allocations + deallocations + resizes + 1);
+    delete writer;
+    delete allocator;
+
+    std::vector<uint8_t> trace(static_cast<size_t>(ftell(trace_file)));
+    rewind(trace_file);
+    size_t read_size = fread(trace.data(), 1, trace.size(), trace_file);
+    assert(read_size == trace.size());
+    (void)read_size;
+    fclose(trace_file);
+
+    //a fresh heap replaying the same operations ends up in the same state. it reuses the memory, aligned allocations pad the same way
+    auto replay_allocator = new allocator_t{ memory_pool_data, 1024 * 1024, 1024 };
+    trace_replayer_t<Traits> replayer{ *replay_allocator };
+    trace_reader_t reader{ trace.data(), trace.size() };
+    assert(reader.valid());
+
+    uint32_t counts[5] = {};
+    trace_record_t record;
+    while (reader.next(record)) {
+        ++counts[static_cast<uint8_t>(record.m_operation)];
+        if (record.m_operation == trace_operation_t::reset) {
+            assert(replay_allocator->available_memory() == available_memory);
+            assert(replay_allocator->largest_free_region() == largest_free_region);
+        }
+        replayer.apply(record);
+    }
+    assert(counts[static_cast<uint8_t>(trace_operation_t::allocate)] == allocations);
+    assert(counts[static_cast<uint8_t>(trace_operation_t::deallocate)] == deallocations);
+    assert(counts[static_cast<uint8_t>(trace_operation_t::resize)] == resizes);
+    assert(counts[static_cast<uint8_t>(trace_operation_t::reset)] == 1);
+    assert(replayer.m_failed_allocations == 0);
+    assert(replay_allocator->available_memory() == reset_available_memory);
+    replay_allocator->validate_freelist();
+    delete replay_allocator;
+
+    //an aligned block that cannot grow in place moves to memory with the same alignment
+    {
+        auto moving_allocator = new allocator_t{ memory_pool_data, 1024 * 1024, 1024 };
+        trace_replayer_t<Traits> moving_replayer{ *moving_allocator };
+        void* aligned = moving_replayer.apply({ trace_operation_t::allocate, 0, 64, 4096 });
+        //too large for the padding in front of the aligned block, so it lands right behind it
+        moving_replayer.apply({ trace_operation_t::allocate, 1, 8192, 1 });
+        void* moved = moving_replayer.apply({ trace_operation_t::resize, 0, 8192, 64 });
+        assert(moved != nullptr && moved != aligned && (reinterpret_cast<uintptr_t>(moved) & 4095) == 0);
+        moving_replayer.apply({ trace_operation_t::deallocate, 0, 8192, 0 });
+        moving_replayer.apply({ trace_operation_t::deallocate, 1, 8192, 0 });
+        moving_allocator->assert_is_in_initial_state();
+        delete moving_allocator;
+    }
+
+    //a block moved by slide_down keeps its id, freeing it at the new address finds it
+    if constexpr (!allocator_template_t<Traits>::k_use_boundary_tags) {
+        auto sliding_allocator = new allocator_t{ memory_pool_data, 1024 * 1024, 1024 };
+        FILE* sliding_file = tmpfile();
+        {
+            trace_writer_t sliding_writer{ sliding_file };
+            sliding_allocator->set_recorder(&sliding_writer);
+            void* lower = sliding_allocator->allocate(64);
+            void* upper = sliding_allocator->allocate(64);
+            sliding_allocator->deallocate(lower, 64);
+            void* moved = sliding_allocator->slide_down(upper, 64);
+            assert(moved == lower);
+            sliding_allocator->deallocate(moved, 64);
+            assert(sliding_writer.record_count() == 4);
+
+            //rebase detaches the recorder, in a persistent or shared heap it could belong to another process
+            sliding_allocator->rebase(memory_pool_data);
+            sliding_allocator->deallocate(sliding_allocator->allocate(32), 32);
+            assert(sliding_writer.record_count() == 4);
+        }
+        fclose(sliding_file);
+        sliding_allocator->assert_is_in_initial_state();
+        delete sliding_allocator;
+    }
+
+    delete[] memory_pool_data;
+}
+
+template<typename Traits>
+static void test_heap_profiler() {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    uint8_t* memory_pool_data = new uint8_t[1024 * 1024];
+    auto allocator = new allocator_t{ memory_pool_data, 1024 * 1024, 1024 };
+
+    //an interval of 0 samples every allocation, so the attribution is exact
+    auto tag_profiler = new heap_profiler_t{ 0, heap_profiler_t::capture_mode_t::tag };
+    allocator->set_sampler(tag_profiler);
+
+    //a sample follows its block through slide_down, freeing the block at the new address ends it
+    if constexpr (!allocator_template_t<Traits>::k_use_boundary_tags) {
+        heap_profiler_t::tag_scope_t scope{ "sliding" };
+        void* lower = allocator->allocate(64);
+        void* upper = allocator->allocate(64);
+        allocator->deallocate(lower, 64);
+        void* moved = allocator->slide_down(upper, 64);
+        assert(moved == lower && tag_profiler->live_sampled_bytes() == 64);
+        allocator->deallocate(moved, 64);
+        assert(tag_profiler->tag_statistics("sliding").m_live_count == 0 && tag_profiler->live_sampled_bytes() == 0);
+    }
+
+    std::vector<void*> parser_blocks{}, cache_blocks{};
+    {
+        heap_profiler_t::tag_scope_t scope{ "parser" };
+        for (uint32_t block_index = 0; block_index < 8; ++block_index) {
+            parser_blocks.push_back(allocator->allocate(100));
+        }
+        heap_profiler_t::tag_scope_t inner_scope{ "cache" };
+        for (uint32_t block_index = 0; block_index < 4; ++block_index) {
+            cache_blocks.push_back(allocator->allocate(300));
+        }
+    }
+    assert(heap_profiler_t::current_thread_tag() == nullptr);
+    allocator->deallocate(parser_blocks[0], 100);
+    allocator->deallocate(parser_blocks[5], 100);
+    allocator->shrink(cache_blocks[2], 300, 150);
+
+    auto parser = tag_profiler->tag_statistics("parser");
+    auto cache = tag_profiler->tag_statistics("cache");
+    assert(parser.m_live_count == 6 && parser.m_live_bytes == 600);
+    assert(parser.m_allocated_count == 8 && parser.m_allocated_bytes == 800);
+    assert(cache.m_live_count == 4 && cache.m_live_bytes == 1050);
+    assert(tag_profiler->live_sample_count() == 10 && tag_profiler->live_sampled_bytes() == 1650);
+    assert(tag_profiler->estimated_live_bytes() == 1650.0);
+
+    FILE* profile_file = tmpfile();
+    tag_profiler->dump(profile_file);
+    std::string profile(static_cast<size_t>(ftell(profile_file)), '\0');
+    rewind(profile_file);
+    size_t read_size = fread(&profile[0], 1, profile.size(), profile_file);
+    assert(read_size == profile.size());
+    (void)read_size;
+    fclose(profile_file);
+    assert(profile.compare(0, 14, "heap profile: ") == 0);
+    assert(profile.find("] @ heap_v2/1\n") != std::string::npos);
+    assert(profile.find(" 6:      600 [     8:      800] @ 0x") != std::string::npos);
+    assert(profile.find(" parser\n") != std::string::npos && profile.find(" cache\n") != std::string::npos);
+    assert(profile.find("\nMAPPED_LIBRARIES:\n") != std::string::npos);
+
+    //reset() empties the live heap, what was allocated stays in the profile
+    allocator->reset();
+    assert(tag_profiler->live_sample_count() == 0 && tag_profiler->tag_statistics("cache").m_live_bytes == 0);
+    assert(tag_profiler->tag_statistics("cache").m_allocated_count == 4);
+    allocator->set_sampler(nullptr);
+    delete tag_profiler;
+
+    //with a real interval about one sample lands on every interval bytes
+    auto stack_profiler = new heap_profiler_t{ 4096, heap_profiler_t::capture_mode_t::stack, 1u + random_u16() };
+    allocator->set_sampler(stack_profiler);
+    size_t allocated_bytes = 0;
+    for (uint32_t block_index = 0; block_index < 4096; ++block_index) {
+        auto block_size = static_cast<size_type_t>(16 + random_u16() % 1024);
+        void* block = allocator->allocate(block_size);
+        allocated_bytes += block_size;
+        allocator->deallocate(block, block_size);
+    }
+    FILE* stack_file = tmpfile();
+    stack_profiler->dump(stack_file);
+    rewind(stack_file);
+    unsigned long long live_count, live_bytes, allocated_count, sampled_bytes;
+    int fields = fscanf(stack_file, "heap profile: %llu: %llu [%llu: %llu]", &live_count, &live_bytes, &allocated_count, &sampled_bytes);
+    assert(fields == 4);
+    (void)fields;
+    fclose(stack_file);
+    assert(live_count == 0 && live_bytes == 0);
+    assert(allocated_count > allocated_bytes / 4096 / 2 && allocated_count < allocated_bytes / 4096 * 2);
+    assert(stack_profiler->callsite_count() >= 1 && stack_profiler->live_sample_count() == 0);
+    allocator->set_sampler(nullptr);
+    delete stack_profiler;
+
+    allocator->assert_is_in_initial_state();
+    delete allocator;
+    delete[] memory_pool_data;
+}
+
+template<typename SlabTemplate>
+static void test_slab_allocator() {
+    using slab_allocator_t = typename SlabTemplate::allocator_t;
+
+    uint8_t* memory_pool_data = new uint8_t[4 * 1024 * 1024];
+    auto allocator = new slab_allocator_t{ memory_pool_data, 4 * 1024 * 1024, 1024 };
+
+    std::list<std::pair<const char*, std::string>> strings{};
+    for (uint32_t string_index = 0; string_index < 8192; ++string_index) {
+        auto rand_str = create_random_string();
+        //every few strings is too large for the slabs
+        if ((string_index % 97) == 0) {
+            rand_str.append(SlabTemplate::k_max_slab_object_size, 'x');
+        }
+        uint32_t length = static_cast<uint32_t>(rand_str.size()) + 1;
+        auto str_alloced = static_cast<char*>(allocator->allocate(length));
+        memcpy(str_alloced, rand_str.c_str(), length);
+        strings.push_back({ str_alloced, rand_str });
+
+        //free roughly every third string, from the middle of the list
+        if ((string_index % 3) == 2) {
+            auto victim = std::next(strings.begin(), strings.size() / 2);
+            assert(victim->second == victim->first);
+            allocator->deallocate((void*)victim->first, static_cast<uint32_t>(victim->second.size()) + 1);
+            strings.erase(victim);
+        }
+    }
+
+    //small strings are packed into slabs, so the live set needs only a few slabs per size class
+    size_t small_bytes = 0;
+    for (auto& str : strings) {
+        assert(str.second == str.first);
+        if (str.second.size() < SlabTemplate::k_max_slab_object_size) {
+            small_bytes += str.second.size() + 1;
+        }
+    }
+    assert(allocator->slab_count() * SlabTemplate::k_slab_size < small_bytes * 2 + SlabTemplate::k_size_class_count * 2 * SlabTemplate::k_slab_size);
+    allocator->backing_allocator().validate_freelist();
+
+    for (auto& str : strings) {
+        allocator->deallocate((void*)str.first, static_cast<uint32_t>(str.second.size()) + 1);
+    }
+    assert(allocator->slab_count() <= SlabTemplate::k_size_class_count);
+    allocator->trim();
+    assert(allocator->slab_count() == 0);
+    allocator->backing_allocator().assert_is_in_initial_state();
+
+    //running out of memory returns nullptr, for large objects and for the slabs of small ones
+    assert(allocator->allocate(8 * 1024 * 1024) == nullptr);
+    std::vector<void*> small_blocks{};
+    while (void* block = allocator->allocate(16)) {
+        small_blocks.push_back(block);
+    }
+    assert(!small_blocks.empty());
+    for (auto block : small_blocks) {
+        allocator->deallocate(block, 16);
+    }
+    allocator->trim();
+    allocator->backing_allocator().assert_is_in_initial_state();
+
+    delete allocator;
+    delete[] memory_pool_data;
+}
+
+template<typename ConcurrentTemplate>
+static void test_thread_cache() {
+    uint8_t* memory_pool_data = new uint8_t[4 * 1024 * 1024];
+    memset(memory_pool_data, 0, 4 * 1024 * 1024);
+
+    using shared_allocator_t = typename ConcurrentTemplate::allocator_t;
+    using thread_cache_t = typename ConcurrentTemplate::thread_cache_t;
+
+    auto shared_allocator = new shared_allocator_t{ memory_pool_data, 4 * 1024 * 1024, 4096 };
+
+    //threads drop blocks in here and free whatever the previous thread left, so most frees are cross thread
+    constexpr uint32_t exchange_slot_count = 64;
+    std::atomic<const char*> exchange_slots[exchange_slot_count] = {};
+
+    auto worker = [shared_allocator, &exchange_slots](uint32_t thread_index) {
+        thread_cache_t cache{ *shared_allocator };
+        std::list<const char*> own_strings{};
+
+        for (uint32_t iteration = 0; iteration < 2048; ++iteration) {
+            auto rand_str = create_random_string();
+            //every few strings is large enough to bypass the magazines
+            if ((iteration % 61) == 0) {
+                rand_str.append(600, 'x');
+            }
+            uint32_t length = static_cast<uint32_t>(rand_str.size()) + 1;
+
+            auto str_alloced = static_cast<char*>(cache.allocate(length));
+            memcpy(str_alloced, rand_str.c_str(), length);
+
+            if ((iteration & 1) != 0) {
+                own_strings.push_back(str_alloced);
+            }
+            else {
+                auto previous = exchange_slots[(iteration + thread_index) % exchange_slot_count].exchange(str_alloced);
+                if (previous != nullptr) {
+                    cache.deallocate((void*)previous, strlen(previous) + 1);
+                }
+            }
+
+            if (own_strings.size() > 32) {
+                cache.deallocate((void*)own_strings.front(), strlen(own_strings.front()) + 1);
+                own_strings.pop_front();
+            }
+        }
+        for (auto str : own_strings) {
+            cache.deallocate((void*)str, strlen(str) + 1);
+        }
+    };
+
+    std::vector<std::thread> threads{};
+    for (uint32_t thread_index = 0; thread_index < 4; ++thread_index) {
+        threads.emplace_back(worker, thread_index);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto& slot : exchange_slots) {
+        if (auto str = slot.load()) {
+            shared_allocator->deallocate((void*)str, strlen(str) + 1);
+        }
+    }
+
+    //with every slot taken a cache still works, through the locked path
+    {
+        std::list<thread_cache_t> caches{};
+        for (uint32_t cache_index = 0; cache_index < ConcurrentTemplate::k_max_thread_caches; ++cache_index) {
+            caches.emplace_back(*shared_allocator);
+        }
+        thread_cache_t extra_cache{ *shared_allocator };
+        assert(caches.back().attached() && !extra_cache.attached());
+        void* block = extra_cache.allocate(32);
+        assert(block != nullptr);
+        extra_cache.deallocate(block, 32);
+    }
+
+    //running out of memory is nullptr, for large requests and for a magazine that cannot be refilled
+    {
+        thread_cache_t cache{ *shared_allocator };
+        assert(cache.allocate(8 * 1024 * 1024) == nullptr);
+        std::vector<void*> blocks{};
+        while (void* block = cache.allocate(512)) {
+            blocks.push_back(block);
+        }
+        assert(blocks.size() > 4096);
+        for (void* block : blocks) {
+            cache.deallocate(block, 512);
+        }
+    }
+    shared_allocator->collect_returned_blocks();
+
+    shared_allocator->backing_allocator().validate_nodepool();
+    shared_allocator->backing_allocator().assert_is_in_initial_state();
+
+    delete shared_allocator;
+    delete[] memory_pool_data;
+}
+
+template<typename NumaTemplate>
+static void test_numa_shards() {
+    using numa_allocator_t = typename NumaTemplate::allocator_t;
+    constexpr size_t shard_size = 1024 * 1024;
+
+    auto allocator = new numa_allocator_t{ shard_size, 1024, 3 };
+    assert(allocator->valid());
+    uint32_t shard_count = allocator->shard_count();
+    assert(shard_count >= 3 && shard_count % 3 == 0);
+
+    //the owner comes from the address alone
+    for (uint32_t shard_index = 0; shard_index < shard_count; ++shard_index) {
+        void* block = allocator->try_allocate_on(shard_index, 100);
+        assert(allocator->shard_of(block) == shard_index);
+        assert(allocator->shard_of(static_cast<uint8_t*>(block) + 99) == shard_index);
+        allocator->deallocate(block, 100);
+    }
+
+    //a full shard hands the next large block to another one, every shard takes exactly one of them
+    void* large_blocks[NumaTemplate::k_max_shards];
+    uint32_t shards_used = 0;
+    for (uint32_t block_index = 0; block_index < shard_count; ++block_index) {
+        large_blocks[block_index] = allocator->allocate(600 * 1024);
+        shards_used |= 1u << allocator->shard_of(large_blocks[block_index]);
+    }
+    assert(shards_used == (1u << shard_count) - 1);
+    assert(allocator->try_allocate(600 * 1024) == nullptr);
+    for (uint32_t block_index = 0; block_index < shard_count; ++block_index) {
+        allocator->deallocate(large_blocks[block_index], 600 * 1024);
+    }
+
+    //threads free each others blocks, the frees that cross shards wait in the queues until collected
+    constexpr uint32_t exchange_slot_count = 64;
+    std::atomic<const char*> exchange_slots[exchange_slot_count] = {};
+    auto worker = [allocator, &exchange_slots](uint32_t thread_index) {
+        for (uint32_t iteration = 0; iteration < 1024; ++iteration) {
+            auto rand_str = create_random_string();
+            uint32_t length = static_cast<uint32_t>(rand_str.size()) + 1;
+            auto str_alloced = static_cast<char*>(allocator->allocate(length));
+            memcpy(str_alloced, rand_str.c_str(), length);
+
+            auto previous = exchange_slots[(iteration * 7 + thread_index) % exchange_slot_count].exchange(str_alloced);
+            if (previous != nullptr) {
+                allocator->deallocate((void*)previous, strlen(previous) + 1);
+            }
+        }
+    };
+    std::vector<std::thread> threads{};
+    for (uint32_t thread_index = 0; thread_index < 4; ++thread_index) {
+        threads.emplace_back(worker, thread_index);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& slot : exchange_slots) {
+        if (auto str = slot.load()) {
+            allocator->deallocate((void*)str, strlen(str) + 1);
+        }
+    }
+    allocator->collect_remote_frees();
+
+    uint64_t allocations = 0, frees = 0;
+    for (uint32_t shard_index = 0; shard_index < shard_count; ++shard_index) {
+        auto statistics = allocator->shard_statistics(shard_index);
+        allocations += statistics.m_allocations;
+        frees += statistics.m_local_frees + statistics.m_remote_frees;
+        allocator->backing_allocator(shard_index).validate_freelist();
+        allocator->backing_allocator(shard_index).assert_is_in_initial_state();
+    }
+    assert(allocations == frees && allocations == 2 * shard_count + 4 * 1024);
+
+    delete allocator;
+}
+
+struct allocator_traits64_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 1;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct allocator_traits64_absolute_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 1;
+    static constexpr bool k_use_absolute_pointers = true;
+
+};
+
+struct allocator_traits32_t {
+    using displacement_type_t = int32_t;
+    using size_type_t = uint32_t;
+    static constexpr uint32_t k_allocation_alignment = 1;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct allocator_traits64_segregated_t : allocator_traits64_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct allocator_traits64_absolute_segregated_t : allocator_traits64_absolute_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct allocator_traits32_segregated_t : allocator_traits32_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct allocator_traits64_tree_t : allocator_traits64_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct allocator_traits64_absolute_tree_t : allocator_traits64_absolute_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct allocator_traits32_tree_t : allocator_traits32_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct allocator_traits64_statistics_t : allocator_traits64_t {
+    static constexpr bool k_collect_statistics = true;
+};
+
+struct allocator_traits32_segregated_statistics_t : allocator_traits32_segregated_t {
+    static constexpr bool k_collect_statistics = true;
+};
+
+struct allocator_traits64_packed_t : allocator_traits64_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+struct allocator_traits64_absolute_packed_t : allocator_traits64_absolute_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+struct allocator_traits32_packed_tree_t : allocator_traits32_tree_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+struct allocator_traits64_size_table_t : allocator_traits64_t {
+    static constexpr bool k_track_allocation_sizes = true;
+};
+
+struct allocator_traits32_segregated_size_table_t : allocator_traits32_segregated_t {
+    static constexpr bool k_track_allocation_sizes = true;
+};
+
+struct allocator_traits32_segregated_long_lived_t : allocator_traits32_segregated_t {
+    static constexpr lifetime_t k_default_lifetime = lifetime_t::long_lived;
+};
+
+struct allocator_traits32_compact_t : allocator_traits32_t {
+    static constexpr uint32_t k_allocation_alignment = 16;
+    using node_field_type_t = uint16_t;
+    static constexpr bool k_scale_node_fields = true;
+};
+static_assert(sizeof(allocator_template_t<allocator_traits32_compact_t>::allocation_node_t) == 8);
+
+struct allocator_traits32_compact_segregated_tree_t : allocator_traits32_compact_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct allocator_traits64_compact_packed_t : allocator_traits64_t {
+    static constexpr size_t k_allocation_alignment = 16;
+    using node_field_type_t = uint16_t;
+    static constexpr bool k_scale_node_fields = true;
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+struct allocator_traits64_boundary_tags_t : allocator_traits64_t {
+    static constexpr allocator_layout_t k_layout = allocator_layout_t::boundary_tags;
+};
+
+struct allocator_traits64_absolute_boundary_tags_t : allocator_traits64_absolute_t {
+    static constexpr allocator_layout_t k_layout = allocator_layout_t::boundary_tags;
+};
+
+struct allocator_traits32_boundary_tags_t : allocator_traits32_t {
+    static constexpr allocator_layout_t k_layout = allocator_layout_t::boundary_tags;
+};
+
+struct allocator_traits64_segregated_release_regions_t : allocator_traits64_segregated_t {
+    static constexpr bool k_release_empty_regions = true;
+};
+
+struct allocator_traits32_boundary_tags_release_regions_t : allocator_traits32_boundary_tags_t {
+    static constexpr bool k_release_empty_regions = true;
+};
+
+struct allocator_traits64_hardened_t : allocator_traits64_t {
+    static constexpr hardening_level_t k_hardening_level = hardening_level_t::local;
+};
+
+struct allocator_traits32_segregated_size_tags_t : allocator_traits32_segregated_t {
+    static constexpr hardening_level_t k_hardening_level = hardening_level_t::size_tags;
+    static constexpr uint32_t k_validation_interval = 64;
+};
+
+struct allocator_traits32_boundary_tags_hardened_t : allocator_traits32_boundary_tags_t {
+    static constexpr hardening_level_t k_hardening_level = hardening_level_t::local;
+};
+
+struct allocator_traits64_boundary_tags_size_tags_t : allocator_traits64_boundary_tags_t {
+    static constexpr hardening_level_t k_hardening_level = hardening_level_t::size_tags;
+    static constexpr uint32_t k_validation_interval = 64;
+};
+
+struct allocator_traits64_purge_t : allocator_traits64_t {
+    static constexpr size_t k_purge_threshold = 16 * 1024;
+    static constexpr uint32_t k_purge_decay_operations = 0;
+};
+
+struct allocator_traits32_segregated_huge_pages_t : allocator_traits32_segregated_t {
+    static constexpr uint32_t k_purge_decay_operations = 256;
+    static constexpr bool k_purge_lazy_free = true;
+    static constexpr bool k_huge_page_alignment = true;
+};
+
+struct allocator_traits64_recorded_t : allocator_traits64_t {
+    static constexpr bool k_record_operations = true;
+};
+
+struct allocator_traits32_boundary_tags_recorded_t : allocator_traits32_boundary_tags_t {
+    static constexpr bool k_record_operations = true;
+};
+
+struct allocator_traits64_numa_t : allocator_traits64_segregated_t {
+    static constexpr size_t k_allocation_alignment = 16;
+};
+
+struct allocator_traits32_boundary_tags_numa_t : allocator_traits32_boundary_tags_t {
+    static constexpr uint32_t k_allocation_alignment = 16;
+};
+
+//recorded and sampled at once, both watch the same operations
+struct allocator_traits64_sampled_t : allocator_traits64_recorded_t {
+    static constexpr bool k_sample_allocations = true;
+};
+
+struct allocator_traits32_boundary_tags_sampled_t : allocator_traits32_boundary_tags_t {
+    static constexpr bool k_sample_allocations = true;
+};
+
+//tests [seed] [iterations]
+int main(int argc, char** argv) {
+    uint32_t seed = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 1;
+    uint32_t iterations = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 65536;
+    printf("seed %u, %u iterations\n", seed, iterations);
+    g_random.seed(seed);
 
-int main() {
-    for (uint32_t i = 0; i < 65536; ++i) {
+    for (uint32_t i = 0; i < iterations; ++i) {
         test_allocator_template<allocator_template_t<allocator_traits64_t>>();
         test_allocator_template<allocator_template_t<allocator_traits64_absolute_t>>();
         test_allocator_template<allocator_template_t<allocator_traits32_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_segregated_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_absolute_segregated_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits32_segregated_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_tree_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_absolute_tree_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits32_tree_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_packed_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_absolute_packed_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits32_packed_tree_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_absolute_boundary_tags_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_oversized_requests<allocator_template_t<allocator_traits64_t>>();
+        test_oversized_requests<allocator_template_t<allocator_traits32_segregated_t>>();
+        test_oversized_requests<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_oversized_requests<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_exact_fit<allocator_template_t<allocator_traits64_t>>();
+        test_exact_fit<allocator_template_t<allocator_traits64_segregated_t>>();
+        test_exact_fit<allocator_template_t<allocator_traits32_segregated_t>>();
+        test_exact_fit<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_exact_fit<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits64_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits64_absolute_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits32_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits64_segregated_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits32_tree_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits64_packed_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_aligned_allocations<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits64_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits64_absolute_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits32_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits64_segregated_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits32_tree_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits32_packed_tree_t>>();
+        test_batch_operations<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_reallocation<allocator_template_t<allocator_traits64_t>>();
+        test_reallocation<allocator_template_t<allocator_traits64_absolute_t>>();
+        test_reallocation<allocator_template_t<allocator_traits32_t>>();
+        test_reallocation<allocator_template_t<allocator_traits64_segregated_t>>();
+        test_reallocation<allocator_template_t<allocator_traits32_tree_t>>();
+        test_reallocation<allocator_template_t<allocator_traits64_packed_t>>();
+        test_reallocation<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_reallocation<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_reallocation<allocator_template_t<allocator_traits32_segregated_size_tags_t>>();
+        test_reallocation<allocator_template_t<allocator_traits64_boundary_tags_size_tags_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits64_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits64_absolute_tree_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits32_segregated_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits64_packed_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits64_size_table_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits64_statistics_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_reset_and_marks<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_hardening<allocator_template_t<allocator_traits64_hardened_t>>();
+        test_hardening<allocator_template_t<allocator_traits32_segregated_size_tags_t>>();
+        test_hardening<allocator_template_t<allocator_traits32_boundary_tags_hardened_t>>();
+        test_hardening<allocator_template_t<allocator_traits64_boundary_tags_size_tags_t>>();
+        test_packed_best_fit<allocator_template_t<allocator_traits64_packed_t>>();
+        test_packed_best_fit<allocator_template_t<allocator_traits32_packed_tree_t>>();
+        test_lifetime_hints<allocator_template_t<allocator_traits64_t>>();
+        test_lifetime_hints<allocator_template_t<allocator_traits64_absolute_tree_t>>();
+        test_lifetime_hints<allocator_template_t<allocator_traits32_segregated_long_lived_t>>();
+        test_lifetime_hints<allocator_template_t<allocator_traits32_packed_tree_t>>();
+        test_compact_nodes<allocator_template_t<allocator_traits32_compact_t>>();
+        test_compact_nodes<allocator_template_t<allocator_traits32_compact_segregated_tree_t>>();
+        test_compact_nodes<allocator_template_t<allocator_traits64_compact_packed_t>>();
+        test_boundary_tags<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_boundary_tags<allocator_template_t<allocator_traits64_absolute_boundary_tags_t>>();
+        test_boundary_tags<allocator_template_t<allocator_traits32_boundary_tags_t>>();
+        test_allocator_template<allocator_template_t<allocator_traits64_size_table_t>>();
+        test_sizeless_deallocation<allocator_template_t<allocator_traits64_size_table_t>>();
+        test_sizeless_deallocation<allocator_template_t<allocator_traits32_segregated_size_table_t>>();
+        test_sizeless_deallocation<allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_memory_resource<allocator_traits64_t>();
+        test_memory_resource<allocator_traits32_segregated_t>();
+        test_memory_resource<allocator_traits64_boundary_tags_t>();
+        test_persistent_heap<allocator_traits64_t>();
+        test_persistent_heap<allocator_traits32_segregated_t>();
+        test_persistent_heap<allocator_traits64_boundary_tags_t>();
+        test_persistent_heap<allocator_traits32_compact_t>();
+#if !defined(_WIN32)
+        test_shared_heap<allocator_traits64_t>();
+        test_shared_heap<allocator_traits32_segregated_t>();
+#endif
+        test_growable_heap<allocator_traits64_t>();
+        test_growable_heap<allocator_traits64_absolute_tree_t>();
+        test_growable_heap<allocator_traits64_segregated_release_regions_t>();
+        test_growable_heap<allocator_traits32_boundary_tags_release_regions_t>();
+        test_relocatable_heap<relocatable_allocator_template_t<allocator_traits64_t>>();
+        test_relocatable_heap<relocatable_allocator_template_t<allocator_traits64_absolute_tree_t>>();
+        test_relocatable_heap<relocatable_allocator_template_t<allocator_traits32_segregated_size_table_t>>();
+        test_relocatable_heap<relocatable_allocator_template_t<allocator_traits64_packed_t>>();
+        test_purging_heap<purging_allocator_template_t<allocator_traits64_purge_t>>();
+        test_purging_heap<purging_allocator_template_t<allocator_traits32_segregated_huge_pages_t>>();
+        test_trace_roundtrip<allocator_traits64_recorded_t>();
+        test_trace_roundtrip<allocator_traits32_boundary_tags_recorded_t>();
+        test_heap_profiler<allocator_traits64_sampled_t>();
+        test_heap_profiler<allocator_traits32_boundary_tags_sampled_t>();
+        test_slab_allocator<slab_allocator_template_t<allocator_traits64_t>>();
+        test_slab_allocator<slab_allocator_template_t<allocator_traits32_segregated_t>>();
+        test_slab_allocator<slab_allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_statistics<allocator_template_t<allocator_traits64_statistics_t>>();
+        test_statistics<allocator_template_t<allocator_traits32_segregated_statistics_t>>();
+        test_thread_cache<concurrent_allocator_template_t<allocator_traits64_segregated_t>>();
+        test_thread_cache<concurrent_allocator_template_t<allocator_traits32_t>>();
+        test_thread_cache<concurrent_allocator_template_t<allocator_traits64_boundary_tags_t>>();
+        test_numa_shards<numa_allocator_template_t<allocator_traits64_numa_t>>();
+        test_numa_shards<numa_allocator_template_t<allocator_traits32_boundary_tags_numa_t>>();
     }
     return 0;
 }
\ No newline at end of file
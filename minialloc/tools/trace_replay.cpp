@@ -0,0 +1,265 @@
+/*
+    replays an allocation trace (see minialloc_trace.hpp) against every search policy and layout, with 64 and 32 bit
+    displacements and with absolute pointers, and reports operations per second, the latency distribution of single
+    operations, the peak footprint (the highest block end above the start of the heap) and a fragmentation timeline,
+    the share of the free memory outside the largest free region sampled at ten evenly spaced points of the trace.
+    the 32 bit configurations cap the heap at 1 GiB. linux only.
+
+        trace_replay <trace> [heap MiB]
+        trace_replay --generate <trace> [operations]
+
+    --generate records a synthetic workload (mixed sizes, some aligned, in place resizes and phases that free most
+    of the heap) through an allocator with k_record_operations, to try the tool without an instrumented program.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../minialloc_trace.hpp"
+
+struct first_fit_traits_t {
+    using displacement_type_t = ptrdiff_t;
+    using size_type_t = size_t;
+    static constexpr size_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct first_fit_absolute_traits_t : first_fit_traits_t {
+    static constexpr bool k_use_absolute_pointers = true;
+};
+
+struct first_fit32_traits_t {
+    using displacement_type_t = int32_t;
+    using size_type_t = uint32_t;
+    static constexpr uint32_t k_allocation_alignment = 16;
+    static constexpr bool k_use_absolute_pointers = false;
+};
+
+struct segregated32_traits_t : first_fit32_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct first_fit_tree_traits_t : first_fit_traits_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct segregated_traits_t : first_fit_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::segregated_fit;
+};
+
+struct segregated_tree_traits_t : segregated_traits_t {
+    static constexpr bool k_use_address_tree = true;
+};
+
+struct packed_best_fit_traits_t : first_fit_traits_t {
+    static constexpr search_policy_t k_search_policy = search_policy_t::packed_best_fit;
+};
+
+struct boundary_tags_traits_t : segregated_traits_t {
+    static constexpr allocator_layout_t k_layout = allocator_layout_t::boundary_tags;
+};
+
+struct recording_traits_t : segregated_traits_t {
+    static constexpr bool k_record_operations = true;
+};
+
+static constexpr size_t k_timeline_samples = 10;
+
+struct trace_t {
+    std::vector<trace_record_t> m_records;
+    //the most blocks live at once bounds the node pool
+    size_t m_max_live_blocks = 0;
+};
+
+static bool load_trace(const char* path, trace_t& trace) {
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat file_status;
+    fstat(file, &file_status);
+    auto size = static_cast<size_t>(file_status.st_size);
+    auto data = static_cast<const uint8_t*>(size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0));
+    close(file);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    trace_reader_t reader{ data, size };
+    bool valid = reader.valid();
+    size_t live_blocks = 0;
+    trace_record_t record;
+    while (valid && reader.next(record)) {
+        if (record.m_operation == trace_operation_t::allocate) {
+            trace.m_max_live_blocks = (std::max)(trace.m_max_live_blocks, ++live_blocks);
+        }
+        else if (record.m_operation == trace_operation_t::deallocate) {
+            --live_blocks;
+        }
+        else if (record.m_operation == trace_operation_t::reset) {
+            live_blocks = 0;
+        }
+        trace.m_records.push_back(record);
+    }
+    munmap(const_cast<uint8_t*>(data), size);
+    return valid;
+}
+
+template<typename Traits>
+static void replay(const char* name, const trace_t& trace, size_t heap_size) {
+    using allocator_t = typename allocator_template_t<Traits>::allocator_t;
+    using size_type_t = typename Traits::size_type_t;
+
+    heap_size = (std::min)(heap_size, static_cast<size_t>(1) << (sizeof(size_type_t) * 8 - 2));
+    auto memory = static_cast<uint8_t*>(mmap(nullptr, heap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    auto allocator = new allocator_t{ memory, static_cast<size_type_t>(heap_size), static_cast<size_type_t>(2 * trace.m_max_live_blocks + 64) };
+    trace_replayer_t<Traits> replayer{ *allocator };
+
+    std::vector<uint32_t> latencies(trace.m_records.size());
+    double fragmentation[k_timeline_samples] = {};
+    size_t sample_interval = (std::max)(trace.m_records.size() / k_timeline_samples, static_cast<size_t>(1));
+    size_t peak_footprint = 0;
+    double total_ns = 0.0;
+
+    for (size_t record_index = 0; record_index < trace.m_records.size(); ++record_index) {
+        const auto& record = trace.m_records[record_index];
+        auto start = std::chrono::steady_clock::now();
+        auto block = static_cast<uint8_t*>(replayer.apply(record));
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        total_ns += ns;
+        latencies[record_index] = static_cast<uint32_t>(ns);
+        if (block != nullptr) {
+            peak_footprint = (std::max)(peak_footprint, static_cast<size_t>(block + record.m_size - memory));
+        }
+        if ((record_index + 1) % sample_interval == 0 && (record_index + 1) / sample_interval <= k_timeline_samples) {
+            size_t available = allocator->available_memory();
+            fragmentation[(record_index + 1) / sample_interval - 1] = available == 0 ? 0.0 :
+                1.0 - static_cast<double>(allocator->largest_free_region()) / static_cast<double>(available);
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double share) {
+        return latencies.empty() ? 0u : latencies[static_cast<size_t>(share * (latencies.size() - 1))];
+    };
+
+    printf("%-20s %12.0f %8u %8u %8u %8u %12zu %9llu  ", name, trace.m_records.size() / (total_ns * 1e-9),
+        percentile(0.5), percentile(0.99), percentile(0.999), latencies.empty() ? 0u : latencies.back(),
+        peak_footprint >> 10, static_cast<unsigned long long>(replayer.m_failed_allocations));
+    for (double sample : fragmentation) {
+        printf(" %3.0f", sample * 100.0);
+    }
+    printf("\n");
+
+    delete allocator;
+    munmap(memory, heap_size);
+}
+
+struct live_block_t {
+    uint8_t* m_memory;
+    size_t m_size;
+};
+
+static int generate(const char* path, size_t operations) {
+    using allocator_t = allocator_template_t<recording_traits_t>::allocator_t;
+    static constexpr size_t k_heap_size = 256 * 1024 * 1024;
+    static constexpr size_t k_max_live_blocks = 64 * 1024;
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    auto memory = static_cast<uint8_t*>(mmap(nullptr, k_heap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    auto allocator = new allocator_t{ memory, k_heap_size, k_max_live_blocks };
+    trace_writer_t writer{ file };
+    allocator->set_recorder(&writer);
+
+    std::mt19937_64 rng{ 19 };
+    std::vector<live_block_t> live{};
+    auto random_size = [&rng]() {
+        return static_cast<size_t>(rng() % 16 == 0 ? 4096 + rng() % (64 * 1024) : 8 + rng() % 504);
+    };
+
+    for (size_t operation_index = 0; operation_index < operations; ++operation_index) {
+        //every quarter of the run ends with most of the heap going away
+        bool draining = operation_index % (operations / 4 + 1) > operations / 5;
+        uint64_t choice = rng() % 16;
+        if (!live.empty() && (draining ? choice < 12 : choice < 6 || live.size() >= k_max_live_blocks / 2)) {
+            size_t index = rng() % live.size();
+            allocator->deallocate(live[index].m_memory, live[index].m_size);
+            live[index] = live.back();
+            live.pop_back();
+        }
+        else if (!live.empty() && choice == 15) {
+            auto& block = live[rng() % live.size()];
+            size_t new_size = block.m_size + 1 + rng() % 256;
+            if (rng() % 2 == 0 && block.m_size > 16) {
+                new_size = block.m_size / 2;
+                allocator->shrink(block.m_memory, block.m_size, new_size);
+                block.m_size = new_size;
+            }
+            else if (allocator->try_expand(block.m_memory, block.m_size, new_size)) {
+                block.m_size = new_size;
+            }
+        }
+        else {
+            size_t size = random_size();
+            void* block = choice == 14 ? allocator->try_allocate_aligned(size, 256) : allocator->try_allocate(size);
+            if (block != nullptr) {
+                live.push_back({ static_cast<uint8_t*>(block), size });
+            }
+        }
+    }
+
+    writer.flush();
+    printf("%llu records written to %s\n", static_cast<unsigned long long>(writer.record_count()), path);
+    delete allocator;
+    munmap(memory, k_heap_size);
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && strcmp(argv[1], "--generate") == 0) {
+        return generate(argv[2], argc >= 4 ? strtoull(argv[3], nullptr, 10) : 1000000);
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace> [heap MiB]\n       %s --generate <trace> [operations]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    trace_t trace{};
+    if (!load_trace(argv[1], trace)) {
+        fprintf(stderr, "%s is not a readable trace\n", argv[1]);
+        return 1;
+    }
+    size_t heap_size = (argc >= 3 ? strtoull(argv[2], nullptr, 10) : 1024) * 1024 * 1024;
+
+    printf("%zu records, at most %zu live blocks\n", trace.m_records.size(), trace.m_max_live_blocks);
+    printf("%-20s %12s %8s %8s %8s %8s %12s %9s   %s\n", "configuration", "ops/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns",
+        "peak KiB", "failures", "fragmentation % over time");
+    replay<first_fit_traits_t>("first fit", trace, heap_size);
+    replay<first_fit_absolute_traits_t>("first fit, absolute", trace, heap_size);
+    replay<first_fit32_traits_t>("first fit, 32 bit", trace, heap_size);
+    replay<first_fit_tree_traits_t>("first fit + tree", trace, heap_size);
+    replay<segregated_traits_t>("segregated", trace, heap_size);
+    replay<segregated32_traits_t>("segregated, 32 bit", trace, heap_size);
+    replay<segregated_tree_traits_t>("segregated + tree", trace, heap_size);
+    replay<packed_best_fit_traits_t>("packed best fit", trace, heap_size);
+    replay<boundary_tags_traits_t>("boundary tags", trace, heap_size);
+    return 0;
+}